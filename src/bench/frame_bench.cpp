@@ -0,0 +1,131 @@
+#include "frame_bench.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <numeric>
+
+namespace bench {
+    static double to_ms(const std::chrono::nanoseconds duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    static std::string escape_json(const std::string_view str) {
+        std::string escaped;
+        escaped.reserve(str.size());
+        for (const char c : str) {
+            if (c == '"' || c == '\\') {
+                escaped.push_back('\\');
+            }
+            escaped.push_back(c);
+        }
+        return escaped;
+    }
+
+    double Samples::percentile(const double p) const {
+        if (values.empty()) {
+            return 0.0;
+        }
+
+        std::vector<double> sorted = values;
+        std::ranges::sort(sorted);
+
+        // Nearest-rank percentile
+        const auto rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(sorted.size())));
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    }
+
+    double Samples::mean() const {
+        if (values.empty()) {
+            return 0.0;
+        }
+
+        return std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size());
+    }
+
+    double Samples::max() const {
+        if (values.empty()) {
+            return 0.0;
+        }
+
+        return std::ranges::max(values);
+    }
+
+    static std::string samples_to_json(const Samples &samples) {
+        return std::format(
+            R"({{"mean": {:.4f}, "p50": {:.4f}, "p95": {:.4f}, "p99": {:.4f}, "max": {:.4f}}})",
+            samples.mean(),
+            samples.percentile(50.0),
+            samples.percentile(95.0),
+            samples.percentile(99.0),
+            samples.max()
+        );
+    }
+
+    std::string BenchResult::to_json() const {
+        std::string json = "{\n";
+        json += std::format("  \"device\": \"{}\",\n", escape_json(device_name));
+        json += std::format("  \"extent\": [{}, {}],\n", extent.width, extent.height);
+        json += std::format("  \"frames\": {},\n", frames);
+        json += std::format("  \"frames_in_flight\": {},\n", frames_in_flight);
+        json += std::format("  \"frame_time_ms\": {},\n", samples_to_json(frame_time));
+        json += std::format("  \"acquire_ms\": {},\n", samples_to_json(acquire));
+        json += std::format("  \"record_ms\": {},\n", samples_to_json(record));
+        json += std::format("  \"submit_ms\": {},\n", samples_to_json(submit));
+        json += std::format("  \"present_ms\": {},\n", samples_to_json(present));
+        json += std::format("  \"allocations_per_frame\": {}\n", samples_to_json(allocations));
+        json += "}\n";
+        return json;
+    }
+
+    FrameBench::FrameBench(const BenchOptions &options)
+        : Game(engine::EngineSettings{
+              .headless                      = true,
+              .headless_extent               = options.extent,
+              .frames_in_flight              = options.frames_in_flight,
+              .periodic_pipeline_cache_saves = false,
+          }),
+          m_Options(options) {}
+
+    BenchResult FrameBench::run_benchmark() {
+        using clock = std::chrono::steady_clock;
+
+        startup();
+
+        for (uint32_t i = 0; i < m_Options.warmup_frames; i++) {
+            internal_frame();
+        }
+
+        BenchResult result{
+            .device_name      = std::string(engine()->vulkan()->physical_device().getProperties().deviceName.data()),
+            .extent           = m_Options.extent,
+            .frames           = m_Options.frames,
+            .frames_in_flight = m_Options.frames_in_flight,
+        };
+
+        for (auto *samples : {&result.frame_time, &result.acquire, &result.record, &result.submit, &result.present, &result.allocations}) {
+            samples->values.reserve(m_Options.frames);
+        }
+
+        for (uint32_t i = 0; i < m_Options.frames; i++) {
+            const uint64_t allocations_before = allocation_count();
+            const auto     frame_start        = clock::now();
+
+            internal_frame();
+
+            const auto     frame_end         = clock::now();
+            const uint64_t allocations_after = allocation_count();
+
+            const auto &timings = last_frame_timings();
+            result.frame_time.values.push_back(to_ms(frame_end - frame_start));
+            result.acquire.values.push_back(to_ms(timings.acquire));
+            result.record.values.push_back(to_ms(timings.record));
+            result.submit.values.push_back(to_ms(timings.submit));
+            result.present.values.push_back(to_ms(timings.present));
+            result.allocations.values.push_back(static_cast<double>(allocations_after - allocations_before));
+        }
+
+        shutdown();
+        return result;
+    }
+} // namespace bench
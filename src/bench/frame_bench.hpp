@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "game/game.hpp"
+
+namespace bench {
+    struct BenchOptions {
+        uint32_t     frames           = 1000;
+        uint32_t     warmup_frames    = 100;
+        uint32_t     frames_in_flight = 2;
+        vk::Extent2D extent           = {1280, 720};
+    };
+
+    /**
+     * Samples (in milliseconds, or allocation counts) collected for a single metric over every measured frame.
+     */
+    struct Samples {
+        std::vector<double> values;
+
+        [[nodiscard]] double percentile(double p) const;
+        [[nodiscard]] double mean() const;
+        [[nodiscard]] double max() const;
+    };
+
+    struct BenchResult {
+        std::string  device_name;
+        vk::Extent2D extent;
+        uint32_t     frames;
+        uint32_t     frames_in_flight;
+
+        Samples frame_time;
+        Samples acquire;
+        Samples record;
+        Samples submit;
+        Samples present;
+        Samples allocations;
+
+        [[nodiscard]] std::string to_json() const;
+    };
+
+    /**
+     * Runs the game headless and times `internal_frame` (the update job and `internal_render_frame`), so the numbers only cover the engine's frame loop (no event
+     * polling or window system overhead). Periodic pipeline cache saves are turned off so they don't end up in the samples.
+     */
+    class FrameBench final : public game::Game {
+      public:
+        explicit FrameBench(const BenchOptions &options);
+
+        BenchResult run_benchmark();
+
+      private:
+        BenchOptions m_Options;
+    };
+
+    /**
+     * Number of heap allocations made by the process so far. The benchmark executable replaces the global allocation functions to keep this up to date.
+     */
+    uint64_t allocation_count();
+} // namespace bench
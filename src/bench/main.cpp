@@ -0,0 +1,115 @@
+#include "frame_bench.hpp"
+
+#include <atomic>
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+
+static std::atomic<uint64_t> g_AllocationCount = 0;
+
+// Only the plain allocation functions are replaced, over-aligned allocations aren't counted.
+void *operator new(const std::size_t size) {
+    g_AllocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](const std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+uint64_t bench::allocation_count() {
+    return g_AllocationCount.load(std::memory_order_relaxed);
+}
+
+static bool parse_uint(const std::string_view str, uint32_t &out) {
+    const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), out);
+    return ec == std::errc() && ptr == str.data() + str.size();
+}
+
+static void print_usage() {
+    std::cerr << "usage: gaming_rpg_bench [--frames N] [--warmup N] [--frames-in-flight N] [--width W] [--height H] [--output FILE]\n";
+}
+
+int main(const int argc, char **argv) {
+    bench::BenchOptions options;
+    std::string         output_path;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (i + 1 >= argc) {
+            print_usage();
+            return 1;
+        }
+
+        const std::string_view value = argv[++i];
+
+        bool ok = true;
+        if (arg == "--frames") {
+            ok = parse_uint(value, options.frames);
+        } else if (arg == "--warmup") {
+            ok = parse_uint(value, options.warmup_frames);
+        } else if (arg == "--frames-in-flight") {
+            ok = parse_uint(value, options.frames_in_flight) && options.frames_in_flight > 0;
+        } else if (arg == "--width") {
+            ok = parse_uint(value, options.extent.width) && options.extent.width > 0;
+        } else if (arg == "--height") {
+            ok = parse_uint(value, options.extent.height) && options.extent.height > 0;
+        } else if (arg == "--output") {
+            output_path = value;
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            print_usage();
+            return 1;
+        }
+    }
+
+    try {
+        const auto bench  = std::make_shared<bench::FrameBench>(options);
+        const auto result = bench->run_benchmark();
+        const auto json   = result.to_json();
+
+        if (output_path.empty()) {
+            std::cout << json;
+        } else {
+            std::ofstream file(output_path);
+            file << json;
+            file.close();
+            if (!file) {
+                spdlog::critical("Couldn't write the results to {}.", output_path);
+                return 1;
+            }
+        }
+    } catch (engine::crash &c) {
+        spdlog::critical(c.what());
+        return 1;
+    } catch (std::exception &e) {
+        spdlog::critical(e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -2,8 +2,9 @@
 
 #include <GLFW/glfw3.h>
 
+
 namespace engine {
-    Application::Application() {}
+    Application::Application(const EngineSettings &settings) : m_Settings(settings) {}
 
     Application::~Application() {}
 
@@ -12,33 +13,116 @@ namespace engine {
     }
 
     void Application::run() {
-        glfwInit();
+        startup();
+
+        while (is_running()) {
+            m_RenderTarget->wait_for_input();
+            if (m_MainWindow) {
+                glfwPollEvents();
+            }
+
+            internal_frame();
+        }
+
+        shutdown();
+    }
+
+    void Application::startup() {
+        if (!m_Settings.headless) {
+            glfwInit();
+        }
 
         internal_verify_system();
         build_context();
 
-        // m_Window = std::make_unique<Window>(WindowAttributes{"Hello!", {800, 600}, true, false});
-        // m_Window->create_surface(m_EngineContext->vulkan());
+        if (m_Settings.headless) {
+            m_HeadlessSurface = std::make_unique<HeadlessSurface>(m_EngineContext->vulkan(), m_Settings.headless_extent);
+            m_RenderTarget    = m_HeadlessSurface.get();
+        } else {
+            m_MainWindow   = m_WindowManager->create_window(WindowAttributes{"Hello!", {800, 600}, true, false}).window;
+            m_RenderTarget = m_MainWindow->get_surface().get();
+            m_MainWindow->get_surface()->set_image_count(m_Settings.swapchain_image_count);
+            m_MainWindow->get_surface()->set_vsync(m_Settings.vsync);
+            m_MainWindow->get_surface()->pacer().set_settings(m_Settings.frame_pacing);
+        }
+
+        m_RenderTarget->set_frames_in_flight(m_Settings.frames_in_flight);
 
-        m_CommandPool = vk::raii::CommandPool(
-            m_EngineContext->vulkan()->device(), vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, m_EngineContext->vulkan()->primary_queue_family())
-        );
-        m_CommandBuffers = vk::raii::CommandBuffers(
-            m_EngineContext->vulkan()->device(), vk::CommandBufferAllocateInfo(*m_CommandPool, vk::CommandBufferLevel::ePrimary, Surface::MAX_FRAMES_IN_FLIGHT)
-        );
+        uint32_t recording_threads = m_Settings.recording_threads;
+        if (recording_threads == 0) {
+            recording_threads = m_EngineContext->jobs().worker_count();
+        }
 
+        m_CommandPools.emplace(m_EngineContext->vulkan(), m_EngineContext->vulkan()->primary_queue_family(), m_RenderTarget->frames_in_flight(), recording_threads);
+        m_Uploads      = std::make_unique<UploadService>(m_EngineContext->vulkan());
+        m_AsyncCompute = std::make_unique<AsyncCompute>(m_EngineContext->vulkan(), m_RenderTarget->frames_in_flight());
+        m_FrameRing    = std::make_unique<FrameRingBuffer>(m_EngineContext->vulkan(), m_RenderTarget->frames_in_flight(), m_Settings.frame_ring_capacity);
+        m_GpuTasks     = std::make_unique<GpuTaskScheduler>(m_EngineContext->vulkan());
+        m_Pipelines    = std::make_unique<PipelineManager>(m_EngineContext->vulkan(), m_EngineContext->jobs(), m_RenderTarget->frames_in_flight());
+        if (m_EngineContext->vulkan()->capabilities().bindless) {
+            m_Bindless = std::make_unique<BindlessHeap>(m_EngineContext->vulkan());
+        }
 
-        // while (m_Window->is_open()) {
-        //     glfwPollEvents();
-        //
-        //     internal_render_frame();
-        // }
+        // The first frame has nothing to overlap with, so its snapshot is filled in up front.
+        m_RenderSnapshot = 0;
+        m_LastUpdate     = std::chrono::steady_clock::now();
+        update(m_RenderSnapshot, std::chrono::nanoseconds::zero());
+    }
+
+    void Application::set_frames_in_flight(const uint32_t count) {
+        m_Settings.frames_in_flight = count;
+        if (!m_RenderTarget) {
+            return;
+        }
+
+        // The render target waits for all of its frames, which covers every command buffer recorded for them too.
+        m_RenderTarget->set_frames_in_flight(count);
+        if (m_CommandPools->frames_in_flight() != count) {
+            const uint32_t workers = m_CommandPools->worker_count();
+            m_CommandPools.reset();
+            m_CommandPools.emplace(m_EngineContext->vulkan(), m_EngineContext->vulkan()->primary_queue_family(), count, workers);
+        }
+        if (m_AsyncCompute->frames_in_flight() != count) {
+            m_AsyncCompute.reset();
+            m_AsyncCompute = std::make_unique<AsyncCompute>(m_EngineContext->vulkan(), count);
+        }
+        if (m_FrameRing->frames_in_flight() != count) {
+            m_FrameRing.reset();
+            m_FrameRing = std::make_unique<FrameRingBuffer>(m_EngineContext->vulkan(), count, m_Settings.frame_ring_capacity);
+        }
+        m_Pipelines->set_frames_in_flight(count);
+    }
+
+    void Application::set_swapchain_image_count(const uint32_t count) {
+        m_Settings.swapchain_image_count = count;
+        if (m_MainWindow) {
+            m_MainWindow->get_surface()->set_image_count(count);
+        }
+    }
+
+    void Application::shutdown() {
+        if (m_PipelineCacheSave) {
+            m_EngineContext->jobs().wait(m_PipelineCacheSave);
+        }
+
+        // Finishes any pipelines which are still compiling, so they make it into the saved cache.
+        m_Pipelines.reset();
 
         m_EngineContext->vulkan()->device().waitIdle();
+        m_EngineContext->vulkan()->pipeline_cache().save();
+    }
+
+    bool Application::is_running() const {
+        if (m_ExitRequested) {
+            return false;
+        }
+
+        return m_MainWindow == nullptr || m_MainWindow->is_open();
     }
 
     void Application::internal_verify_system() const {
-        if (!glfwVulkanSupported()) {
+        // Headless runs never touch GLFW, if there's no usable driver there device creation will fail instead.
+        if (!m_Settings.headless && !glfwVulkanSupported()) {
             throw crash(CrashReason::UnsupportedSystem, "System unsupported! Your GPU must support Vulkan and your system must have Vulkan drivers installed for it.");
         }
 
@@ -48,32 +132,171 @@ namespace engine {
     }
 
     void Application::build_context() {
-        m_EngineContext = EngineContext::create();
-        m_WindowManager = std::make_shared<WindowManager>();
-        m_WindowManager->connect_render_context(m_EngineContext->vulkan());
+        m_EngineContext = EngineContext::create(m_Settings);
+
+        if (!m_Settings.headless) {
+            m_WindowManager = std::make_shared<WindowManager>();
+            m_WindowManager->connect_render_context(m_EngineContext->vulkan());
+        }
+    }
+
+    void Application::internal_frame() {
+        const uint32_t next_snapshot = (m_RenderSnapshot + 1) % SNAPSHOT_COUNT;
+
+        const auto now   = std::chrono::steady_clock::now();
+        const auto delta = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_LastUpdate);
+        m_LastUpdate     = now;
+
+        auto &jobs    = m_EngineContext->jobs();
+        auto  updated = jobs.schedule("update", [this, next_snapshot, delta] { update(next_snapshot, delta); });
+
+        std::exception_ptr error;
+        try {
+            internal_render_frame();
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        // The update references this application, so it has to finish before an error from rendering goes any further.
+        jobs.wait(updated);
+        if (error) {
+            std::rethrow_exception(error);
+        }
+
+        m_RenderSnapshot = next_snapshot;
+
+        // Reading back and writing out the pipeline cache can take a while, so it's done on a worker.
+        auto &pipeline_cache = m_EngineContext->vulkan()->pipeline_cache();
+        if (m_Settings.periodic_pipeline_cache_saves && (!m_PipelineCacheSave || m_PipelineCacheSave->done()) && pipeline_cache.save_due()) {
+            m_PipelineCacheSave = jobs.schedule("save_pipeline_cache", [&pipeline_cache] { pipeline_cache.save(); });
+        }
     }
 
     void Application::internal_render_frame() {
+        using clock = std::chrono::steady_clock;
+
         try {
-            const auto frame_info = m_Window->get_surface()->begin_frame();
+            const auto acquire_start = clock::now();
+            const auto frame_info    = m_RenderTarget->begin_frame();
+            const auto record_start  = clock::now();
 
-            const auto &cmd = m_CommandBuffers[frame_info.frame_index];
-            cmd.reset();
+            m_CommandPools->begin_frame(frame_info.frame_index);
+            m_AsyncCompute->begin_frame(frame_info.frame_index);
+            m_FrameRing->begin_frame(frame_info.frame_index);
+            const auto &cmd = m_CommandPools->primary(frame_info.frame_index);
             cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+            // Uploads which haven't finished on the transfer queue yet are left for a later frame rather than making this one wait for them.
+            m_Uploads->flush();
+            const auto upload_wait = m_Uploads->acquire(cmd, DeviceQueue::Primary);
+
             render_frame(cmd, frame_info);
+            m_RenderTarget->record_frame_end(cmd, frame_info);
             cmd.end();
 
-            vk::SemaphoreSubmitInfo     ia_sem{*frame_info.sync_info.image_available_semaphore, 0, vk::PipelineStageFlagBits2::eTopOfPipe};
+            const auto submit_start = clock::now();
+
             vk::SemaphoreSubmitInfo     rf_sem{*frame_info.sync_info.render_finished_semaphore, 0, vk::PipelineStageFlagBits2::eBottomOfPipe};
             vk::CommandBufferSubmitInfo cbsi{*cmd, 0};
 
-            const vk::SubmitInfo2 si{{}, ia_sem, cbsi, rf_sem};
-            m_EngineContext->vulkan()->queues().primary.main.submit2(si, frame_info.sync_info.in_flight_fence);
+            // Headless targets have no binary semaphores, everything else about the frame is synchronized through the primary queue's timeline.
+            auto waits = m_AsyncCompute->take_frame_waits();
+            if (*frame_info.sync_info.image_available_semaphore) {
+                waits.emplace_back(*frame_info.sync_info.image_available_semaphore, 0, RenderTarget::ACQUIRE_WAIT_STAGE);
+            }
+            if (upload_wait.has_value()) {
+                waits.push_back(upload_wait.value());
+            }
+
+            const uint32_t signal_count = *frame_info.sync_info.render_finished_semaphore ? 1 : 0;
+            const uint64_t frame_value  = m_EngineContext->vulkan()->submit(
+                DeviceQueue::Primary, cbsi, waits, vk::ArrayProxy<const vk::SemaphoreSubmitInfo>(signal_count, &rf_sem)
+            );
+            m_FrameRing->end_frame(frame_value);
+            if (m_Bindless) {
+                m_Bindless->end_frame();
+            }
 
-            m_Window->get_surface()->end_frame(frame_info);
+            // After the frame, so background work never gets to the queue ahead of it.
+            m_GpuTasks->pump();
+            m_EngineContext->vulkan()->deletion_queue().end_frame();
+
+            const auto present_start = clock::now();
+            m_RenderTarget->end_frame(frame_info, frame_value);
+            const auto frame_end = clock::now();
+
+            m_LastFrameTimings = FrameTimings{
+                .acquire = record_start - acquire_start,
+                .record  = submit_start - record_start,
+                .submit  = present_start - submit_start,
+                .present = frame_end - present_start,
+            };
         } catch (vk::OutOfDateKHRError &error) {
-            m_Window->get_surface()->recreate_swapchain();
+            m_RenderTarget->recreate_swapchain();
+        }
+    }
+
+    void Application::record_parallel(
+        const vk::raii::CommandBuffer &cmd, const FrameInfo &frame_info, const size_t count, const RecordFunction &record, const vk::CommandBufferInheritanceRenderingInfo *rendering,
+        const size_t min_items_per_chunk
+    ) {
+        if (count == 0) {
+            return;
+        }
+
+        const size_t max_chunks = (count + std::max<size_t>(min_items_per_chunk, 1) - 1) / std::max<size_t>(min_items_per_chunk, 1);
+        const size_t chunks     = std::min<size_t>(m_CommandPools->worker_count(), max_chunks);
+        const size_t chunk_size = (count + chunks - 1) / chunks;
+
+        // Grab every secondary command buffer up front on this thread, the pools themselves are only touched by their own worker after this.
+        std::vector<const vk::raii::CommandBuffer *> secondaries(chunks);
+        for (size_t i = 0; i < chunks; i++) {
+            secondaries[i] = &m_CommandPools->secondary(frame_info.frame_index, static_cast<uint32_t>(i));
+        }
+
+        vk::CommandBufferInheritanceInfo inheritance{};
+        vk::CommandBufferUsageFlags      usage = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        if (rendering) {
+            inheritance.pNext = rendering;
+            usage |= vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+        }
+
+        const auto record_chunk = [&](const size_t chunk) {
+            const auto  first     = chunk * chunk_size;
+            const auto  last      = std::min(count, first + chunk_size);
+            const auto &secondary = *secondaries[chunk];
+
+            secondary.begin(vk::CommandBufferBeginInfo(usage, &inheritance));
+            record(secondary, first, last);
+            secondary.end();
+        };
+
+        // Each chunk's pool is only ever used by that chunk's job, so it doesn't matter which worker ends up running it.
+        auto &jobs    = m_EngineContext->jobs();
+        auto  counter = std::make_shared<JobCounter>();
+        for (size_t i = 1; i < chunks; i++) {
+            jobs.schedule("record_parallel", [&record_chunk, i] { record_chunk(i); }, counter);
+        }
+
+        std::exception_ptr error;
+        try {
+            record_chunk(0);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        // The other chunks reference locals of this function, so wait for them even if the first chunk failed.
+        jobs.wait(counter);
+        if (error) {
+            std::rethrow_exception(error);
+        }
+
+        std::vector<vk::CommandBuffer> handles;
+        handles.reserve(chunks);
+        for (const auto *secondary : secondaries) {
+            handles.push_back(**secondary);
         }
+        cmd.executeCommands(handles);
     }
 
     void run(const std::shared_ptr<Application> &app) {
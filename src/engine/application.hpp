@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+#include <functional>
 #include <optional>
 #include <string>
 
@@ -9,33 +11,185 @@
 #include <spdlog/spdlog.h>
 
 #include "engine/engine_context.hpp"
+#include "engine/renderer/async_compute.hpp"
+#include "engine/renderer/bindless_heap.hpp"
+#include "engine/renderer/command_pool_ring.hpp"
+#include "engine/renderer/frame_ring_buffer.hpp"
+#include "engine/renderer/gpu_task_scheduler.hpp"
+#include "engine/renderer/headless_surface.hpp"
+#include "engine/renderer/pipeline_manager.hpp"
+#include "engine/renderer/render_target.hpp"
+#include "engine/renderer/upload_service.hpp"
 
 namespace engine {
 
+    /**
+     * CPU time spent in each stage of the last frame driven by `Application::internal_render_frame`.
+     */
+    struct FrameTimings {
+        /**
+         * Time spent in `RenderTarget::begin_frame`, which includes waiting for the frame slot to become free and acquiring a swapchain image.
+         */
+        std::chrono::nanoseconds acquire{};
+        std::chrono::nanoseconds record{};
+        std::chrono::nanoseconds submit{};
+
+        /**
+         * Time spent in `RenderTarget::end_frame` (presentation for a swapchain).
+         */
+        std::chrono::nanoseconds present{};
+    };
+
     class Application {
       public:
-        Application();
+        /**
+         * How many render snapshots applications need to keep. `update` fills one of them for the next frame while `render_frame` reads the other one.
+         */
+        static constexpr uint32_t SNAPSHOT_COUNT = 2;
+
+        explicit Application(const EngineSettings &settings = {});
         virtual ~Application();
 
         [[nodiscard]] virtual std::optional<crash> verify_system() const;
 
         void run();
 
+        /**
+         * Ask the main loop to stop after the current frame. This is the only way a headless application will ever exit on its own.
+         */
+        inline void request_exit() { m_ExitRequested = true; };
+
         [[nodiscard]] inline const std::shared_ptr<EngineContext> &engine() const { return m_EngineContext; };
 
+        /**
+         * The offscreen target frames are rendered into when running headless, or null when rendering to a window.
+         */
+        [[nodiscard]] inline HeadlessSurface *headless_surface() const { return m_HeadlessSurface.get(); };
+
+        [[nodiscard]] inline const FrameTimings &last_frame_timings() const { return m_LastFrameTimings; };
+
+        /**
+         * Uploads for the primary queue are flushed and acquired at the start of every frame, anything which is `ready` by then can be used in `render_frame`.
+         */
+        [[nodiscard]] inline UploadService &uploads() const { return *m_Uploads; };
+
+        /**
+         * Compute work submitted from `render_frame`. Waits added with `AsyncCompute::wait_in_frame` are included in the frame's submission.
+         */
+        [[nodiscard]] inline AsyncCompute &async_compute() const { return *m_AsyncCompute; };
+
+        /**
+         * Transient per-frame data (constants, dynamic vertices, ...). Allocations made while recording a frame stay valid until that frame finishes on the GPU.
+         */
+        [[nodiscard]] inline FrameRingBuffer &frame_ring() const { return *m_FrameRing; };
+
+        /**
+         * The global bindless descriptor table, or null if the device doesn't support bindless descriptors (see `DeviceCapabilities::bindless`).
+         */
+        [[nodiscard]] inline BindlessHeap *bindless() const { return m_Bindless.get(); };
+
+        /**
+         * Where pipelines should come from, so creating one never stalls a frame.
+         */
+        [[nodiscard]] inline PipelineManager &pipelines() const { return *m_Pipelines; };
+
+        /**
+         * Background GPU work on the low priority queues. Pumped after every frame is submitted.
+         */
+        [[nodiscard]] inline GpuTaskScheduler &gpu_tasks() const { return *m_GpuTasks; };
+
+        /**
+         * Change how many frames may be in flight, resizing every per-frame resource to match. This waits for the frames currently in flight to finish. It must not be called
+         * from `render_frame`.
+         */
+        void set_frames_in_flight(uint32_t count);
+
+        /**
+         * Change how many images the main window's swapchain should have (0 for the default). Does nothing when running headless.
+         */
+        void set_swapchain_image_count(uint32_t count);
+
+        /**
+         * Simulate the next frame and write everything rendering it needs into snapshot `snapshot`. This runs on a job system worker at the same time as `render_frame` records
+         * the previous frame (from the other snapshot), so it must not touch anything `render_frame` reads other than its own snapshot.
+         *
+         * @param delta Time since the previous update.
+         */
+        virtual void update(uint32_t snapshot, std::chrono::nanoseconds delta) {}
+
         virtual void render_frame(const vk::raii::CommandBuffer &cmd, const FrameInfo &frame_info) = 0;
 
+        /**
+         * The snapshot `render_frame` should render from.
+         */
+        [[nodiscard]] inline uint32_t render_snapshot() const { return m_RenderSnapshot; };
+
+        /**
+         * Records into a secondary command buffer. `first` and `last` are the (half-open) range of items it has to record.
+         */
+        using RecordFunction = std::function<void(const vk::raii::CommandBuffer &cmd, size_t first, size_t last)>;
+
+        /**
+         * Split `count` items into contiguous chunks, record each chunk into its own secondary command buffer on a different thread, and execute them from `cmd` in order (so the
+         * result is the same as recording every item into `cmd` directly). This can only be called from `render_frame`.
+         *
+         * To use this inside of dynamic rendering, begin rendering with `vk::RenderingFlagBits::eContentsSecondaryCommandBuffers` and pass the matching inheritance info as
+         * `rendering`. Outside of rendering, pass null.
+         *
+         * @param min_items_per_chunk Lower bound on how many items are recorded per thread, so small amounts of work aren't split up more than is worth it.
+         */
+        void record_parallel(
+            const vk::raii::CommandBuffer &cmd, const FrameInfo &frame_info, size_t count, const RecordFunction &record,
+            const vk::CommandBufferInheritanceRenderingInfo *rendering = nullptr, size_t min_items_per_chunk = 1
+        );
+
+      protected:
+        /**
+         * Set up everything `internal_render_frame` needs (engine context, render target, command buffers). `run()` calls this for you, it's only exposed for things that need
+         * to drive frames manually (like the benchmark harness).
+         */
+        void startup();
+
+        /**
+         * Run one step of the frame pipeline: update the next frame on the job system while the current one is rendered, then swap snapshots once both are done.
+         */
+        void internal_frame();
+
+        void internal_render_frame();
+
+        void shutdown();
+
+        [[nodiscard]] bool is_running() const;
+
       private:
         void internal_verify_system() const;
         void build_context();
 
-        void internal_render_frame();
+        EngineSettings m_Settings;
+        bool           m_ExitRequested = false;
+        FrameTimings   m_LastFrameTimings;
 
-        vk::raii::CommandPool    m_CommandPool    = nullptr;
-        vk::raii::CommandBuffers m_CommandBuffers = nullptr;
+        uint32_t                              m_RenderSnapshot = 0;
+        std::chrono::steady_clock::time_point m_LastUpdate;
+
+        // The last periodic save of the pipeline cache, which may still be running.
+        JobCounterHandle m_PipelineCacheSave;
 
         std::shared_ptr<EngineContext> m_EngineContext;
         std::shared_ptr<WindowManager> m_WindowManager;
+
+        std::unique_ptr<HeadlessSurface> m_HeadlessSurface;
+        Window                          *m_MainWindow   = nullptr;
+        RenderTarget                    *m_RenderTarget = nullptr;
+
+        // Declared after the engine context so these are destroyed while the device still exists.
+        std::optional<CommandPoolRing> m_CommandPools;
+        std::unique_ptr<UploadService>    m_Uploads;
+        std::unique_ptr<AsyncCompute>     m_AsyncCompute;
+        std::unique_ptr<FrameRingBuffer>  m_FrameRing;
+        std::unique_ptr<GpuTaskScheduler> m_GpuTasks;
+        std::unique_ptr<PipelineManager>  m_Pipelines;
+        std::unique_ptr<BindlessHeap>     m_Bindless;
     };
 
     void run(const std::shared_ptr<Application> &app);
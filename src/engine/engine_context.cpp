@@ -3,7 +3,7 @@
 #include <stdexcept>
 
 namespace engine {
-    EngineContext::EngineContext() = default;
+    EngineContext::EngineContext(const EngineSettings &settings) : m_Settings(settings), m_Jobs(std::make_unique<JobSystem>(settings.worker_threads)) {}
 
     void EngineContext::init() {
         m_VulkanContext = VulkanContext::create(shared_from_this());
@@ -14,6 +14,10 @@ namespace engine {
     }
 
     const DebugSettings &EngineContext::debug_settings() const {
-        return m_DebugSettings;
+        return m_Settings.debug;
+    }
+
+    const EngineSettings &EngineContext::settings() const {
+        return m_Settings;
     }
 } // engine
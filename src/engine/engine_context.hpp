@@ -3,8 +3,11 @@
 #include "engine/window.hpp"
 #include "window_manager.hpp"
 
+#include "engine/job_system.hpp"
+#include "engine/renderer/frame_pacer.hpp"
 #include "engine/renderer/vulkan_context.hpp"
 
+#include <filesystem>
 #include <memory>
 
 namespace engine {
@@ -31,13 +34,80 @@ namespace engine {
         bool enable_render_graph_checking = false;
     };
 
+    /**
+     * Startup configuration for the engine. This can't be changed once the engine context has been created.
+     */
+    struct EngineSettings {
+        DebugSettings debug;
+
+        /**
+         * Run without any windowing system. Rendering goes into offscreen images (see `engine::HeadlessSurface`) instead of a swapchain, and GLFW is never initialized. This is
+         * meant for CI and benchmarking machines which may only have a software Vulkan driver (lavapipe) and no display.
+         */
+        bool headless = false;
+
+        /**
+         * Size of the offscreen images used when running headless.
+         */
+        vk::Extent2D headless_extent = {1280, 720};
+
+        /**
+         * How many frames the CPU may get ahead of the GPU by (see `engine::RenderTarget::set_frames_in_flight`). This can be changed later with
+         * `engine::Application::set_frames_in_flight`.
+         */
+        uint32_t frames_in_flight = 2;
+
+        /**
+         * How many bytes each frame gets for transient data (see `engine::FrameRingBuffer`). Frames which need more still work, just slower.
+         */
+        uint64_t frame_ring_capacity = 4 * 1024 * 1024;
+
+        /**
+         * How many images to ask for when creating swapchains. 0 means one more than the minimum the surface needs. This can be changed later with
+         * `engine::Application::set_swapchain_image_count`.
+         */
+        uint32_t swapchain_image_count = 0;
+
+        /**
+         * Present with vsync (fifo) instead of the lowest latency present mode available.
+         */
+        bool vsync = false;
+
+        /**
+         * How windows pace frames against the display (see `engine::FramePacer`).
+         */
+        FramePacingSettings frame_pacing;
+
+        /**
+         * Where the engine keeps things it caches between runs (the chosen GPU, pipeline caches, ...).
+         */
+        std::filesystem::path cache_directory = "cache";
+
+        /**
+         * Save the pipeline cache every `engine::PipelineCache::SAVE_INTERVAL` while running, not just on shutdown. Benchmarks turn this off to keep the save out of
+         * their frame times.
+         */
+        bool periodic_pipeline_cache_saves = true;
+
+        /**
+         * How many worker threads the job system starts (not counting the main thread). 0 means one less than the number of hardware threads.
+         */
+        uint32_t worker_threads = 0;
+
+        /**
+         * How many threads may record command buffers for a frame (see `engine::Application::record_parallel`), including the thread driving the frame. 0 means one per job
+         * system worker.
+         */
+        uint32_t recording_threads = 0;
+    };
+
     class EngineContext : public std::enable_shared_from_this<EngineContext> {
-        EngineContext();
+        explicit EngineContext(const EngineSettings &settings);
         void init();
 
     public:
-        inline static std::shared_ptr<EngineContext> create() {
-            auto ctx = std::shared_ptr<EngineContext>(new EngineContext());
+        inline static std::shared_ptr<EngineContext> create(const EngineSettings &settings = {}) {
+            auto ctx = std::shared_ptr<EngineContext>(new EngineContext(settings));
             ctx->init();
             return ctx;
         };
@@ -64,12 +134,19 @@ namespace engine {
 
         [[nodiscard]] const DebugSettings& debug_settings() const;
 
+        [[nodiscard]] const EngineSettings& settings() const;
+
         [[nodiscard]] inline const std::shared_ptr<VulkanContext>& vulkan() const { return m_VulkanContext; };
+
+        [[nodiscard]] inline JobSystem& jobs() const { return *m_Jobs; };
       private:
-        DebugSettings m_DebugSettings;
+        EngineSettings m_Settings;
 
         std::shared_ptr<VulkanContext> m_VulkanContext;
 
+        // Declared after the vulkan context so workers are stopped before anything they might be using is destroyed.
+        std::unique_ptr<JobSystem> m_Jobs;
+
         std::shared_ptr<WindowManager> m_WindowManager;
     };
 
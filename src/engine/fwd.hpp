@@ -5,4 +5,7 @@ namespace engine {
     class VulkanContext;
     class Window;
     class Surface;
+    class RenderTarget;
+    class HeadlessSurface;
+    class TrackedImage;
 }
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "job_system.hpp"
+
+#include <algorithm>
+
+namespace engine {
+    namespace {
+        struct WorkerIdentity {
+            const JobSystem *system = nullptr;
+            uint32_t         index  = 0;
+        };
+
+        thread_local WorkerIdentity t_Worker;
+    } // namespace
+
+    JobSystem::JobSystem(uint32_t thread_count) {
+        if (thread_count == 0) {
+            thread_count = std::max(1u, std::thread::hardware_concurrency()) - 1;
+        }
+
+        m_Workers.reserve(thread_count + 1);
+        for (uint32_t i = 0; i <= thread_count; i++) {
+            m_Workers.push_back(std::make_unique<Worker>());
+        }
+
+        m_Threads.reserve(thread_count);
+        for (uint32_t i = 1; i <= thread_count; i++) {
+            m_Threads.emplace_back(&JobSystem::worker_main, this, i);
+        }
+    }
+
+    JobSystem::~JobSystem() {
+        {
+            std::lock_guard lock(m_SleepMutex);
+            m_Stopping = true;
+        }
+        m_WakeUp.notify_all();
+
+        for (auto &thread : m_Threads) {
+            thread.join();
+        }
+    }
+
+    uint32_t JobSystem::current_worker() const {
+        return t_Worker.system == this ? t_Worker.index : 0;
+    }
+
+    JobCounterHandle JobSystem::schedule(const char *name, Job job, JobCounterHandle counter) {
+        if (!counter) {
+            counter = std::make_shared<JobCounter>();
+        }
+
+        counter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+        push(QueuedJob{.name = name, .job = std::move(job), .counter = counter});
+        return counter;
+    }
+
+    JobCounterHandle JobSystem::then(const JobCounterHandle &counter, const char *name, Job job) {
+        auto continuation = std::make_shared<JobCounter>();
+        continuation->m_Pending.fetch_add(1, std::memory_order_relaxed);
+
+        QueuedJob queued{.name = name, .job = std::move(job), .counter = continuation};
+        {
+            std::lock_guard lock(counter->m_Mutex);
+            if (!counter->done()) {
+                // `finish` takes the same lock before running continuations, so this can't be missed.
+                counter->m_Continuations.emplace_back([this, queued = std::move(queued)]() mutable { push(std::move(queued)); });
+                return continuation;
+            }
+        }
+
+        push(std::move(queued));
+        return continuation;
+    }
+
+    void JobSystem::wait(const JobCounterHandle &counter) {
+        const uint32_t worker = current_worker();
+        while (!counter->done()) {
+            QueuedJob job;
+            if (pop(worker, job)) {
+                run(worker, job);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+
+        if (counter->m_Error) {
+            std::rethrow_exception(counter->m_Error);
+        }
+    }
+
+    void JobSystem::parallel_for(const char *name, const size_t count, const size_t min_batch, const std::function<void(size_t first, size_t last)> &body) {
+        if (count == 0) {
+            return;
+        }
+
+        const size_t batch = std::max(std::max<size_t>(min_batch, 1), (count + worker_count() - 1) / worker_count());
+        if (batch >= count) {
+            body(0, count);
+            return;
+        }
+
+        auto counter = std::make_shared<JobCounter>();
+        for (size_t first = batch; first < count; first += batch) {
+            schedule(name, [&body, first, last = std::min(count, first + batch)] { body(first, last); }, counter);
+        }
+
+        // The calling thread would only be helping in `wait` anyway, so it does the first batch itself.
+        std::exception_ptr error;
+        try {
+            body(0, batch);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        // Always wait (even if the first batch threw) since the other batches reference `body`.
+        wait(counter);
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    std::vector<JobTiming> JobSystem::take_timings() {
+        std::vector<JobTiming> timings;
+        for (const auto &worker : m_Workers) {
+            std::lock_guard lock(worker->mutex);
+            timings.insert(timings.end(), worker->timings.begin(), worker->timings.end());
+            worker->timings.clear();
+        }
+
+        std::ranges::sort(timings, {}, &JobTiming::start);
+        return timings;
+    }
+
+    void JobSystem::push(QueuedJob job) {
+        auto &worker = *m_Workers[current_worker()];
+        {
+            std::lock_guard lock(worker.mutex);
+            worker.jobs.push_back(std::move(job));
+        }
+
+        m_Queued.fetch_add(1, std::memory_order_release);
+        {
+            // Taking the lock orders this with a worker that has just checked `m_Queued` and is about to sleep.
+            std::lock_guard lock(m_SleepMutex);
+        }
+        m_WakeUp.notify_one();
+    }
+
+    bool JobSystem::pop(const uint32_t worker, QueuedJob &job) {
+        {
+            auto           &own = *m_Workers[worker];
+            std::lock_guard lock(own.mutex);
+            if (!own.jobs.empty()) {
+                job = std::move(own.jobs.back());
+                own.jobs.pop_back();
+                m_Queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        for (size_t offset = 1; offset < m_Workers.size(); offset++) {
+            auto           &victim = *m_Workers[(worker + offset) % m_Workers.size()];
+            std::lock_guard lock(victim.mutex);
+            if (!victim.jobs.empty()) {
+                job = std::move(victim.jobs.front());
+                victim.jobs.pop_front();
+                m_Queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void JobSystem::run(const uint32_t worker, QueuedJob &job) {
+        const bool profiling = m_Profiling.load(std::memory_order_relaxed);
+        const auto start     = profiling ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+
+        try {
+            job.job();
+        } catch (...) {
+            std::lock_guard lock(job.counter->m_Mutex);
+            if (!job.counter->m_Error) {
+                job.counter->m_Error = std::current_exception();
+            }
+        }
+
+        if (profiling) {
+            const auto      end = std::chrono::steady_clock::now();
+            auto           &own = *m_Workers[worker];
+            std::lock_guard lock(own.mutex);
+            own.timings.push_back(JobTiming{.name = job.name, .worker = worker, .start = start, .end = end});
+        }
+
+        // Release the job (and anything it captured) before anyone waiting on it can observe it as finished.
+        job.job = nullptr;
+        finish(job.counter);
+    }
+
+    void JobSystem::finish(const JobCounterHandle &counter) {
+        std::vector<std::function<void()>> continuations;
+        {
+            std::lock_guard lock(counter->m_Mutex);
+            if (counter->m_Pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                return;
+            }
+            continuations = std::move(counter->m_Continuations);
+            counter->m_Continuations.clear();
+        }
+
+        for (auto &continuation : continuations) {
+            continuation();
+        }
+    }
+
+    void JobSystem::worker_main(const uint32_t worker) {
+        t_Worker = WorkerIdentity{.system = this, .index = worker};
+
+        while (true) {
+            QueuedJob job;
+            if (pop(worker, job)) {
+                run(worker, job);
+                continue;
+            }
+
+            std::unique_lock lock(m_SleepMutex);
+            m_WakeUp.wait(lock, [this] { return m_Stopping || m_Queued.load(std::memory_order_acquire) > 0; });
+            if (m_Stopping) {
+                return;
+            }
+        }
+    }
+} // namespace engine
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace engine {
+    class JobSystem;
+
+    /**
+     * Counts the jobs in a group which haven't finished yet. Waiting on a counter (`JobSystem::wait`) or attaching a continuation to it (`JobSystem::then`) is how dependencies
+     * between jobs are expressed.
+     */
+    class JobCounter {
+      public:
+        [[nodiscard]] inline bool done() const { return m_Pending.load(std::memory_order_acquire) == 0; }
+
+      private:
+        friend class JobSystem;
+
+        std::atomic<uint32_t> m_Pending = 0;
+
+        std::mutex                         m_Mutex;
+        std::vector<std::function<void()>> m_Continuations;
+
+        // The first exception thrown by any job in the group, rethrown by `JobSystem::wait`.
+        std::exception_ptr m_Error;
+    };
+
+    using JobCounterHandle = std::shared_ptr<JobCounter>;
+
+    /**
+     * When and where a job ran. These are only collected while profiling is enabled (see `JobSystem::set_profiling`).
+     */
+    struct JobTiming {
+        const char                           *name;
+        uint32_t                              worker;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::steady_clock::time_point end;
+    };
+
+    /**
+     * A fixed pool of worker threads which run jobs. Every thread has its own deque of jobs: jobs scheduled from a worker go onto its own deque (and are popped newest first,
+     * which keeps related work on the same core), and workers with nothing to do steal the oldest jobs from other workers.
+     *
+     * There are no fibers, so a job which waits on another job doesn't suspend. `wait` runs other jobs until the counter reaches zero instead. Work that would otherwise block a
+     * worker should be split into continuations (`then`).
+     *
+     * Worker 0 is whichever thread isn't a worker (usually the main thread). It only runs jobs while it's inside `wait`.
+     */
+    class JobSystem {
+      public:
+        using Job = std::function<void()>;
+
+        /**
+         * @param thread_count How many worker threads to start (not counting the thread the job system is used from). 0 means one less than the number of hardware threads.
+         */
+        explicit JobSystem(uint32_t thread_count = 0);
+        ~JobSystem();
+
+        JobSystem(const JobSystem &other)                = delete;
+        JobSystem(JobSystem &&other) noexcept            = delete;
+        JobSystem &operator=(const JobSystem &other)     = delete;
+        JobSystem &operator=(JobSystem &&other) noexcept = delete;
+
+        /**
+         * Run `job` on any worker.
+         *
+         * @param name Label for profiling, must outlive the job system (use string literals).
+         * @param counter Counter to add the job to. If this is null a new counter is created.
+         * @return The counter the job was added to.
+         */
+        JobCounterHandle schedule(const char *name, Job job, JobCounterHandle counter = nullptr);
+
+        /**
+         * Run `job` once every job added to `counter` so far has finished (immediately if they already have).
+         *
+         * @return A counter for the continuation itself.
+         */
+        JobCounterHandle then(const JobCounterHandle &counter, const char *name, Job job);
+
+        /**
+         * Block until every job in `counter` has finished, running other jobs in the meantime. Rethrows the first exception thrown by a job in the group.
+         */
+        void wait(const JobCounterHandle &counter);
+
+        /**
+         * Call `body(first, last)` for contiguous ranges covering `[0, count)`, each at least `min_batch` long, spread across the workers, and wait for all of them.
+         */
+        void parallel_for(const char *name, size_t count, size_t min_batch, const std::function<void(size_t first, size_t last)> &body);
+
+        /**
+         * How many threads may run jobs, including worker 0.
+         */
+        [[nodiscard]] inline uint32_t worker_count() const { return static_cast<uint32_t>(m_Workers.size()); }
+
+        /**
+         * The index of the calling thread in `[0, worker_count())`. Threads which aren't workers are all worker 0.
+         */
+        [[nodiscard]] uint32_t current_worker() const;
+
+        /**
+         * Start or stop collecting a `JobTiming` for every job that runs.
+         */
+        inline void set_profiling(const bool enabled) { m_Profiling.store(enabled, std::memory_order_relaxed); }
+
+        /**
+         * Take every timing collected since the last call.
+         */
+        [[nodiscard]] std::vector<JobTiming> take_timings();
+
+      private:
+        struct QueuedJob {
+            const char      *name = nullptr;
+            Job              job;
+            JobCounterHandle counter;
+        };
+
+        struct Worker {
+            std::mutex            mutex;
+            std::deque<QueuedJob> jobs;
+            std::vector<JobTiming> timings;
+        };
+
+        void push(QueuedJob job);
+
+        /**
+         * Take a job from `worker`'s own deque or steal one from someone else's.
+         */
+        [[nodiscard]] bool pop(uint32_t worker, QueuedJob &job);
+
+        void run(uint32_t worker, QueuedJob &job);
+
+        void finish(const JobCounterHandle &counter);
+
+        void worker_main(uint32_t worker);
+
+        std::vector<std::unique_ptr<Worker>> m_Workers;
+        std::vector<std::thread>             m_Threads;
+
+        // How many jobs are sitting in deques, so idle workers know when to go to sleep.
+        std::atomic<size_t>     m_Queued = 0;
+        std::mutex              m_SleepMutex;
+        std::condition_variable m_WakeUp;
+        bool                    m_Stopping = false;
+
+        std::atomic<bool> m_Profiling = false;
+    };
+} // namespace engine
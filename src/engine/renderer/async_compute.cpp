@@ -0,0 +1,61 @@
+#include "async_compute.hpp"
+
+#include "engine/tools.hpp"
+
+#include <utility>
+
+namespace engine {
+    AsyncCompute::AsyncCompute(const std::shared_ptr<VulkanContext> &ctx, const uint32_t frames_in_flight)
+        : m_Context(ctx), m_CommandPools(ctx, ctx->queue_family(DeviceQueue::Compute), frames_in_flight, 1), m_FrameValues(frames_in_flight) {}
+
+    AsyncCompute::~AsyncCompute() {
+        for (const auto &values : m_FrameValues) {
+            for (size_t queue = 0; queue < DEVICE_QUEUE_COUNT; queue++) {
+                if (values[queue] != 0) {
+                    m_Context->timeline(static_cast<DeviceQueue>(queue)).wait(values[queue]);
+                }
+            }
+        }
+    }
+
+    void AsyncCompute::begin_frame(const uint32_t frame_index) {
+        auto &values = m_FrameValues[frame_index];
+        for (size_t queue = 0; queue < DEVICE_QUEUE_COUNT; queue++) {
+            if (values[queue] != 0) {
+                m_Context->timeline(static_cast<DeviceQueue>(queue)).wait(values[queue]);
+                values[queue] = 0;
+            }
+        }
+
+        m_CommandPools.begin_frame(frame_index);
+
+        // Left over if the last frame failed before it was submitted.
+        m_FrameWaits.clear();
+    }
+
+    ComputeTicket AsyncCompute::submit(const uint32_t frame_index, const RecordFunction &record, const std::span<const vk::SemaphoreSubmitInfo> waits, const DeviceQueue queue) {
+        if (queue != DeviceQueue::Compute && queue != DeviceQueue::ComputeLowPriority) {
+            throw crash(CrashReason::CriticalFailure, "Async compute work can only be submitted to the compute queues.");
+        }
+
+        const auto &cmd = m_CommandPools.primary(frame_index);
+        cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        record(cmd);
+        cmd.end();
+
+        const auto                        resolved = m_Context->resolve(queue);
+        const vk::CommandBufferSubmitInfo cbsi{*cmd, 0};
+        const uint64_t                    value = m_Context->submit(resolved, cbsi, vk::ArrayProxy<const vk::SemaphoreSubmitInfo>(waits.size(), waits.data()));
+
+        m_FrameValues[frame_index][static_cast<size_t>(resolved)] = value;
+        return ComputeTicket{.queue = resolved, .value = value};
+    }
+
+    void AsyncCompute::wait_in_frame(const ComputeTicket &ticket, const vk::PipelineStageFlags2 stage) {
+        m_FrameWaits.push_back(m_Context->timeline(ticket.queue).wait_info(ticket.value, stage));
+    }
+
+    std::vector<vk::SemaphoreSubmitInfo> AsyncCompute::take_frame_waits() {
+        return std::exchange(m_FrameWaits, {});
+    }
+} // namespace engine
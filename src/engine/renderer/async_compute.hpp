@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "engine/renderer/command_pool_ring.hpp"
+#include "engine/renderer/vulkan_context.hpp"
+
+namespace engine {
+    /**
+     * A point on a queue's timeline which some submitted work signals.
+     */
+    struct ComputeTicket {
+        DeviceQueue queue = DeviceQueue::Compute;
+        uint64_t    value = 0;
+    };
+
+    /**
+     * Submits compute work for the current frame to the compute queue, so it overlaps with the frame's graphics work instead of being serialized in front of it.
+     *
+     * Work submitted with `submit` goes out immediately (ahead of the frame's own submission). Anything in the frame which consumes its results calls `wait_in_frame`, which
+     * makes the frame's submission wait on the compute queue's timeline at the stage that needs them, so graphics work before that stage still overlaps. Compute work which
+     * depends on graphics work (last frame's depth buffer for culling, for example) passes a wait on the primary queue's timeline to `submit`.
+     *
+     * Without an exclusive compute queue everything ends up on the primary queue, which is still correct, just not concurrent. Resources used on both queues must either be
+     * created with concurrent sharing or be handed over with queue family ownership transfers.
+     */
+    class AsyncCompute {
+      public:
+        using RecordFunction = std::function<void(const vk::raii::CommandBuffer &cmd)>;
+
+        AsyncCompute(const std::shared_ptr<VulkanContext> &ctx, uint32_t frames_in_flight);
+
+        /**
+         * Waits for all submitted work, since its command buffers are about to be freed.
+         */
+        ~AsyncCompute();
+
+        AsyncCompute(const AsyncCompute &other)                = delete;
+        AsyncCompute(AsyncCompute &&other) noexcept            = delete;
+        AsyncCompute &operator=(const AsyncCompute &other)     = delete;
+        AsyncCompute &operator=(AsyncCompute &&other) noexcept = delete;
+
+        /**
+         * Wait for the work previously submitted from `frame_index` and reuse its command buffers.
+         */
+        void begin_frame(uint32_t frame_index);
+
+        /**
+         * Record work with `record` and submit it right away.
+         *
+         * @param waits Semaphore waits for the submission (usually on the primary queue's timeline).
+         * @param queue `DeviceQueue::Compute` or `DeviceQueue::ComputeLowPriority`.
+         * @return The timeline value which signals the work is done.
+         */
+        ComputeTicket submit(uint32_t frame_index, const RecordFunction &record, std::span<const vk::SemaphoreSubmitInfo> waits = {}, DeviceQueue queue = DeviceQueue::Compute);
+
+        /**
+         * Make the current frame's submission wait for `ticket` before `stage`.
+         */
+        void wait_in_frame(const ComputeTicket &ticket, vk::PipelineStageFlags2 stage);
+
+        /**
+         * Take the waits added by `wait_in_frame` since the last call. The application does this when it submits the frame.
+         */
+        [[nodiscard]] std::vector<vk::SemaphoreSubmitInfo> take_frame_waits();
+
+        [[nodiscard]] inline uint32_t frames_in_flight() const { return m_CommandPools.frames_in_flight(); }
+
+      private:
+        std::shared_ptr<VulkanContext> m_Context;
+        CommandPoolRing                m_CommandPools;
+
+        // The last value submitted to each (resolved) queue from each frame slot.
+        std::vector<std::array<uint64_t, DEVICE_QUEUE_COUNT>> m_FrameValues;
+
+        std::vector<vk::SemaphoreSubmitInfo> m_FrameWaits;
+    };
+} // namespace engine
@@ -0,0 +1,108 @@
+#include "barrier_batch.hpp"
+
+namespace engine {
+    static bool is_ownership_transfer(const uint32_t src_family, const uint32_t dst_family) {
+        return src_family != dst_family;
+    }
+
+    static bool same_range(const vk::ImageSubresourceRange &a, const vk::ImageSubresourceRange &b) {
+        return a.aspectMask == b.aspectMask && a.baseMipLevel == b.baseMipLevel && a.levelCount == b.levelCount && a.baseArrayLayer == b.baseArrayLayer &&
+               a.layerCount == b.layerCount;
+    }
+
+    void BarrierBatch::image(const vk::Image image, const vk::ImageSubresourceRange &range, const ImageState &src, const ImageState &dst) {
+        this->image(vk::ImageMemoryBarrier2{src.stage, src.access, dst.stage, dst.access, src.layout, dst.layout, src.owner, dst.owner, image, range});
+    }
+
+    void BarrierBatch::image(const vk::ImageMemoryBarrier2 &barrier) {
+        if (!is_ownership_transfer(barrier.srcQueueFamilyIndex, barrier.dstQueueFamilyIndex)) {
+            for (auto &pending : m_ImageBarriers) {
+                if (pending.image != barrier.image || !same_range(pending.subresourceRange, barrier.subresourceRange) ||
+                    is_ownership_transfer(pending.srcQueueFamilyIndex, pending.dstQueueFamilyIndex)) {
+                    continue;
+                }
+
+                // A transition that doesn't start where the pending one ends points at a state tracking bug. Merging would hide that (and transition from a layout
+                // nobody asked for), so both are recorded as they are.
+                if (barrier.oldLayout != pending.newLayout && barrier.oldLayout != vk::ImageLayout::eUndefined) {
+                    continue;
+                }
+
+                pending.srcStageMask |= barrier.srcStageMask;
+                pending.srcAccessMask |= barrier.srcAccessMask;
+                pending.dstStageMask |= barrier.dstStageMask;
+                pending.dstAccessMask |= barrier.dstAccessMask;
+                if (barrier.oldLayout == vk::ImageLayout::eUndefined && barrier.newLayout != pending.newLayout) {
+                    // The second transition doesn't care about the contents, so neither does the merged one.
+                    pending.oldLayout = vk::ImageLayout::eUndefined;
+                }
+                pending.newLayout = barrier.newLayout;
+                return;
+            }
+        }
+
+        m_ImageBarriers.push_back(barrier);
+    }
+
+    void BarrierBatch::buffer(const vk::Buffer buffer, const vk::DeviceSize offset, const vk::DeviceSize size, const BufferState &src, const BufferState &dst) {
+        this->buffer(vk::BufferMemoryBarrier2{src.stage, src.access, dst.stage, dst.access, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, buffer, offset, size});
+    }
+
+    void BarrierBatch::buffer(const vk::BufferMemoryBarrier2 &barrier) {
+        if (!is_ownership_transfer(barrier.srcQueueFamilyIndex, barrier.dstQueueFamilyIndex)) {
+            for (auto &pending : m_BufferBarriers) {
+                if (pending.buffer != barrier.buffer || pending.offset != barrier.offset || pending.size != barrier.size ||
+                    is_ownership_transfer(pending.srcQueueFamilyIndex, pending.dstQueueFamilyIndex)) {
+                    continue;
+                }
+
+                pending.srcStageMask |= barrier.srcStageMask;
+                pending.srcAccessMask |= barrier.srcAccessMask;
+                pending.dstStageMask |= barrier.dstStageMask;
+                pending.dstAccessMask |= barrier.dstAccessMask;
+                return;
+            }
+        }
+
+        m_BufferBarriers.push_back(barrier);
+    }
+
+    void BarrierBatch::global(const BufferState &src, const BufferState &dst) {
+        global(vk::MemoryBarrier2{src.stage, src.access, dst.stage, dst.access});
+    }
+
+    void BarrierBatch::global(const vk::MemoryBarrier2 &barrier) {
+        m_GlobalBarrier.srcStageMask |= barrier.srcStageMask;
+        m_GlobalBarrier.srcAccessMask |= barrier.srcAccessMask;
+        m_GlobalBarrier.dstStageMask |= barrier.dstStageMask;
+        m_GlobalBarrier.dstAccessMask |= barrier.dstAccessMask;
+        m_HasGlobalBarrier = true;
+    }
+
+    void BarrierBatch::record(const vk::raii::CommandBuffer &cmd) const {
+        if (empty()) {
+            return;
+        }
+
+        vk::DependencyInfo dependency_info{};
+        dependency_info.setImageMemoryBarriers(m_ImageBarriers);
+        dependency_info.setBufferMemoryBarriers(m_BufferBarriers);
+        if (m_HasGlobalBarrier) {
+            dependency_info.setMemoryBarriers(m_GlobalBarrier);
+        }
+
+        cmd.pipelineBarrier2(dependency_info);
+    }
+
+    void BarrierBatch::flush(const vk::raii::CommandBuffer &cmd) {
+        record(cmd);
+        clear();
+    }
+
+    void BarrierBatch::clear() {
+        m_ImageBarriers.clear();
+        m_BufferBarriers.clear();
+        m_GlobalBarrier    = vk::MemoryBarrier2{};
+        m_HasGlobalBarrier = false;
+    }
+} // namespace engine
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "engine/renderer/vulkan_context.hpp"
+
+namespace engine {
+    struct BufferState {
+        vk::AccessFlags2        access;
+        vk::PipelineStageFlags2 stage;
+    };
+
+    /**
+     * Collects barriers so they can all be recorded with a single `pipelineBarrier2`.
+     *
+     * Transitions of the same subresource (same image and exactly the same subresource range, or the same buffer range) are merged: adding A -> B and then B -> C results in a
+     * single A -> C barrier which waits for the source scopes of both and blocks the destination scopes of both. Image transitions are only merged when the second one starts
+     * from the first one's new layout (or from undefined). Global memory barriers are all folded into one. Queue family ownership transfers are never merged with anything.
+     */
+    class BarrierBatch {
+      public:
+        void image(vk::Image image, const vk::ImageSubresourceRange &range, const ImageState &src, const ImageState &dst);
+        void image(const vk::ImageMemoryBarrier2 &barrier);
+
+        void buffer(vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size, const BufferState &src, const BufferState &dst);
+        void buffer(const vk::BufferMemoryBarrier2 &barrier);
+
+        void global(const BufferState &src, const BufferState &dst);
+        void global(const vk::MemoryBarrier2 &barrier);
+
+        /**
+         * Record every pending barrier (if there are any) without clearing them, so the same batch can be recorded again.
+         */
+        void record(const vk::raii::CommandBuffer &cmd) const;
+
+        /**
+         * Record every pending barrier (if there are any) and clear the batch.
+         */
+        void flush(const vk::raii::CommandBuffer &cmd);
+
+        void clear();
+
+        [[nodiscard]] inline bool empty() const { return m_ImageBarriers.empty() && m_BufferBarriers.empty() && !m_HasGlobalBarrier; }
+
+        [[nodiscard]] inline size_t size() const { return m_ImageBarriers.size() + m_BufferBarriers.size() + (m_HasGlobalBarrier ? 1 : 0); }
+
+      private:
+        std::vector<vk::ImageMemoryBarrier2>  m_ImageBarriers;
+        std::vector<vk::BufferMemoryBarrier2> m_BufferBarriers;
+        vk::MemoryBarrier2                    m_GlobalBarrier{};
+        bool                                  m_HasGlobalBarrier = false;
+    };
+} // namespace engine
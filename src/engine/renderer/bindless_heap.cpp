@@ -0,0 +1,187 @@
+#include "bindless_heap.hpp"
+
+#include "engine/tools.hpp"
+
+#include <algorithm>
+#include <format>
+
+#include <spdlog/spdlog.h>
+
+namespace engine {
+    static constexpr std::array<vk::DescriptorType, BINDLESS_TYPE_COUNT> DESCRIPTOR_TYPES = {
+        vk::DescriptorType::eSampledImage,
+        vk::DescriptorType::eSampler,
+        vk::DescriptorType::eStorageImage,
+        vk::DescriptorType::eStorageBuffer,
+    };
+
+    static constexpr std::array<const char *, BINDLESS_TYPE_COUNT> TYPE_NAMES = {"sampled image", "sampler", "storage image", "storage buffer"};
+
+    IndexAllocator::IndexAllocator(const uint32_t capacity) : m_Capacity(capacity) {}
+
+    uint32_t IndexAllocator::allocate() {
+        std::lock_guard lock(m_Mutex);
+        if (!m_Free.empty()) {
+            const uint32_t index = m_Free.back();
+            m_Free.pop_back();
+            return index;
+        }
+
+        return m_Next < m_Capacity ? m_Next++ : INVALID;
+    }
+
+    void IndexAllocator::release(const uint32_t index) {
+        std::lock_guard lock(m_Mutex);
+        m_Free.push_back(index);
+    }
+
+    uint32_t IndexAllocator::used() const {
+        std::lock_guard lock(m_Mutex);
+        return m_Next - static_cast<uint32_t>(m_Free.size());
+    }
+
+    BindlessHeap::PendingRelease::~PendingRelease() {
+        for (size_t type = 0; type < BINDLESS_TYPE_COUNT; type++) {
+            if (!allocators[type]) {
+                continue;
+            }
+            for (const auto index : indices[type]) {
+                allocators[type]->release(index);
+            }
+        }
+    }
+
+    BindlessHeap::BindlessHeap(const std::shared_ptr<VulkanContext> &ctx, const BindlessHeapSettings &settings) : m_Context(ctx) {
+        if (!ctx->capabilities().bindless) {
+            throw crash(CrashReason::UnsupportedSystem, "The bindless descriptor heap needs descriptor indexing with update-after-bind, which this GPU doesn't support.");
+        }
+
+        const auto  properties = ctx->physical_device().getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>();
+        const auto &limits     = properties.get<vk::PhysicalDeviceVulkan12Properties>();
+
+        const std::array<uint32_t, BINDLESS_TYPE_COUNT> max_counts = {
+            std::min(limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSampledImages),
+            std::min(limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSamplers),
+            std::min(limits.maxDescriptorSetUpdateAfterBindStorageImages, limits.maxPerStageDescriptorUpdateAfterBindStorageImages),
+            std::min(limits.maxDescriptorSetUpdateAfterBindStorageBuffers, limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers),
+        };
+
+        std::array<uint32_t, BINDLESS_TYPE_COUNT> counts{};
+        uint64_t                                  total = 0;
+        for (size_t type = 0; type < BINDLESS_TYPE_COUNT; type++) {
+            counts[type] = std::max(1u, std::min(settings.capacity[type], max_counts[type]));
+            total += counts[type];
+        }
+
+        // Every binding is visible to every stage, so together they also have to fit in a single stage's budget.
+        if (total > limits.maxPerStageUpdateAfterBindResources) {
+            for (auto &count : counts) {
+                count = std::max<uint32_t>(1, static_cast<uint32_t>(static_cast<uint64_t>(count) * limits.maxPerStageUpdateAfterBindResources / total));
+            }
+        }
+
+        for (size_t type = 0; type < BINDLESS_TYPE_COUNT; type++) {
+            if (counts[type] < settings.capacity[type]) {
+                spdlog::warn("Only {} bindless {} descriptors fit on this device ({} were asked for).", counts[type], TYPE_NAMES[type], settings.capacity[type]);
+            }
+            m_Indices[type] = std::make_shared<IndexAllocator>(counts[type]);
+        }
+
+        std::array<vk::DescriptorSetLayoutBinding, BINDLESS_TYPE_COUNT> bindings;
+        std::array<vk::DescriptorBindingFlags, BINDLESS_TYPE_COUNT>     binding_flags;
+        std::array<vk::DescriptorPoolSize, BINDLESS_TYPE_COUNT>         pool_sizes;
+        for (uint32_t type = 0; type < BINDLESS_TYPE_COUNT; type++) {
+            bindings[type]      = vk::DescriptorSetLayoutBinding(type, DESCRIPTOR_TYPES[type], counts[type], vk::ShaderStageFlagBits::eAll);
+            binding_flags[type] = vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind |
+                                  vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
+            pool_sizes[type] = vk::DescriptorPoolSize(DESCRIPTOR_TYPES[type], counts[type]);
+        }
+
+        const vk::DescriptorSetLayoutBindingFlagsCreateInfo flags_info(binding_flags);
+        m_Layout = vk::raii::DescriptorSetLayout(
+            ctx->device(), vk::DescriptorSetLayoutCreateInfo(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool, bindings, &flags_info)
+        );
+
+        m_Pool = vk::raii::DescriptorPool(ctx->device(), vk::DescriptorPoolCreateInfo(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind, 1, pool_sizes));
+        const vk::DescriptorSetLayout layout = *m_Layout;
+        m_Set                                = (*ctx->device()).allocateDescriptorSets(vk::DescriptorSetAllocateInfo(*m_Pool, layout)).front();
+
+        m_Released.allocators = m_Indices;
+    }
+
+    uint32_t BindlessHeap::allocate(const BindlessType type) {
+        const uint32_t index = m_Indices[static_cast<size_t>(type)]->allocate();
+        if (index == INVALID_INDEX) {
+            throw crash(
+                CrashReason::CriticalFailure,
+                std::format("Ran out of bindless {} descriptors (all {} are in use).", TYPE_NAMES[static_cast<size_t>(type)], capacity(type))
+            );
+        }
+        return index;
+    }
+
+    void BindlessHeap::write(const BindlessType type, const uint32_t index, const vk::DescriptorImageInfo *image, const vk::DescriptorBufferInfo *buffer) {
+        const auto binding = static_cast<uint32_t>(type);
+
+        std::lock_guard lock(m_WriteMutex);
+        m_Context->device().updateDescriptorSets(vk::WriteDescriptorSet(m_Set, binding, index, 1, DESCRIPTOR_TYPES[binding], image, buffer), nullptr);
+    }
+
+    uint32_t BindlessHeap::add_sampled_image(const vk::ImageView view, const vk::ImageLayout layout) {
+        const uint32_t                index = allocate(BindlessType::SampledImage);
+        const vk::DescriptorImageInfo info(nullptr, view, layout);
+        write(BindlessType::SampledImage, index, &info, nullptr);
+        return index;
+    }
+
+    uint32_t BindlessHeap::add_sampler(const vk::Sampler sampler) {
+        const uint32_t                index = allocate(BindlessType::Sampler);
+        const vk::DescriptorImageInfo info(sampler, nullptr, vk::ImageLayout::eUndefined);
+        write(BindlessType::Sampler, index, &info, nullptr);
+        return index;
+    }
+
+    uint32_t BindlessHeap::add_storage_image(const vk::ImageView view, const vk::ImageLayout layout) {
+        const uint32_t                index = allocate(BindlessType::StorageImage);
+        const vk::DescriptorImageInfo info(nullptr, view, layout);
+        write(BindlessType::StorageImage, index, &info, nullptr);
+        return index;
+    }
+
+    uint32_t BindlessHeap::add_storage_buffer(const vk::Buffer buffer, const vk::DeviceSize offset, const vk::DeviceSize range) {
+        const uint32_t                 index = allocate(BindlessType::StorageBuffer);
+        const vk::DescriptorBufferInfo info(buffer, offset, range);
+        write(BindlessType::StorageBuffer, index, nullptr, &info);
+        return index;
+    }
+
+    void BindlessHeap::release(const BindlessType type, const uint32_t index) {
+        if (index == INVALID_INDEX) {
+            return;
+        }
+
+        std::lock_guard lock(m_ReleaseMutex);
+        m_Released.indices[static_cast<size_t>(type)].push_back(index);
+    }
+
+    void BindlessHeap::end_frame() {
+        PendingRelease released;
+        {
+            std::lock_guard lock(m_ReleaseMutex);
+            if (std::ranges::all_of(m_Released.indices, [](const auto &indices) { return indices.empty(); })) {
+                return;
+            }
+
+            released              = std::move(m_Released);
+            m_Released            = PendingRelease();
+            m_Released.allocators = m_Indices;
+        }
+
+        // Called after the frame is submitted, so waiting for everything submitted so far covers every frame which could have used the indices.
+        m_Context->retire(std::move(released));
+    }
+
+    void BindlessHeap::bind(const vk::raii::CommandBuffer &cmd, const vk::PipelineBindPoint bind_point, const vk::PipelineLayout pipeline_layout, const uint32_t set_index) const {
+        cmd.bindDescriptorSets(bind_point, pipeline_layout, set_index, m_Set, nullptr);
+    }
+} // namespace engine
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "engine/renderer/vulkan_context.hpp"
+
+namespace engine {
+    /**
+     * Hands out indices in `[0, capacity)`, reusing released ones (most recently released first, so the part of the table in use stays small). Thread safe.
+     */
+    class IndexAllocator {
+      public:
+        static constexpr uint32_t INVALID = UINT32_MAX;
+
+        explicit IndexAllocator(uint32_t capacity);
+
+        /**
+         * @return `INVALID` if every index is in use.
+         */
+        [[nodiscard]] uint32_t allocate();
+
+        void release(uint32_t index);
+
+        [[nodiscard]] inline uint32_t capacity() const { return m_Capacity; }
+
+        [[nodiscard]] uint32_t used() const;
+
+      private:
+        mutable std::mutex    m_Mutex;
+        uint32_t              m_Capacity;
+        uint32_t              m_Next = 0;
+        std::vector<uint32_t> m_Free;
+    };
+
+    /**
+     * The kinds of descriptor in the bindless table. Each is its own binding (numbered like this enum) holding an array the shaders index into.
+     */
+    enum class BindlessType {
+        SampledImage,
+        Sampler,
+        StorageImage,
+        StorageBuffer,
+    };
+
+    inline constexpr size_t BINDLESS_TYPE_COUNT = 4;
+
+    struct BindlessHeapSettings {
+        /**
+         * How many descriptors of each type (indexed by `BindlessType`). These are clamped to the device's limits.
+         */
+        std::array<uint32_t, BINDLESS_TYPE_COUNT> capacity = {65536, 256, 4096, 65536};
+    };
+
+    /**
+     * One global descriptor set holding every texture, sampler and storage buffer, so draws pick resources with an index (usually in a push constant) instead of binding
+     * descriptor sets of their own. The set is bound once per command buffer.
+     *
+     * In GLSL (with `GL_EXT_nonuniform_qualifier`) the set looks like:
+     *
+     *     layout(set = 0, binding = 0) uniform texture2D textures[];
+     *     layout(set = 0, binding = 1) uniform sampler samplers[];
+     *     layout(set = 0, binding = 2, rgba8) uniform image2D images[];
+     *     layout(set = 0, binding = 3) buffer Buffers { uint data[]; } buffers[];
+     *
+     * Every binding is partially bound and update-after-bind, so adding a descriptor never waits for frames in flight. Released indices are only reused once the frames
+     * which could have used them have finished on the primary queue (resources used on other queues have to outlive that work themselves).
+     *
+     * Needs `DeviceCapabilities::bindless`.
+     */
+    class BindlessHeap {
+      public:
+        static constexpr uint32_t INVALID_INDEX = IndexAllocator::INVALID;
+
+        explicit BindlessHeap(const std::shared_ptr<VulkanContext> &ctx, const BindlessHeapSettings &settings = {});
+
+        BindlessHeap(const BindlessHeap &other)                = delete;
+        BindlessHeap(BindlessHeap &&other) noexcept            = delete;
+        BindlessHeap &operator=(const BindlessHeap &other)     = delete;
+        BindlessHeap &operator=(BindlessHeap &&other) noexcept = delete;
+
+        /**
+         * @throws crash If the table for that type is full (as do the other `add_` functions).
+         */
+        [[nodiscard]] uint32_t add_sampled_image(vk::ImageView view, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+
+        [[nodiscard]] uint32_t add_sampler(vk::Sampler sampler);
+
+        [[nodiscard]] uint32_t add_storage_image(vk::ImageView view, vk::ImageLayout layout = vk::ImageLayout::eGeneral);
+
+        [[nodiscard]] uint32_t add_storage_buffer(vk::Buffer buffer, vk::DeviceSize offset = 0, vk::DeviceSize range = vk::WholeSize);
+
+        /**
+         * Give `index` back. It's reused once the frame being recorded (and everything submitted before it) has finished.
+         */
+        void release(BindlessType type, uint32_t index);
+
+        /**
+         * Hand everything released so far to the deletion queue, to be reused once the primary queue finishes what has been submitted to it. `Application` calls this after
+         * submitting every frame.
+         */
+        void end_frame();
+
+        [[nodiscard]] inline const vk::raii::DescriptorSetLayout &layout() const { return m_Layout; }
+
+        [[nodiscard]] inline vk::DescriptorSet set() const { return m_Set; }
+
+        /**
+         * Bind the table as set `set_index` of `pipeline_layout` (which has to have been made with `layout()` in that slot).
+         */
+        void bind(const vk::raii::CommandBuffer &cmd, vk::PipelineBindPoint bind_point, vk::PipelineLayout pipeline_layout, uint32_t set_index = 0) const;
+
+        [[nodiscard]] inline uint32_t capacity(const BindlessType type) const { return m_Indices[static_cast<size_t>(type)]->capacity(); }
+
+        [[nodiscard]] inline uint32_t used(const BindlessType type) const { return m_Indices[static_cast<size_t>(type)]->used(); }
+
+      private:
+        /**
+         * Retired to the deletion queue, releases its indices when destroyed.
+         */
+        struct PendingRelease {
+            std::array<std::shared_ptr<IndexAllocator>, BINDLESS_TYPE_COUNT> allocators;
+            std::array<std::vector<uint32_t>, BINDLESS_TYPE_COUNT>             indices;
+
+            PendingRelease()                                       = default;
+            PendingRelease(PendingRelease &&other) noexcept        = default;
+            PendingRelease &operator=(PendingRelease &&other)      = default;
+            ~PendingRelease();
+        };
+
+        [[nodiscard]] uint32_t allocate(BindlessType type);
+
+        void write(BindlessType type, uint32_t index, const vk::DescriptorImageInfo *image, const vk::DescriptorBufferInfo *buffer);
+
+        std::shared_ptr<VulkanContext> m_Context;
+
+        vk::raii::DescriptorSetLayout m_Layout = nullptr;
+        vk::raii::DescriptorPool      m_Pool   = nullptr;
+
+        // Freed along with the pool.
+        vk::DescriptorSet m_Set;
+
+        // Shared with pending releases, which may outlive the heap in the deletion queue.
+        std::array<std::shared_ptr<IndexAllocator>, BINDLESS_TYPE_COUNT> m_Indices;
+
+        // Descriptor set updates have to be externally synchronized.
+        std::mutex m_WriteMutex;
+
+        std::mutex     m_ReleaseMutex;
+        PendingRelease m_Released;
+    };
+} // namespace engine
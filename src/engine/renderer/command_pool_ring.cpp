@@ -0,0 +1,51 @@
+#include "command_pool_ring.hpp"
+
+#include <algorithm>
+
+namespace engine {
+    CommandPoolRing::CommandPoolRing(const std::shared_ptr<VulkanContext> &ctx, const uint32_t queue_family, const size_t frames_in_flight, const uint32_t worker_count)
+        : m_Context(ctx), m_WorkerCount(worker_count) {
+        m_Pools.resize(frames_in_flight * worker_count);
+        for (auto &pool : m_Pools) {
+            pool.pool = vk::raii::CommandPool(m_Context->device(), vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eTransient, queue_family));
+        }
+    }
+
+    void CommandPoolRing::begin_frame(const uint32_t frame_index) {
+        for (uint32_t worker = 0; worker < m_WorkerCount; worker++) {
+            auto &pool = m_Pools[frame_index * m_WorkerCount + worker];
+            if (pool.used_primaries == 0 && pool.used_secondaries == 0) {
+                continue;
+            }
+
+            pool.pool.reset();
+            pool.used_primaries   = 0;
+            pool.used_secondaries = 0;
+        }
+    }
+
+    const vk::raii::CommandBuffer &CommandPoolRing::primary(const uint32_t frame_index, const uint32_t worker) {
+        return next(frame_index, worker, vk::CommandBufferLevel::ePrimary);
+    }
+
+    const vk::raii::CommandBuffer &CommandPoolRing::secondary(const uint32_t frame_index, const uint32_t worker) {
+        return next(frame_index, worker, vk::CommandBufferLevel::eSecondary);
+    }
+
+    const vk::raii::CommandBuffer &CommandPoolRing::next(const uint32_t frame_index, const uint32_t worker, const vk::CommandBufferLevel level) {
+        auto &pool    = m_Pools[frame_index * m_WorkerCount + worker];
+        auto &buffers = level == vk::CommandBufferLevel::ePrimary ? pool.primaries : pool.secondaries;
+        auto &used    = level == vk::CommandBufferLevel::ePrimary ? pool.used_primaries : pool.used_secondaries;
+
+        if (used == buffers.size()) {
+            // Grow geometrically so a frame which suddenly needs a lot of command buffers doesn't allocate one at a time.
+            const auto count     = static_cast<uint32_t>(std::max<size_t>(buffers.size(), 4));
+            auto       allocated = vk::raii::CommandBuffers(m_Context->device(), vk::CommandBufferAllocateInfo(*pool.pool, level, count));
+            for (auto &buffer : allocated) {
+                buffers.push_back(std::move(buffer));
+            }
+        }
+
+        return buffers[used++];
+    }
+} // namespace engine
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "engine/renderer/vulkan_context.hpp"
+
+namespace engine {
+    /**
+     * Command pools for every (frame in flight, worker) pair. Command pools can't be used from more than one thread at a time, so each recording thread gets its own pool per
+     * frame, and since the GPU may still be executing a frame's command buffers, each frame in flight gets its own set of pools.
+     *
+     * Pools are reset as a whole at the start of their frame (which is much cheaper than resetting command buffers one by one) and command buffers are handed out again in the
+     * order they were first allocated, so after the first few frames nothing is allocated anymore.
+     *
+     * Worker 0 is the thread driving the frame (the one that records the primary command buffer).
+     */
+    class CommandPoolRing {
+      public:
+        CommandPoolRing(const std::shared_ptr<VulkanContext> &ctx, uint32_t queue_family, size_t frames_in_flight, uint32_t worker_count);
+
+        CommandPoolRing(const CommandPoolRing &other)                = delete;
+        CommandPoolRing(CommandPoolRing &&other) noexcept            = default;
+        CommandPoolRing &operator=(const CommandPoolRing &other)     = delete;
+        CommandPoolRing &operator=(CommandPoolRing &&other) noexcept = default;
+
+        /**
+         * Reset every pool belonging to `frame_index`. The previous submission of that frame must have finished executing.
+         */
+        void begin_frame(uint32_t frame_index);
+
+        /**
+         * Get an unused primary command buffer from `worker`'s pool for `frame_index`. Any thread may call this, but calls for the same (frame, worker) pool must
+         * not run concurrently, and neither may recording into that pool's command buffers.
+         */
+        [[nodiscard]] const vk::raii::CommandBuffer &primary(uint32_t frame_index, uint32_t worker = 0);
+
+        /**
+         * Get an unused secondary command buffer from `worker`'s pool for `frame_index`. Any thread may call this, but calls for the same (frame, worker) pool must
+         * not run concurrently, and neither may recording into that pool's command buffers.
+         */
+        [[nodiscard]] const vk::raii::CommandBuffer &secondary(uint32_t frame_index, uint32_t worker);
+
+        [[nodiscard]] inline uint32_t worker_count() const { return m_WorkerCount; }
+
+        [[nodiscard]] inline uint32_t frames_in_flight() const { return static_cast<uint32_t>(m_Pools.size() / m_WorkerCount); }
+
+      private:
+        struct Pool {
+            vk::raii::CommandPool pool = nullptr;
+
+            // Deques so handed out references stay valid when more command buffers are allocated.
+            std::deque<vk::raii::CommandBuffer> primaries;
+            std::deque<vk::raii::CommandBuffer> secondaries;
+            size_t                              used_primaries   = 0;
+            size_t                              used_secondaries = 0;
+        };
+
+        [[nodiscard]] const vk::raii::CommandBuffer &next(uint32_t frame_index, uint32_t worker, vk::CommandBufferLevel level);
+
+        std::shared_ptr<VulkanContext> m_Context;
+        uint32_t                       m_WorkerCount;
+
+        // Indexed by frame_index * m_WorkerCount + worker.
+        std::vector<Pool> m_Pools;
+    };
+} // namespace engine
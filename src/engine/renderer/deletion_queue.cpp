@@ -0,0 +1,63 @@
+#include "deletion_queue.hpp"
+
+#include <algorithm>
+
+namespace engine {
+    DeletionQueue::~DeletionQueue() {
+        flush();
+    }
+
+    void DeletionQueue::push(Entry entry, const uint32_t frames) {
+        std::lock_guard lock(m_Mutex);
+        entry.frame = m_Frame + frames;
+        m_Entries.push_back(std::move(entry));
+    }
+
+    void DeletionQueue::collect() {
+        std::vector<Entry> done;
+        {
+            std::lock_guard    lock(m_Mutex);
+            std::vector<Entry> kept;
+            for (auto &entry : m_Entries) {
+                (entry.frame <= m_Frame && entry.timeline->reached(entry.value) ? done : kept).push_back(std::move(entry));
+            }
+            m_Entries = std::move(kept);
+        }
+
+        // Destroyed outside the lock, so destructors are free to retire other objects.
+        done.clear();
+    }
+
+    void DeletionQueue::end_frame() {
+        {
+            std::lock_guard lock(m_Mutex);
+            m_Frame++;
+        }
+        collect();
+    }
+
+    void DeletionQueue::flush() {
+        // Destroying entries can retire more objects (a pipeline handle retiring its pipeline, for example), so keep going until nothing new shows up.
+        while (true) {
+            std::vector<Entry> entries;
+            {
+                std::lock_guard lock(m_Mutex);
+                if (m_Entries.empty()) {
+                    return;
+                }
+                entries = std::move(m_Entries);
+                m_Entries.clear();
+            }
+
+            for (const auto &entry : entries) {
+                entry.timeline->wait(std::min(entry.value, entry.timeline->submitted()));
+            }
+            entries.clear();
+        }
+    }
+
+    size_t DeletionQueue::pending() const {
+        std::lock_guard lock(m_Mutex);
+        return m_Entries.size();
+    }
+} // namespace engine
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "engine/renderer/timeline.hpp"
+
+namespace engine {
+    /**
+     * Keeps objects (`vk::raii` handles, allocations, or anything else) alive until the GPU is done with them, so they can be let go of from any thread without waiting for
+     * the device. An object is destroyed once its timeline reaches the value it was retired with and at least as many frames as it asked for have ended since.
+     *
+     * The frame count is for things the timeline can't see, like presentation (a swapchain has to outlive a full set of frames in flight after its last use).
+     *
+     * `VulkanContext` owns the one everything should use (see `VulkanContext::retire`). `Application` ends a frame on it after every frame it submits.
+     */
+    class DeletionQueue {
+      public:
+        DeletionQueue() = default;
+
+        /**
+         * Waits for every timeline value anything is still waiting on, then destroys everything.
+         */
+        ~DeletionQueue();
+
+        DeletionQueue(const DeletionQueue &other)                = delete;
+        DeletionQueue(DeletionQueue &&other) noexcept            = delete;
+        DeletionQueue &operator=(const DeletionQueue &other)     = delete;
+        DeletionQueue &operator=(DeletionQueue &&other) noexcept = delete;
+
+        /**
+         * Destroy `object` once `timeline` reaches `value` and `frames` more frames have ended.
+         */
+        template <typename T>
+        void retire(T &&object, const Timeline &timeline, const uint64_t value, const uint32_t frames = 0) {
+            using Object = std::remove_cvref_t<T>;
+            push(Entry{
+                .object   = Handle(new Object(std::forward<T>(object)), [](void *pointer) { delete static_cast<Object *>(pointer); }),
+                .timeline = &timeline,
+                .value    = value,
+                .frame    = 0,
+            }, frames);
+        }
+
+        /**
+         * Destroy everything which is done with.
+         */
+        void collect();
+
+        /**
+         * Count a frame as ended (then `collect`).
+         */
+        void end_frame();
+
+        /**
+         * Wait for every timeline value and destroy everything, ignoring frame counts. Only call this once presentation can't be using anything anymore (for example after
+         * waiting for the device to go idle). Values which were never submitted aren't waited for, since nothing on the GPU can be using objects retired with them.
+         * Objects retired by destructors while flushing are flushed too.
+         */
+        void flush();
+
+        /**
+         * How many objects are still waiting to be destroyed.
+         */
+        [[nodiscard]] size_t pending() const;
+
+      private:
+        using Handle = std::unique_ptr<void, void (*)(void *)>;
+
+        struct Entry {
+            Handle          object;
+            const Timeline *timeline;
+            uint64_t        value;
+
+            // The value of `m_Frame` which has to be reached.
+            uint64_t frame;
+        };
+
+        void push(Entry entry, uint32_t frames);
+
+        mutable std::mutex m_Mutex;
+        std::vector<Entry> m_Entries;
+        uint64_t           m_Frame = 0;
+    };
+} // namespace engine
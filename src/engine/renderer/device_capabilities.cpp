@@ -0,0 +1,216 @@
+#include "device_capabilities.hpp"
+
+#include <algorithm>
+
+namespace engine {
+    namespace {
+        /**
+         * Appends structs to a pNext chain.
+         */
+        class ChainBuilder {
+          public:
+            explicit ChainBuilder(void **head) : m_Next(head) {}
+
+            template <typename T>
+            void append(T &structure) {
+                *m_Next = &structure;
+                m_Next  = &structure.pNext;
+            }
+
+          private:
+            void **m_Next;
+        };
+    } // namespace
+
+    std::vector<std::string> DeviceCapabilities::missing_requirements(const bool presentation) const {
+        std::vector<std::string> missing;
+
+        // The 1.2 and 1.3 feature structs are what everything below gets queried through.
+        if (api_version < vk::ApiVersion13) {
+            missing.emplace_back("Vulkan 1.3");
+        }
+
+        if (!timeline_semaphore) {
+            missing.emplace_back("timelineSemaphore");
+        }
+
+        if (!synchronization2) {
+            missing.emplace_back("synchronization2");
+        }
+
+        if (!dynamic_rendering) {
+            missing.emplace_back("dynamicRendering");
+        }
+
+        if (presentation && !swapchain) {
+            missing.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        }
+
+        return missing;
+    }
+
+    DeviceCapabilities query_device_capabilities(const vk::raii::PhysicalDevice &device, const bool presentation) {
+        DeviceCapabilities capabilities;
+        capabilities.api_version = std::min(device.getProperties().apiVersion, vk::ApiVersion14);
+
+        const auto extensions    = device.enumerateDeviceExtensionProperties();
+        const auto has_extension = [&](const std::string_view name) {
+            return std::ranges::any_of(extensions, [&](const vk::ExtensionProperties &props) { return name == props.extensionName.data(); });
+        };
+
+        capabilities.swapchain     = presentation && has_extension(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        capabilities.memory_budget = has_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+        const bool present_wait_extensions     = capabilities.swapchain && has_extension(VK_KHR_PRESENT_ID_EXTENSION_NAME) && has_extension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        const bool mesh_shader_extension       = has_extension(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+        const bool descriptor_buffer_extension = has_extension(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME);
+        const bool pipeline_library_extensions = has_extension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) && has_extension(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+
+        vk::PhysicalDeviceFeatures2                          features{};
+        vk::PhysicalDeviceVulkan11Features                   v11{};
+        vk::PhysicalDeviceVulkan12Features                   v12{};
+        vk::PhysicalDeviceVulkan13Features                   v13{};
+        vk::PhysicalDeviceVulkan14Features                   v14{};
+        vk::PhysicalDevicePresentIdFeaturesKHR               present_id{};
+        vk::PhysicalDevicePresentWaitFeaturesKHR             present_wait{};
+        vk::PhysicalDeviceMeshShaderFeaturesEXT              mesh_shader{};
+        vk::PhysicalDeviceDescriptorBufferFeaturesEXT        descriptor_buffer{};
+        vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphics_pipeline_library{};
+
+        // Drivers are allowed to choke on structs they don't know about, so only the ones the device can understand go in the chain.
+        ChainBuilder chain(&features.pNext);
+        if (capabilities.api_version >= vk::ApiVersion12) {
+            chain.append(v11);
+            chain.append(v12);
+        }
+        if (capabilities.api_version >= vk::ApiVersion13) {
+            chain.append(v13);
+        }
+        if (capabilities.api_version >= vk::ApiVersion14) {
+            chain.append(v14);
+        }
+        if (present_wait_extensions) {
+            chain.append(present_id);
+            chain.append(present_wait);
+        }
+        if (mesh_shader_extension) {
+            chain.append(mesh_shader);
+        }
+        if (descriptor_buffer_extension) {
+            chain.append(descriptor_buffer);
+        }
+        if (pipeline_library_extensions) {
+            chain.append(graphics_pipeline_library);
+        }
+
+        (*device).getFeatures2(&features);
+
+        const auto &f = features.features;
+
+        capabilities.timeline_semaphore = v12.timelineSemaphore;
+        capabilities.synchronization2   = v13.synchronization2;
+        capabilities.dynamic_rendering  = v13.dynamicRendering;
+
+        capabilities.geometry_shader              = f.geometryShader;
+        capabilities.tessellation_shader          = f.tessellationShader;
+        capabilities.multi_draw_indirect          = f.multiDrawIndirect;
+        capabilities.draw_indirect_first_instance = f.drawIndirectFirstInstance;
+        capabilities.fill_mode_non_solid          = f.fillModeNonSolid;
+        capabilities.large_points                 = f.largePoints;
+        capabilities.wide_lines                   = f.wideLines;
+        capabilities.draw_indirect_count          = v12.drawIndirectCount;
+        capabilities.buffer_device_address        = v12.bufferDeviceAddress;
+
+        capabilities.bindless = v12.runtimeDescriptorArray && v12.descriptorBindingPartiallyBound && v12.descriptorBindingUpdateUnusedWhilePending &&
+                                v12.descriptorBindingSampledImageUpdateAfterBind && v12.shaderSampledImageArrayNonUniformIndexing &&
+                                v12.descriptorBindingStorageImageUpdateAfterBind && v12.shaderStorageImageArrayNonUniformIndexing &&
+                                v12.descriptorBindingStorageBufferUpdateAfterBind && v12.shaderStorageBufferArrayNonUniformIndexing;
+
+        capabilities.push_descriptor = capabilities.api_version >= vk::ApiVersion14 ? static_cast<bool>(v14.pushDescriptor) : has_extension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+
+        capabilities.present_wait              = present_wait_extensions && present_id.presentId && present_wait.presentWait;
+        capabilities.mesh_shader               = mesh_shader_extension && mesh_shader.meshShader && mesh_shader.taskShader;
+        capabilities.descriptor_buffer         = descriptor_buffer_extension && descriptor_buffer.descriptorBuffer && capabilities.buffer_device_address;
+        capabilities.graphics_pipeline_library = pipeline_library_extensions && graphics_pipeline_library.graphicsPipelineLibrary;
+
+        return capabilities;
+    }
+
+    DeviceFeatureChain::DeviceFeatureChain(const DeviceCapabilities &capabilities, const bool presentation) {
+        ChainBuilder chain(&m_Features.pNext);
+        chain.append(m_Vulkan11);
+        chain.append(m_Vulkan12);
+        chain.append(m_Vulkan13);
+
+        m_Features.features.geometryShader            = capabilities.geometry_shader;
+        m_Features.features.tessellationShader        = capabilities.tessellation_shader;
+        m_Features.features.multiDrawIndirect         = capabilities.multi_draw_indirect;
+        m_Features.features.drawIndirectFirstInstance = capabilities.draw_indirect_first_instance;
+        m_Features.features.fillModeNonSolid          = capabilities.fill_mode_non_solid;
+        m_Features.features.largePoints               = capabilities.large_points;
+        m_Features.features.wideLines                 = capabilities.wide_lines;
+
+        m_Vulkan12.timelineSemaphore   = capabilities.timeline_semaphore;
+        m_Vulkan12.drawIndirectCount   = capabilities.draw_indirect_count;
+        m_Vulkan12.bufferDeviceAddress = capabilities.buffer_device_address;
+
+        if (capabilities.bindless) {
+            m_Vulkan12.runtimeDescriptorArray                        = true;
+            m_Vulkan12.descriptorBindingPartiallyBound               = true;
+            m_Vulkan12.descriptorBindingUpdateUnusedWhilePending     = true;
+            m_Vulkan12.descriptorBindingSampledImageUpdateAfterBind  = true;
+            m_Vulkan12.shaderSampledImageArrayNonUniformIndexing     = true;
+            m_Vulkan12.descriptorBindingStorageImageUpdateAfterBind  = true;
+            m_Vulkan12.shaderStorageImageArrayNonUniformIndexing     = true;
+            m_Vulkan12.descriptorBindingStorageBufferUpdateAfterBind = true;
+            m_Vulkan12.shaderStorageBufferArrayNonUniformIndexing    = true;
+        }
+
+        m_Vulkan13.synchronization2 = capabilities.synchronization2;
+        m_Vulkan13.dynamicRendering = capabilities.dynamic_rendering;
+
+        if (capabilities.api_version >= vk::ApiVersion14) {
+            chain.append(m_Vulkan14);
+            m_Vulkan14.pushDescriptor = capabilities.push_descriptor;
+        } else if (capabilities.push_descriptor) {
+            m_Extensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+        }
+
+        if (presentation) {
+            m_Extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        }
+
+        if (capabilities.present_wait) {
+            m_Extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            m_Extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+            m_PresentId.presentId     = true;
+            m_PresentWait.presentWait = true;
+            chain.append(m_PresentId);
+            chain.append(m_PresentWait);
+        }
+
+        if (capabilities.mesh_shader) {
+            m_Extensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+            m_MeshShader.meshShader = true;
+            m_MeshShader.taskShader = true;
+            chain.append(m_MeshShader);
+        }
+
+        if (capabilities.descriptor_buffer) {
+            m_Extensions.push_back(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME);
+            m_DescriptorBuffer.descriptorBuffer = true;
+            chain.append(m_DescriptorBuffer);
+        }
+
+        if (capabilities.graphics_pipeline_library) {
+            m_Extensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+            m_Extensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+            m_GraphicsPipelineLibrary.graphicsPipelineLibrary = true;
+            chain.append(m_GraphicsPipelineLibrary);
+        }
+
+        if (capabilities.memory_budget) {
+            m_Extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
+    }
+} // namespace engine
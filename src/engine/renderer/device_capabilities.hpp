@@ -0,0 +1,111 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace engine {
+    /**
+     * What a physical device can do, as far as the engine cares. Only timeline semaphores, synchronization2 and dynamic rendering (plus a swapchain when presenting) are
+     * required. Everything else is enabled when it's there, and renderer code checks these flags to pick a fast path or a fallback.
+     */
+    struct DeviceCapabilities {
+        /**
+         * The device's API version. Anything above 1.4 is treated as 1.4, since that's what the instance asks for.
+         */
+        uint32_t api_version = 0;
+
+        // Required.
+        bool timeline_semaphore = false;
+        bool synchronization2   = false;
+        bool dynamic_rendering  = false;
+        bool swapchain          = false;
+
+        // Optional core features.
+        bool geometry_shader              = false;
+        bool tessellation_shader          = false;
+        bool multi_draw_indirect          = false;
+        bool draw_indirect_first_instance = false;
+        bool fill_mode_non_solid          = false;
+        bool large_points                 = false;
+        bool wide_lines                   = false;
+        bool draw_indirect_count          = false;
+        bool buffer_device_address        = false;
+
+        /**
+         * Runtime sized, partially bound, update-after-bind arrays of sampled images, storage images and storage buffers which can be indexed non-uniformly, and which can be
+         * updated while frames using other parts of them are still running (see `BindlessHeap`).
+         */
+        bool bindless = false;
+
+        /**
+         * Core in 1.4, `VK_KHR_push_descriptor` before that.
+         */
+        bool push_descriptor = false;
+
+        // Optional extensions.
+        bool mesh_shader = false;
+
+        /**
+         * Also needs `buffer_device_address`, descriptor buffers are addressed by device address.
+         */
+        bool descriptor_buffer         = false;
+        bool graphics_pipeline_library = false;
+        bool memory_budget             = false;
+
+        /**
+         * `VK_KHR_present_id` + `VK_KHR_present_wait`.
+         */
+        bool present_wait = false;
+
+        /**
+         * Everything required which the device doesn't have (empty if it can be used).
+         *
+         * @param presentation Whether the device has to be able to present (false when headless).
+         */
+        [[nodiscard]] std::vector<std::string> missing_requirements(bool presentation) const;
+    };
+
+    /**
+     * Find out what `device` supports. Only feature structs belonging to the device's API version or to extensions it has are queried.
+     *
+     * @param presentation Whether presentation related extensions matter (false when headless).
+     */
+    [[nodiscard]] DeviceCapabilities query_device_capabilities(const vk::raii::PhysicalDevice &device, bool presentation);
+
+    /**
+     * The feature structs and extensions to create a device with, enabling everything in a `DeviceCapabilities`. The structs are chained together through pointers into this
+     * object, so it can't be moved.
+     */
+    class DeviceFeatureChain {
+      public:
+        DeviceFeatureChain(const DeviceCapabilities &capabilities, bool presentation);
+
+        DeviceFeatureChain(const DeviceFeatureChain &other)                = delete;
+        DeviceFeatureChain(DeviceFeatureChain &&other) noexcept            = delete;
+        DeviceFeatureChain &operator=(const DeviceFeatureChain &other)     = delete;
+        DeviceFeatureChain &operator=(DeviceFeatureChain &&other) noexcept = delete;
+
+        /**
+         * The head of the chain (for `vk::DeviceCreateInfo::pNext`).
+         */
+        [[nodiscard]] inline const vk::PhysicalDeviceFeatures2 &features() const { return m_Features; }
+
+        [[nodiscard]] inline const std::vector<const char *> &extensions() const { return m_Extensions; }
+
+      private:
+        vk::PhysicalDeviceFeatures2                          m_Features{};
+        vk::PhysicalDeviceVulkan11Features                   m_Vulkan11{};
+        vk::PhysicalDeviceVulkan12Features                   m_Vulkan12{};
+        vk::PhysicalDeviceVulkan13Features                   m_Vulkan13{};
+        vk::PhysicalDeviceVulkan14Features                   m_Vulkan14{};
+        vk::PhysicalDevicePresentIdFeaturesKHR               m_PresentId{};
+        vk::PhysicalDevicePresentWaitFeaturesKHR             m_PresentWait{};
+        vk::PhysicalDeviceMeshShaderFeaturesEXT              m_MeshShader{};
+        vk::PhysicalDeviceDescriptorBufferFeaturesEXT        m_DescriptorBuffer{};
+        vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT m_GraphicsPipelineLibrary{};
+
+        std::vector<const char *> m_Extensions;
+    };
+} // namespace engine
@@ -0,0 +1,211 @@
+#include "device_selector.hpp"
+
+#include "engine/tools.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <format>
+#include <fstream>
+
+#include <spdlog/spdlog.h>
+
+namespace engine {
+    static std::string uuid_to_string(const std::array<uint8_t, VK_UUID_SIZE> &uuid) {
+        std::string result;
+        result.reserve(VK_UUID_SIZE * 2);
+        for (const auto byte : uuid) {
+            result += std::format("{:02x}", byte);
+        }
+        return result;
+    }
+
+    static std::optional<std::array<uint8_t, VK_UUID_SIZE>> uuid_from_string(const std::string_view string) {
+        if (string.size() != VK_UUID_SIZE * 2) {
+            return std::nullopt;
+        }
+
+        std::array<uint8_t, VK_UUID_SIZE> uuid{};
+        for (size_t i = 0; i < VK_UUID_SIZE; i++) {
+            const auto byte = string.substr(i * 2, 2);
+            if (!std::ranges::all_of(byte, [](const char c) { return std::isxdigit(static_cast<unsigned char>(c)); })) {
+                return std::nullopt;
+            }
+            uuid[i] = static_cast<uint8_t>(std::stoul(std::string(byte), nullptr, 16));
+        }
+        return uuid;
+    }
+
+    static int64_t type_score(const vk::PhysicalDeviceType type) {
+        switch (type) {
+        case vk::PhysicalDeviceType::eDiscreteGpu:
+            return 100'000;
+        case vk::PhysicalDeviceType::eIntegratedGpu:
+            return 10'000;
+        case vk::PhysicalDeviceType::eVirtualGpu:
+            return 5'000;
+        case vk::PhysicalDeviceType::eCpu:
+            // Software rasterizers are still better than nothing (this is what headless CI machines run on).
+            return 1'000;
+        default:
+            return 0;
+        }
+    }
+
+    PhysicalDeviceInfo query_physical_device(const vk::raii::PhysicalDevice &device, const vk::raii::SurfaceKHR &surface) {
+        PhysicalDeviceInfo info;
+
+        const auto properties_chain = device.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>();
+        const auto &properties      = properties_chain.get<vk::PhysicalDeviceProperties2>().properties;
+
+        info.uuid           = properties_chain.get<vk::PhysicalDeviceIDProperties>().deviceUUID;
+        info.name           = properties.deviceName.data();
+        info.type           = properties.deviceType;
+        info.api_version    = properties.apiVersion;
+        info.driver_version = properties.driverVersion;
+
+        const auto memory_properties = device.getMemoryProperties();
+        for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++) {
+            if (memory_properties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal) {
+                info.device_local_memory = std::max(info.device_local_memory, memory_properties.memoryHeaps[i].size);
+            }
+        }
+
+        bool       has_graphics   = false;
+        const auto queue_families = device.getQueueFamilyProperties();
+        for (uint32_t index = 0; index < queue_families.size(); index++) {
+            const auto flags = queue_families[index].queueFlags;
+            has_graphics |= static_cast<bool>(flags & vk::QueueFlagBits::eGraphics);
+            info.exclusive_transfer |= !(flags & vk::QueueFlagBits::eGraphics) && !(flags & vk::QueueFlagBits::eCompute) && flags & vk::QueueFlagBits::eTransfer;
+            info.exclusive_compute |= !(flags & vk::QueueFlagBits::eGraphics) && flags & vk::QueueFlagBits::eCompute;
+
+            if (*surface && !info.can_present && device.getSurfaceSupportKHR(index, *surface)) {
+                info.can_present = true;
+            }
+        }
+
+        const bool presentation = static_cast<bool>(*surface);
+        info.capabilities       = query_device_capabilities(device, presentation);
+        info.missing            = info.capabilities.missing_requirements(presentation);
+
+        if (!has_graphics) {
+            info.missing.push_back("a graphics queue");
+        }
+
+        if (*surface && !info.can_present) {
+            info.missing.push_back("presentation to the window");
+        }
+
+        info.score = type_score(info.type);
+        info.score += static_cast<int64_t>(info.device_local_memory / (64ull * 1024 * 1024));
+        info.score += info.exclusive_transfer ? 500 : 0;
+        info.score += info.exclusive_compute ? 500 : 0;
+
+        // Optional fast paths only break ties between otherwise similar devices.
+        for (const bool fast_path : {info.capabilities.mesh_shader, info.capabilities.descriptor_buffer, info.capabilities.graphics_pipeline_library, info.capabilities.bindless}) {
+            info.score += fast_path ? 100 : 0;
+        }
+
+        return info;
+    }
+
+    static std::optional<DeviceSelection>
+    load_preferred_device(const vk::raii::PhysicalDevices &devices, const vk::raii::SurfaceKHR &surface, const std::filesystem::path &cache_file) {
+        std::ifstream file(cache_file);
+        if (!file) {
+            return std::nullopt;
+        }
+
+        std::optional<std::array<uint8_t, VK_UUID_SIZE>> uuid;
+        std::optional<uint32_t>                          driver_version;
+
+        std::string line;
+        while (std::getline(file, line)) {
+            const auto separator = line.find('=');
+            if (separator == std::string::npos) {
+                continue;
+            }
+
+            const auto key   = std::string_view(line).substr(0, separator);
+            const auto value = std::string_view(line).substr(separator + 1);
+            try {
+                if (key == "uuid") {
+                    uuid = uuid_from_string(value);
+                } else if (key == "driver_version") {
+                    driver_version = static_cast<uint32_t>(std::stoul(std::string(value)));
+                }
+            } catch (const std::exception &) {
+                return std::nullopt;
+            }
+        }
+
+        if (!uuid.has_value() || !driver_version.has_value()) {
+            return std::nullopt;
+        }
+
+        for (const auto &device : devices) {
+            const auto properties = device.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>();
+            if (!std::ranges::equal(properties.get<vk::PhysicalDeviceIDProperties>().deviceUUID, uuid.value())) {
+                continue;
+            }
+
+            // A driver update can change what the device supports, so the cached choice only counts for the driver it was made with.
+            if (properties.get<vk::PhysicalDeviceProperties2>().properties.driverVersion != driver_version.value()) {
+                return std::nullopt;
+            }
+
+            // Only the other devices are skipped. The cached one still has to meet every requirement and present to this window (which might be on another display
+            // or, after switching from headless, not have been checked at all).
+            auto info = query_physical_device(device, surface);
+            if (!info.usable()) {
+                spdlog::info("Ignoring the cached choice of {} (it no longer meets the requirements).", info.name);
+                return std::nullopt;
+            }
+
+            return DeviceSelection{.device = device, .info = std::move(info), .from_cache = true};
+        }
+
+        return std::nullopt;
+    }
+
+    static void store_preferred_device(const PhysicalDeviceInfo &info, const std::filesystem::path &cache_file) {
+        write_file_atomically(cache_file, "preferred device", [&](std::ostream &file) {
+            file << "uuid=" << uuid_to_string(info.uuid) << '\n';
+            file << "driver_version=" << info.driver_version << '\n';
+        });
+    }
+
+    DeviceSelection select_physical_device(const vk::raii::Instance &instance, const vk::raii::SurfaceKHR &surface, const std::filesystem::path &cache_file) {
+        const auto devices = vk::raii::PhysicalDevices(instance);
+
+        if (auto cached = load_preferred_device(devices, surface, cache_file)) {
+            return std::move(cached.value());
+        }
+
+        std::optional<DeviceSelection> best;
+        std::string                    rejected;
+        for (const auto &device : devices) {
+            auto info = query_physical_device(device, surface);
+            if (!info.usable()) {
+                std::string missing;
+                for (const auto &requirement : info.missing) {
+                    missing += missing.empty() ? requirement : ", " + requirement;
+                }
+                spdlog::info("Skipping {} (missing {}).", info.name, missing);
+                rejected += std::format("\n{}: missing {}", info.name, missing);
+                continue;
+            }
+
+            spdlog::info("Found {} ({}, score {}).", info.name, vk::to_string(info.type), info.score);
+            if (!best.has_value() || info.score > best->info.score) {
+                best = DeviceSelection{.device = device, .info = std::move(info), .from_cache = false};
+            }
+        }
+
+        if (!best.has_value()) {
+            throw crash(CrashReason::UnsupportedSystem, "No GPU supports everything the game needs." + rejected);
+        }
+
+        store_preferred_device(best->info, cache_file);
+        return std::move(best.value());
+    }
+} // namespace engine
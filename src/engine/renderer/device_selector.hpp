@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "engine/renderer/device_capabilities.hpp"
+
+namespace engine {
+    /**
+     * Everything device selection looks at for one physical device.
+     */
+    struct PhysicalDeviceInfo {
+        std::array<uint8_t, VK_UUID_SIZE> uuid{};
+        std::string                       name;
+        vk::PhysicalDeviceType            type = vk::PhysicalDeviceType::eOther;
+        uint32_t                          api_version    = 0;
+        uint32_t                          driver_version = 0;
+
+        /**
+         * Size of the biggest device local heap.
+         */
+        vk::DeviceSize device_local_memory = 0;
+
+        bool can_present       = false;
+        bool exclusive_transfer = false;
+        bool exclusive_compute  = false;
+
+        DeviceCapabilities capabilities;
+
+        /**
+         * Why the device can't be used (empty if it can).
+         */
+        std::vector<std::string> missing;
+
+        /**
+         * Higher is better. Only meaningful for usable devices.
+         */
+        int64_t score = 0;
+
+        [[nodiscard]] inline bool usable() const { return missing.empty(); }
+    };
+
+    struct DeviceSelection {
+        vk::raii::PhysicalDevice device = nullptr;
+        PhysicalDeviceInfo       info;
+
+        /**
+         * Whether this is the device remembered from the last launch. It's queried and checked like any other device either way.
+         */
+        bool from_cache = false;
+    };
+
+    /**
+     * Query (and score) everything device selection cares about.
+     *
+     * @param surface A surface the device has to be able to present to, or null when running headless.
+     */
+    [[nodiscard]] PhysicalDeviceInfo query_physical_device(const vk::raii::PhysicalDevice &device, const vk::raii::SurfaceKHR &surface);
+
+    /**
+     * Pick the best usable physical device.
+     *
+     * The chosen device's UUID and driver version are remembered in `cache_file` as a hint. If that device is still present with the same driver version on the next launch
+     * (and still usable with this surface) it's picked without querying and scoring every other device. Otherwise this falls back on a full selection.
+     *
+     * @throws crash If no device meets the engine's requirements.
+     */
+    [[nodiscard]] DeviceSelection select_physical_device(const vk::raii::Instance &instance, const vk::raii::SurfaceKHR &surface, const std::filesystem::path &cache_file);
+} // namespace engine
@@ -0,0 +1,96 @@
+#include "frame_pacer.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace engine {
+    // A minimized window may never present anything, so present waits can't be allowed to block forever.
+    static constexpr uint64_t PRESENT_WAIT_TIMEOUT = 100'000'000;
+
+    static std::chrono::nanoseconds smooth(const std::chrono::nanoseconds average, const std::chrono::nanoseconds sample) {
+        if (average == std::chrono::nanoseconds::zero()) {
+            return sample;
+        }
+
+        return average + (sample - average) / 8;
+    }
+
+    FramePacer::FramePacer(const bool present_wait_supported) : m_PresentWaitSupported(present_wait_supported), m_InputSampled(clock::now()) {}
+
+    void FramePacer::wait_for_input(const vk::raii::SwapchainKHR &swapchain, const Timeline &timeline, const bool vsync) {
+        const auto start = clock::now();
+
+        while (m_Queued.size() > m_Settings.max_queued_frames) {
+            const auto frame = m_Queued.front();
+            m_Queued.pop_front();
+
+            const auto displayed = wait_for(frame, swapchain, timeline);
+            if (!m_PresentWaitSupported) {
+                continue;
+            }
+
+            // Only waits which actually blocked say anything about when the frame was displayed.
+            if (displayed.has_value()) {
+                m_Stats.input_to_display = smooth(m_Stats.input_to_display, displayed.value() - frame.input_sampled);
+                if (vsync && m_LastDisplayed != clock::time_point{}) {
+                    m_Stats.refresh_interval = smooth(m_Stats.refresh_interval, displayed.value() - m_LastDisplayed);
+                }
+                m_LastDisplayed = displayed.value();
+            } else {
+                m_LastDisplayed = {};
+            }
+        }
+
+        if (m_Settings.just_in_time && m_PresentWaitSupported && vsync && m_LastDisplayed != clock::time_point{} && m_Stats.refresh_interval > std::chrono::nanoseconds::zero()) {
+            // Everything still queued is shown one refresh after another, and this frame comes after all of them.
+            const auto display_at = m_LastDisplayed + m_Stats.refresh_interval * static_cast<int64_t>(m_Queued.size() + 1);
+            const auto wake_at    = display_at - m_Stats.input_to_present - m_Settings.margin;
+
+            const auto now = clock::now();
+            if (wake_at > now) {
+                std::this_thread::sleep_until(std::min(wake_at, now + m_Stats.refresh_interval));
+            }
+        }
+
+        m_InputSampled = clock::now();
+        m_Stats.wait   = m_InputSampled - start;
+    }
+
+    uint64_t FramePacer::on_present(const uint64_t timeline_value) {
+        m_Stats.input_to_present = smooth(m_Stats.input_to_present, clock::now() - m_InputSampled);
+
+        const uint64_t present_id = m_NextPresentId++;
+        m_Queued.push_back(QueuedFrame{.present_id = present_id, .timeline_value = timeline_value, .input_sampled = m_InputSampled});
+        return present_id;
+    }
+
+    void FramePacer::reset() {
+        m_Queued.clear();
+        m_LastDisplayed = {};
+    }
+
+    std::optional<FramePacer::clock::time_point> FramePacer::wait_for(const QueuedFrame &frame, const vk::raii::SwapchainKHR &swapchain, const Timeline &timeline) const {
+        if (!m_PresentWaitSupported) {
+            if (timeline.reached(frame.timeline_value)) {
+                return std::nullopt;
+            }
+
+            timeline.wait(frame.timeline_value);
+            return clock::now();
+        }
+
+        try {
+            if (swapchain.waitForPresent(frame.present_id, 0) != vk::Result::eTimeout) {
+                return std::nullopt;
+            }
+
+            if (swapchain.waitForPresent(frame.present_id, PRESENT_WAIT_TIMEOUT) != vk::Result::eTimeout) {
+                return clock::now();
+            }
+        } catch (vk::OutOfDateKHRError &) {
+            // The swapchain is about to be recreated, which resets everything anyway.
+        }
+
+        return std::nullopt;
+    }
+} // namespace engine
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <optional>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "engine/renderer/timeline.hpp"
+
+namespace engine {
+    struct FramePacingSettings {
+        /**
+         * How many presented frames may still be waiting to reach the display when input is sampled for a new frame. Every queued frame is a refresh worth of input latency,
+         * 1 keeps latency low while still letting the CPU and GPU overlap.
+         */
+        uint32_t max_queued_frames = 1;
+
+        /**
+         * When the display's refresh can be measured (present wait is supported and presentation is vsynced), sleep before sampling input so the frame finishes just before
+         * the refresh it will be shown at, instead of sampling input as early as possible and then waiting.
+         */
+        bool just_in_time = true;
+
+        /**
+         * Safety margin kept when sleeping just-in-time. It also has to cover the frame's GPU time, which isn't measured.
+         */
+        std::chrono::microseconds margin{2000};
+    };
+
+    /**
+     * Latency measurements, smoothed over the last few frames.
+     */
+    struct FramePacingStats {
+        /**
+         * From sampling input to handing the frame to the presentation engine.
+         */
+        std::chrono::nanoseconds input_to_present{};
+
+        /**
+         * From sampling input to the frame reaching the display. Only measured when present wait is supported.
+         */
+        std::chrono::nanoseconds input_to_display{};
+
+        /**
+         * Time between frames reaching the display. Only measured when present wait is supported.
+         */
+        std::chrono::nanoseconds refresh_interval{};
+
+        /**
+         * How long the last frame waited (for the queue to drain and then just-in-time) before sampling input.
+         */
+        std::chrono::nanoseconds wait{};
+    };
+
+    /**
+     * Bounds how far the CPU can run ahead of the display. `Surface` calls `wait_for_input` before the application samples input for a frame, which blocks until at most
+     * `max_queued_frames` earlier frames are still queued for display, then optionally sleeps until just before the frame has to start.
+     *
+     * With `VK_KHR_present_wait` a frame counts as queued until it actually reaches the display. Without it the best available signal is the GPU finishing the frame.
+     */
+    class FramePacer {
+      public:
+        explicit FramePacer(bool present_wait_supported);
+
+        inline void set_settings(const FramePacingSettings &settings) { m_Settings = settings; }
+
+        [[nodiscard]] inline const FramePacingSettings &settings() const { return m_Settings; }
+
+        [[nodiscard]] inline const FramePacingStats &stats() const { return m_Stats; }
+
+        /**
+         * Block until the next frame should sample input.
+         *
+         * @param swapchain The swapchain frames are presented to.
+         * @param timeline The timeline frame submissions signal.
+         * @param vsync Whether presentation waits for vertical blank (the refresh interval is meaningless otherwise).
+         */
+        void wait_for_input(const vk::raii::SwapchainKHR &swapchain, const Timeline &timeline, bool vsync);
+
+        /**
+         * Record that a frame is being presented.
+         *
+         * @param timeline_value The timeline value the frame's submission signals.
+         * @return The present id to present the frame with (only meaningful when present wait is supported).
+         */
+        uint64_t on_present(uint64_t timeline_value);
+
+        /**
+         * Forget every queued frame. Present ids belong to a swapchain, so this has to be called whenever the swapchain is recreated.
+         */
+        void reset();
+
+      private:
+        using clock = std::chrono::steady_clock;
+
+        struct QueuedFrame {
+            uint64_t          present_id;
+            uint64_t          timeline_value;
+            clock::time_point input_sampled;
+        };
+
+        /**
+         * Wait for `frame` to reach the display (or the GPU to finish it).
+         *
+         * @return When the wait finished, or nothing if there was nothing to wait for (in which case the time it happened at isn't known).
+         */
+        std::optional<clock::time_point> wait_for(const QueuedFrame &frame, const vk::raii::SwapchainKHR &swapchain, const Timeline &timeline) const;
+
+        bool                m_PresentWaitSupported;
+        FramePacingSettings m_Settings;
+        FramePacingStats    m_Stats;
+
+        std::deque<QueuedFrame> m_Queued;
+        uint64_t                m_NextPresentId = 1;
+
+        clock::time_point m_InputSampled;
+        clock::time_point m_LastDisplayed;
+    };
+} // namespace engine
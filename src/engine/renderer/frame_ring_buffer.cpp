@@ -0,0 +1,83 @@
+#include "frame_ring_buffer.hpp"
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+namespace engine {
+    static vk::DeviceSize align_up(const vk::DeviceSize value, const vk::DeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    FrameRingBuffer::FrameRingBuffer(const std::shared_ptr<VulkanContext> &ctx, const uint32_t frames_in_flight, const vk::DeviceSize capacity)
+        : m_Context(ctx), m_FrameTimelineValues(frames_in_flight, 0), m_Spills(frames_in_flight) {
+        const auto &limits = m_Context->physical_device().getProperties().limits;
+        m_DefaultAlignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+
+        // Keeps every segment aligned for default allocations. Bigger explicit alignments are applied to the offset in the whole buffer instead (see `allocate`).
+        m_Capacity = align_up(capacity, m_DefaultAlignment);
+        m_Buffer   = m_Context->allocator().create_buffer(vk::BufferCreateInfo({}, m_Capacity * frames_in_flight, USAGE, vk::SharingMode::eExclusive), MemoryUsage::Upload);
+    }
+
+    FrameRingBuffer::~FrameRingBuffer() {
+        for (const auto value : m_FrameTimelineValues) {
+            m_Context->timeline(DeviceQueue::Primary).wait(value);
+        }
+    }
+
+    void FrameRingBuffer::begin_frame(const uint32_t frame_index) {
+        m_Context->timeline(DeviceQueue::Primary).wait(m_FrameTimelineValues[frame_index]);
+
+        m_CurrentFrame = frame_index;
+        m_Head.store(0, std::memory_order_relaxed);
+
+        std::lock_guard lock(m_SpillMutex);
+        m_Spills[frame_index].clear();
+    }
+
+    void FrameRingBuffer::end_frame(const uint64_t timeline_value) {
+        m_FrameTimelineValues[m_CurrentFrame] = timeline_value;
+    }
+
+    FrameAllocation FrameRingBuffer::allocate(const vk::DeviceSize size, vk::DeviceSize alignment) {
+        if (alignment == 0) {
+            alignment = m_DefaultAlignment;
+        }
+
+        // Segments are only aligned to the default alignment, so anything else has to be aligned in terms of the whole buffer.
+        const vk::DeviceSize base = static_cast<vk::DeviceSize>(m_CurrentFrame) * m_Capacity;
+        vk::DeviceSize       head = m_Head.load(std::memory_order_relaxed);
+        vk::DeviceSize       start;
+        do {
+            start = align_up(base + head, alignment) - base;
+            if (start + size > m_Capacity) {
+                return allocate_spilled(size, alignment);
+            }
+        } while (!m_Head.compare_exchange_weak(head, start + size, std::memory_order_relaxed));
+
+        const vk::DeviceSize offset = base + start;
+        return FrameAllocation{.buffer = *m_Buffer.buffer, .offset = offset, .size = size, .data = m_Buffer.allocation.mapped() + offset};
+    }
+
+    FrameAllocation FrameRingBuffer::allocate_spilled(const vk::DeviceSize size, const vk::DeviceSize alignment) {
+        std::lock_guard lock(m_SpillMutex);
+        auto           &spills = m_Spills[m_CurrentFrame];
+
+        if (spills.empty() || align_up(spills.back().head, alignment) + size > spills.back().buffer.allocation.size()) {
+            if (spills.empty()) {
+                spdlog::warn("Frame ring buffer ran out of its {} bytes, spilling into extra buffers for the rest of the frame.", m_Capacity);
+            }
+
+            spills.push_back(Spill{
+                .buffer = m_Context->allocator().create_buffer(
+                    vk::BufferCreateInfo({}, std::max(size, m_Capacity), USAGE, vk::SharingMode::eExclusive), MemoryUsage::Upload
+                ),
+            });
+        }
+
+        auto                &spill = spills.back();
+        const vk::DeviceSize start = align_up(spill.head, alignment);
+        spill.head                 = start + size;
+        return FrameAllocation{.buffer = *spill.buffer.buffer, .offset = start, .size = size, .data = spill.buffer.allocation.mapped() + start};
+    }
+} // namespace engine
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "engine/renderer/memory_allocator.hpp"
+#include "engine/renderer/vulkan_context.hpp"
+
+namespace engine {
+    /**
+     * A piece of a `FrameRingBuffer`, only valid until the frame it was allocated for is reused.
+     */
+    struct FrameAllocation {
+        vk::Buffer     buffer;
+        vk::DeviceSize offset = 0;
+        vk::DeviceSize size   = 0;
+        std::byte     *data   = nullptr;
+
+        [[nodiscard]] inline vk::DescriptorBufferInfo descriptor_info() const { return {buffer, offset, size}; }
+    };
+
+    /**
+     * Memory for data which only lives for a single frame (per-draw constants, UI vertices, ...). One persistently mapped buffer is split into a segment per frame in flight,
+     * and allocating just bumps a pointer in the current frame's segment. A segment is reused once the frame that last used it has finished on the GPU, so nothing is ever freed
+     * on its own.
+     *
+     * If a frame runs out of space, allocations spill into extra buffers which are released when the frame is reused. That's slow, so it's logged. Raise the capacity if it
+     * keeps happening.
+     *
+     * `allocate` may be called from any thread (including `Application::record_parallel` jobs).
+     */
+    class FrameRingBuffer {
+      public:
+        static constexpr vk::DeviceSize DEFAULT_CAPACITY = 4 * 1024 * 1024;
+
+        static constexpr vk::BufferUsageFlags USAGE = vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer |
+                                                      vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer |
+                                                      vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferSrc;
+
+        /**
+         * @param capacity Bytes available to each frame.
+         */
+        FrameRingBuffer(const std::shared_ptr<VulkanContext> &ctx, uint32_t frames_in_flight, vk::DeviceSize capacity = DEFAULT_CAPACITY);
+
+        /**
+         * Waits for every frame which used the buffer.
+         */
+        ~FrameRingBuffer();
+
+        FrameRingBuffer(const FrameRingBuffer &other)                = delete;
+        FrameRingBuffer(FrameRingBuffer &&other) noexcept            = delete;
+        FrameRingBuffer &operator=(const FrameRingBuffer &other)     = delete;
+        FrameRingBuffer &operator=(FrameRingBuffer &&other) noexcept = delete;
+
+        /**
+         * Start handing out `frame_index`'s segment (waiting for the frame which last used it first).
+         */
+        void begin_frame(uint32_t frame_index);
+
+        /**
+         * Remember the timeline value the current frame's submission signals.
+         */
+        void end_frame(uint64_t timeline_value);
+
+        /**
+         * @param alignment 0 means the largest of the device's uniform and storage buffer offset alignments, which suits any use.
+         */
+        [[nodiscard]] FrameAllocation allocate(vk::DeviceSize size, vk::DeviceSize alignment = 0);
+
+        /**
+         * Allocate space for `values` and copy them in.
+         */
+        template <typename T>
+        FrameAllocation push(const std::span<const T> values, const vk::DeviceSize alignment = 0) {
+            auto allocation = allocate(values.size_bytes(), alignment);
+            std::memcpy(allocation.data, values.data(), values.size_bytes());
+            return allocation;
+        }
+
+        template <typename T>
+        FrameAllocation push(const T &value, const vk::DeviceSize alignment = 0) {
+            return push(std::span<const T>(&value, 1), alignment);
+        }
+
+        [[nodiscard]] inline uint32_t frames_in_flight() const { return static_cast<uint32_t>(m_FrameTimelineValues.size()); }
+
+        [[nodiscard]] inline vk::DeviceSize capacity() const { return m_Capacity; }
+
+        /**
+         * How many bytes the current frame has used so far (not counting spilled allocations).
+         */
+        [[nodiscard]] inline vk::DeviceSize used() const { return std::min(m_Head.load(std::memory_order_relaxed), m_Capacity); }
+
+      private:
+        struct Spill {
+            AllocatedBuffer buffer;
+            vk::DeviceSize  head = 0;
+        };
+
+        [[nodiscard]] FrameAllocation allocate_spilled(vk::DeviceSize size, vk::DeviceSize alignment);
+
+        std::shared_ptr<VulkanContext> m_Context;
+        vk::DeviceSize                 m_Capacity;
+        vk::DeviceSize                 m_DefaultAlignment;
+
+        AllocatedBuffer m_Buffer;
+
+        uint32_t                    m_CurrentFrame = 0;
+        std::atomic<vk::DeviceSize> m_Head         = 0;
+        std::vector<uint64_t>       m_FrameTimelineValues;
+
+        std::mutex                      m_SpillMutex;
+        std::vector<std::vector<Spill>> m_Spills;
+    };
+} // namespace engine
@@ -0,0 +1,381 @@
+#include "gpu_scene.hpp"
+
+#include "engine/tools.hpp"
+
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <format>
+
+#include <glm/geometric.hpp>
+
+#include <spdlog/spdlog.h>
+
+namespace engine {
+    namespace {
+#if ENGINE_HAS_COMPILED_SHADERS
+        constexpr uint32_t CULL_SPIRV[] = {
+#include "shaders/gpu_cull.comp.inc"
+        };
+
+        constexpr uint32_t CULL_OCCLUSION_SPIRV[] = {
+#include "shaders/gpu_cull_occlusion.comp.inc"
+        };
+#endif
+
+        constexpr vk::DeviceSize COMMAND_SIZE = sizeof(vk::DrawIndexedIndirectCommand);
+
+        vk::DeviceSize align_up(const vk::DeviceSize value, const vk::DeviceSize alignment) {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        /**
+         * The planes of the view frustum (pointing inwards, normalized), taken straight from the matrix. Works for [0, 1] depth with or without reverse Z.
+         */
+        std::array<glm::vec4, 6> frustum_planes(const glm::mat4 &view_projection) {
+            const auto row = [&](const int i) { return glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]); };
+
+            std::array planes = {
+                row(3) + row(0), row(3) - row(0), row(3) + row(1), row(3) - row(1), row(2), row(3) - row(2),
+            };
+
+            for (auto &plane : planes) {
+                // An infinite far plane has no normal, and culls nothing.
+                const float length = glm::length(glm::vec3(plane));
+                plane              = length > 0.0f ? plane / length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            }
+            return planes;
+        }
+
+        /**
+         * Same test as `gpu_cull.comp`, without occlusion.
+         */
+        bool in_frustum(const GpuInstance &instance, const std::array<glm::vec4, 6> &planes) {
+            const glm::vec3 center = glm::vec3(instance.transform * glm::vec4(glm::vec3(instance.bounds), 1.0f));
+            const float     scale  = std::sqrt(std::max(
+                {glm::dot(glm::vec3(instance.transform[0]), glm::vec3(instance.transform[0])), glm::dot(glm::vec3(instance.transform[1]), glm::vec3(instance.transform[1])),
+                      glm::dot(glm::vec3(instance.transform[2]), glm::vec3(instance.transform[2]))}
+            ));
+            const float     radius = instance.bounds.w * scale;
+
+            return std::ranges::all_of(planes, [&](const glm::vec4 &plane) { return glm::dot(glm::vec3(plane), center) + plane.w >= -radius; });
+        }
+    } // namespace
+
+    GpuScene::GpuScene(
+        const std::shared_ptr<VulkanContext> &ctx, PipelineManager &pipelines, BindlessHeap *bindless, const uint32_t frames_in_flight, const GpuSceneSettings &settings
+    )
+        : m_Context(ctx), m_Bindless(bindless), m_Settings(settings), m_FramesInFlight(frames_in_flight), m_DrawIndirectCount(ctx->capabilities().draw_indirect_count),
+          m_Staging(frames_in_flight), m_InstanceIds(settings.max_instances) {
+        // Culled draws find their instance through `firstInstance`, which indirect draws can only set to something other than 0 with `drawIndirectFirstInstance`.
+        if (!ctx->capabilities().multi_draw_indirect || !ctx->capabilities().draw_indirect_first_instance) {
+            throw crash(CrashReason::UnsupportedSystem, "GPU driven rendering needs multi draw indirect and indirect first instance, which this GPU doesn't support.");
+        }
+
+        auto &allocator = ctx->allocator();
+        const auto storage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+        const auto create  = [&](const vk::DeviceSize size, const vk::BufferUsageFlags usage, const MemoryUsage memory) {
+            return allocator.create_buffer(vk::BufferCreateInfo({}, size, usage, vk::SharingMode::eExclusive), memory);
+        };
+
+        m_InstanceBuffer = create(settings.max_instances * sizeof(GpuInstance), storage, MemoryUsage::GpuOnly);
+        m_MeshBuffer     = create(settings.max_meshes * sizeof(GpuMesh), storage, MemoryUsage::GpuOnly);
+        m_BatchBuffer    = create(settings.max_batches * sizeof(GpuBatch), storage, MemoryUsage::GpuOnly);
+        m_CommandBuffer  = create(settings.max_instances * COMMAND_SIZE, storage | vk::BufferUsageFlagBits::eIndirectBuffer, MemoryUsage::GpuOnly);
+        m_CountBuffer    = create(settings.max_batches * sizeof(uint32_t), storage | vk::BufferUsageFlagBits::eIndirectBuffer, MemoryUsage::GpuOnly);
+
+        const auto &limits = ctx->physical_device().getProperties().limits;
+        m_ViewStride       = align_up(sizeof(ViewUniform), limits.minUniformBufferOffsetAlignment);
+        m_ViewBuffer       = create(m_ViewStride * frames_in_flight, vk::BufferUsageFlagBits::eUniformBuffer, MemoryUsage::Upload);
+        m_CpuDrawStride    = align_up(settings.max_instances * COMMAND_SIZE + settings.max_batches * sizeof(uint32_t), 16);
+        m_CpuDrawBuffer    = create(m_CpuDrawStride * frames_in_flight, vk::BufferUsageFlagBits::eIndirectBuffer, MemoryUsage::Upload);
+
+        const std::array bindings = {
+            vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+            vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+            vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+            vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+            vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+            vk::DescriptorSetLayoutBinding(5, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eCompute),
+        };
+        m_SetLayout = vk::raii::DescriptorSetLayout(ctx->device(), vk::DescriptorSetLayoutCreateInfo({}, bindings));
+
+        const std::array pool_sizes = {vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 5), vk::DescriptorPoolSize(vk::DescriptorType::eUniformBufferDynamic, 1)};
+        m_DescriptorPool = vk::raii::DescriptorPool(ctx->device(), vk::DescriptorPoolCreateInfo({}, 1, pool_sizes));
+
+        const vk::DescriptorSetLayout set_layout = *m_SetLayout;
+        m_Set = (*ctx->device()).allocateDescriptorSets(vk::DescriptorSetAllocateInfo(*m_DescriptorPool, set_layout)).front();
+
+        // Every buffer is fixed for the scene's lifetime, so the set is only written once.
+        const std::array buffer_infos = {
+            vk::DescriptorBufferInfo(*m_InstanceBuffer.buffer, 0, vk::WholeSize),
+            vk::DescriptorBufferInfo(*m_MeshBuffer.buffer, 0, vk::WholeSize),
+            vk::DescriptorBufferInfo(*m_BatchBuffer.buffer, 0, vk::WholeSize),
+            vk::DescriptorBufferInfo(*m_CommandBuffer.buffer, 0, vk::WholeSize),
+            vk::DescriptorBufferInfo(*m_CountBuffer.buffer, 0, vk::WholeSize),
+            vk::DescriptorBufferInfo(*m_ViewBuffer.buffer, 0, sizeof(ViewUniform)),
+        };
+        std::array<vk::WriteDescriptorSet, buffer_infos.size()> writes;
+        for (uint32_t binding = 0; binding < writes.size(); binding++) {
+            writes[binding] = vk::WriteDescriptorSet(m_Set, binding, 0, 1, bindings[binding].descriptorType, nullptr, &buffer_infos[binding]);
+        }
+        ctx->device().updateDescriptorSets(writes, nullptr);
+
+#if ENGINE_HAS_COMPILED_SHADERS
+        m_Occlusion = m_Bindless != nullptr;
+
+        std::vector<vk::DescriptorSetLayout> set_layouts = {set_layout};
+        if (m_Occlusion) {
+            set_layouts.push_back(*m_Bindless->layout());
+        }
+        m_PipelineLayout = vk::raii::PipelineLayout(ctx->device(), vk::PipelineLayoutCreateInfo({}, set_layouts));
+
+        const auto spirv = m_Occlusion ? std::span<const uint32_t>(CULL_OCCLUSION_SPIRV) : std::span<const uint32_t>(CULL_SPIRV);
+        m_CullPipeline   = pipelines.request(ComputePipelineDesc{
+              .shader = ShaderStageDesc{.spirv = std::vector(spirv.begin(), spirv.end())},
+              .layout = *m_PipelineLayout,
+        });
+#else
+        static_cast<void>(pipelines);
+        spdlog::warn("The engine was built without its shaders (glslc wasn't found), GPU driven rendering will cull on the CPU.");
+#endif
+    }
+
+    uint32_t GpuScene::add_mesh(const GpuMesh &mesh) {
+        std::lock_guard lock(m_Mutex);
+        if (m_Meshes.size() >= m_Settings.max_meshes) {
+            throw crash(CrashReason::CriticalFailure, std::format("The GPU scene is out of room for meshes (all {} are in use).", m_Settings.max_meshes));
+        }
+
+        const auto index = static_cast<uint32_t>(m_Meshes.size());
+        m_Meshes.push_back(mesh);
+        m_DirtyMeshes.add(index);
+        return index;
+    }
+
+    uint32_t GpuScene::add_batch(const uint32_t capacity) {
+        std::lock_guard lock(m_Mutex);
+        if (m_Batches.size() >= m_Settings.max_batches || capacity > m_Settings.max_instances - m_NextCommand) {
+            throw crash(CrashReason::CriticalFailure, "The GPU scene is out of room for batches (raise max_batches or max_instances).");
+        }
+
+        const auto index = static_cast<uint32_t>(m_Batches.size());
+        m_Batches.push_back(GpuBatch{.first_command = m_NextCommand, .capacity = capacity});
+        m_NextCommand += capacity;
+        m_DirtyBatches.add(index);
+        return index;
+    }
+
+    uint32_t GpuScene::add_instance(const GpuInstance &instance) {
+        const uint32_t id = m_InstanceIds.allocate();
+        if (id == IndexAllocator::INVALID) {
+            throw crash(CrashReason::CriticalFailure, std::format("The GPU scene is out of room for instances (all {} are in use).", m_Settings.max_instances));
+        }
+
+        {
+            std::lock_guard lock(m_Mutex);
+            if (id >= m_Instances.size()) {
+                m_Instances.resize(id + 1, GpuInstance{.mesh = INVALID_MESH});
+            }
+        }
+
+        update_instance(id, instance);
+        return id;
+    }
+
+    void GpuScene::update_instance(const uint32_t id, const GpuInstance &instance) {
+        std::lock_guard lock(m_Mutex);
+
+        // The culling shader trusts these, so they're checked here instead.
+        if (instance.batch >= m_Batches.size() || (instance.mesh != INVALID_MESH && instance.mesh >= m_Meshes.size())) {
+            throw crash(CrashReason::CriticalFailure, std::format("GPU scene instance {} refers to a mesh or batch which doesn't exist.", id));
+        }
+
+        m_Instances.at(id) = instance;
+        m_DirtyInstances.add(id);
+    }
+
+    void GpuScene::remove_instance(const uint32_t id) {
+        {
+            std::lock_guard lock(m_Mutex);
+            m_Instances.at(id).mesh = INVALID_MESH;
+            m_DirtyInstances.add(id);
+        }
+        m_InstanceIds.release(id);
+    }
+
+    template <typename T>
+    vk::DeviceSize GpuScene::stage(
+        const vk::raii::CommandBuffer &cmd, const Staging &staging, const vk::DeviceSize offset, const AllocatedBuffer &buffer, const std::vector<T> &items, DirtyRange &dirty
+    ) {
+        if (dirty.empty()) {
+            return offset;
+        }
+
+        const auto data = std::as_bytes(std::span(items).subspan(dirty.first, dirty.last - dirty.first));
+        std::memcpy(staging.buffer.allocation.mapped() + offset, data.data(), data.size());
+        cmd.copyBuffer(*staging.buffer.buffer, *buffer.buffer, vk::BufferCopy(offset, dirty.first * sizeof(T), data.size()));
+
+        dirty = {};
+        return align_up(offset + data.size(), 16);
+    }
+
+    void GpuScene::record_updates(const vk::raii::CommandBuffer &cmd, const uint32_t frame_index) {
+        std::lock_guard lock(m_Mutex);
+
+        const auto dirty_size = [](const DirtyRange &dirty, const vk::DeviceSize stride) {
+            return dirty.empty() ? 0 : align_up((dirty.last - dirty.first) * stride, 16);
+        };
+        const vk::DeviceSize size = dirty_size(m_DirtyMeshes, sizeof(GpuMesh)) + dirty_size(m_DirtyBatches, sizeof(GpuBatch)) +
+                                    dirty_size(m_DirtyInstances, sizeof(GpuInstance));
+        if (size == 0) {
+            return;
+        }
+
+        // The frame which used this staging buffer last has finished (its frame index came around again), so it can be overwritten or replaced.
+        auto &staging = m_Staging[frame_index];
+        if (size > staging.size) {
+            if (*staging.buffer.buffer) {
+                m_Context->retire(std::move(staging.buffer));
+            }
+
+            staging.size   = std::bit_ceil(size);
+            staging.buffer = m_Context->allocator().create_buffer(
+                vk::BufferCreateInfo({}, staging.size, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive), MemoryUsage::Upload
+            );
+        }
+
+        const BufferState readers{
+            .access = vk::AccessFlagBits2::eShaderStorageRead,
+            .stage  = vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eVertexShader,
+        };
+        const BufferState copy{.access = vk::AccessFlagBits2::eTransferWrite, .stage = vk::PipelineStageFlagBits2::eCopy};
+
+        // Earlier frames may still be culling or drawing with the old data.
+        BarrierBatch barriers;
+        barriers.global(readers, copy);
+        barriers.flush(cmd);
+
+        vk::DeviceSize offset = stage(cmd, staging, 0, m_MeshBuffer, m_Meshes, m_DirtyMeshes);
+        offset                = stage(cmd, staging, offset, m_BatchBuffer, m_Batches, m_DirtyBatches);
+        stage(cmd, staging, offset, m_InstanceBuffer, m_Instances, m_DirtyInstances);
+
+        barriers.global(copy, readers);
+        barriers.flush(cmd);
+    }
+
+    void GpuScene::cull(const vk::raii::CommandBuffer &cmd, const uint32_t frame_index, const CullView &view) {
+        record_updates(cmd, frame_index);
+
+        uint32_t instance_count;
+        {
+            std::lock_guard lock(m_Mutex);
+            instance_count = static_cast<uint32_t>(m_Instances.size());
+        }
+
+        const auto         planes   = frustum_planes(view.view_projection);
+        const vk::Pipeline pipeline = m_CullPipeline ? m_CullPipeline.get() : nullptr;
+        m_CulledOnGpu               = static_cast<bool>(pipeline);
+        if (!pipeline) {
+            cull_on_cpu(frame_index, planes);
+            return;
+        }
+
+        const ViewUniform uniform{
+            .view_projection = view.view_projection,
+            .planes          = planes,
+            .pyramid_size    = view.pyramid_size,
+            .pyramid_mips    = std::max(view.pyramid_mips, 1u),
+            .depth_pyramid   = m_Occlusion ? view.depth_pyramid : BindlessHeap::INVALID_INDEX,
+            .depth_sampler   = view.depth_sampler,
+            .reverse_z       = view.reverse_z ? 1u : 0u,
+            .instance_count  = instance_count,
+            .padding         = 0,
+        };
+        std::memcpy(m_ViewBuffer.allocation.mapped() + frame_index * m_ViewStride, &uniform, sizeof(uniform));
+
+        // The previous frame's draws have to be done reading the commands before they're overwritten. Without the count the whole command buffer is cleared, so unused slots
+        // draw nothing.
+        BarrierBatch barriers;
+        barriers.global(
+            BufferState{.access = vk::AccessFlagBits2::eIndirectCommandRead, .stage = vk::PipelineStageFlagBits2::eDrawIndirect},
+            BufferState{.access = vk::AccessFlagBits2::eTransferWrite, .stage = vk::PipelineStageFlagBits2::eClear}
+        );
+        barriers.flush(cmd);
+
+        cmd.fillBuffer(*m_CountBuffer.buffer, 0, vk::WholeSize, 0);
+        if (!m_DrawIndirectCount) {
+            cmd.fillBuffer(*m_CommandBuffer.buffer, 0, vk::WholeSize, 0);
+        }
+
+        barriers.global(
+            BufferState{.access = vk::AccessFlagBits2::eTransferWrite, .stage = vk::PipelineStageFlagBits2::eClear},
+            BufferState{.access = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite, .stage = vk::PipelineStageFlagBits2::eComputeShader}
+        );
+        barriers.flush(cmd);
+
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *m_PipelineLayout, 0, m_Set, static_cast<uint32_t>(frame_index * m_ViewStride));
+        if (m_Occlusion) {
+            m_Bindless->bind(cmd, vk::PipelineBindPoint::eCompute, *m_PipelineLayout, 1);
+        }
+        cmd.dispatch((instance_count + 63) / 64, 1, 1);
+
+        barriers.global(
+            BufferState{.access = vk::AccessFlagBits2::eShaderStorageWrite, .stage = vk::PipelineStageFlagBits2::eComputeShader},
+            BufferState{.access = vk::AccessFlagBits2::eIndirectCommandRead, .stage = vk::PipelineStageFlagBits2::eDrawIndirect}
+        );
+        barriers.flush(cmd);
+
+        m_DrawSource = DrawSource{.commands = *m_CommandBuffer.buffer, .commands_offset = 0, .counts = *m_CountBuffer.buffer, .counts_offset = 0};
+    }
+
+    void GpuScene::cull_on_cpu(const uint32_t frame_index, const std::array<glm::vec4, 6> &planes) {
+        const vk::DeviceSize base          = frame_index * m_CpuDrawStride;
+        const vk::DeviceSize counts_offset = base + m_Settings.max_instances * COMMAND_SIZE;
+
+        auto *commands = reinterpret_cast<vk::DrawIndexedIndirectCommand *>(m_CpuDrawBuffer.allocation.mapped() + base);
+        auto *counts   = reinterpret_cast<uint32_t *>(m_CpuDrawBuffer.allocation.mapped() + counts_offset);
+
+        std::lock_guard lock(m_Mutex);
+        std::fill_n(counts, m_Batches.size(), 0u);
+        if (!m_DrawIndirectCount) {
+            std::fill_n(commands, m_NextCommand, vk::DrawIndexedIndirectCommand{});
+        }
+
+        for (uint32_t id = 0; id < m_Instances.size(); id++) {
+            const auto &instance = m_Instances[id];
+            if (instance.mesh == INVALID_MESH || !in_frustum(instance, planes)) {
+                continue;
+            }
+
+            const auto    &batch = m_Batches[instance.batch];
+            const uint32_t slot  = counts[instance.batch]++;
+            if (slot >= batch.capacity) {
+                continue;
+            }
+
+            const auto &mesh                      = m_Meshes[instance.mesh];
+            commands[batch.first_command + slot] = vk::DrawIndexedIndirectCommand(mesh.index_count, 1, mesh.first_index, mesh.vertex_offset, id);
+        }
+
+        m_DrawSource = DrawSource{.commands = *m_CpuDrawBuffer.buffer, .commands_offset = base, .counts = *m_CpuDrawBuffer.buffer, .counts_offset = counts_offset};
+    }
+
+    void GpuScene::draw(const vk::raii::CommandBuffer &cmd, const uint32_t batch) const {
+        GpuBatch batch_info;
+        {
+            std::lock_guard lock(m_Mutex);
+            batch_info = m_Batches.at(batch);
+        }
+
+        const vk::DeviceSize offset = m_DrawSource.commands_offset + batch_info.first_command * COMMAND_SIZE;
+        if (m_DrawIndirectCount) {
+            cmd.drawIndexedIndirectCount(
+                m_DrawSource.commands, offset, m_DrawSource.counts, m_DrawSource.counts_offset + batch * sizeof(uint32_t), batch_info.capacity, COMMAND_SIZE
+            );
+        } else {
+            cmd.drawIndexedIndirect(m_DrawSource.commands, offset, batch_info.capacity, COMMAND_SIZE);
+        }
+    }
+} // namespace engine
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "engine/renderer/bindless_heap.hpp"
+#include "engine/renderer/memory_allocator.hpp"
+#include "engine/renderer/pipeline_manager.hpp"
+#include "engine/renderer/vulkan_context.hpp"
+
+namespace engine {
+    /**
+     * Where a mesh is in the index and vertex buffers it's drawn from (which are bound by whoever draws the batch). Matches `gpu_cull.comp`.
+     */
+    struct GpuMesh {
+        uint32_t index_count   = 0;
+        uint32_t first_index   = 0;
+        int32_t  vertex_offset = 0;
+        uint32_t padding       = 0;
+    };
+
+    /**
+     * One thing to draw. Culled draws use the instance's index as their `firstInstance`, so vertex shaders can find it with `gl_InstanceIndex` in `GpuScene::instance_buffer`.
+     * Matches `gpu_cull.comp` (std430).
+     */
+    struct GpuInstance {
+        glm::mat4 transform{1.0f};
+
+        /**
+         * Bounding sphere in object space (center, radius).
+         */
+        glm::vec4 bounds{0.0f, 0.0f, 0.0f, 1.0f};
+
+        uint32_t mesh  = 0;
+        uint32_t batch = 0;
+
+        /**
+         * Not used by the scene (material index, ...).
+         */
+        uint32_t user_data = 0;
+        uint32_t padding   = 0;
+    };
+
+    static_assert(sizeof(GpuInstance) == 96);
+
+    /**
+     * The camera instances are culled against.
+     */
+    struct CullView {
+        glm::mat4 view_projection{1.0f};
+
+        /**
+         * Whether depth gets smaller with distance (this only matters for occlusion culling).
+         */
+        bool reverse_z = false;
+
+        /**
+         * Bindless index of last frame's depth pyramid, or `BindlessHeap::INVALID_INDEX` to skip occlusion culling. Every texel of each level has to hold the furthest depth of
+         * the texels it covers in the level above it, and the sampler has to use nearest filtering and clamp to edge. Only used when the scene has a bindless heap.
+         */
+        uint32_t   depth_pyramid = BindlessHeap::INVALID_INDEX;
+        uint32_t   depth_sampler = 0;
+        glm::uvec2 pyramid_size{0, 0};
+        uint32_t   pyramid_mips = 1;
+    };
+
+    struct GpuSceneSettings {
+        uint32_t max_instances = 65536;
+        uint32_t max_meshes    = 4096;
+        uint32_t max_batches   = 64;
+    };
+
+    /**
+     * GPU driven drawing. Instances live in a GPU buffer, and every frame a compute shader culls them against the view (and optionally last frame's depth), writing a compacted
+     * list of indirect draws and a count for each batch. Drawing a batch is then a single `drawIndexedIndirectCount`, however many instances it has. A batch is whatever is
+     * drawn with one pipeline and one set of vertex/index buffers.
+     *
+     * Changes to instances, meshes and batches are copied into the GPU buffers by `cull`, on the primary queue right before culling, so they show up in the frame they're
+     * culled in. They're staged through a host visible buffer per frame in flight, which grows to fit the biggest update. (The upload service isn't used: it copies on the
+     * transfer queue, which would race the frames reading the same buffers and would need every buffer handed back to the transfer queue before each update.)
+     *
+     * Until the culling pipeline has compiled (or if glslc wasn't found when the engine was built) culling happens on the CPU instead, writing the draws into a host visible
+     * buffer. Drawing works the same either way.
+     *
+     * Needs `DeviceCapabilities::multi_draw_indirect` and `draw_indirect_first_instance`. Without `draw_indirect_count` every batch is drawn with its full capacity, culled
+     * draws just have no instances.
+     */
+    class GpuScene {
+      public:
+        static constexpr uint32_t INVALID_MESH = UINT32_MAX;
+
+        /**
+         * @param bindless Needed for occlusion culling (can be null).
+         */
+        GpuScene(
+            const std::shared_ptr<VulkanContext> &ctx, PipelineManager &pipelines, BindlessHeap *bindless, uint32_t frames_in_flight, const GpuSceneSettings &settings = {}
+        );
+
+        GpuScene(const GpuScene &other)                = delete;
+        GpuScene(GpuScene &&other) noexcept            = delete;
+        GpuScene &operator=(const GpuScene &other)     = delete;
+        GpuScene &operator=(GpuScene &&other) noexcept = delete;
+
+        [[nodiscard]] uint32_t add_mesh(const GpuMesh &mesh);
+
+        /**
+         * @param capacity The most instances the batch can draw in a frame. Capacities of all batches together can't exceed `max_instances`.
+         */
+        [[nodiscard]] uint32_t add_batch(uint32_t capacity);
+
+        [[nodiscard]] uint32_t add_instance(const GpuInstance &instance);
+
+        void update_instance(uint32_t id, const GpuInstance &instance);
+
+        void remove_instance(uint32_t id);
+
+        /**
+         * Copy everything which changed since the last cull into the GPU buffers, then cull every instance for `frame_index`. Has to be recorded on the primary queue outside of
+         * rendering, before any `draw` for the frame.
+         */
+        void cull(const vk::raii::CommandBuffer &cmd, uint32_t frame_index, const CullView &view);
+
+        /**
+         * Draw whatever survived culling in `batch`. The batch's pipeline and vertex/index buffers have to be bound.
+         */
+        void draw(const vk::raii::CommandBuffer &cmd, uint32_t batch) const;
+
+        [[nodiscard]] inline vk::Buffer instance_buffer() const { return *m_InstanceBuffer.buffer; }
+
+        /**
+         * Whether the last `cull` ran on the GPU.
+         */
+        [[nodiscard]] inline bool culled_on_gpu() const { return m_CulledOnGpu; }
+
+      private:
+        struct GpuBatch {
+            uint32_t first_command;
+            uint32_t capacity;
+            uint32_t padding0 = 0;
+            uint32_t padding1 = 0;
+        };
+
+        /**
+         * Matches the uniform block in `gpu_cull.comp` (std140).
+         */
+        struct ViewUniform {
+            glm::mat4                view_projection;
+            std::array<glm::vec4, 6> planes;
+            glm::uvec2               pyramid_size;
+            uint32_t                 pyramid_mips;
+            uint32_t                 depth_pyramid;
+            uint32_t                 depth_sampler;
+            uint32_t                 reverse_z;
+            uint32_t                 instance_count;
+            uint32_t                 padding;
+        };
+
+        static_assert(sizeof(ViewUniform) == 192);
+
+        /**
+         * Where `draw` reads the commands and counts written by the last `cull`.
+         */
+        struct DrawSource {
+            vk::Buffer     commands;
+            vk::DeviceSize commands_offset = 0;
+            vk::Buffer     counts;
+            vk::DeviceSize counts_offset = 0;
+        };
+
+        struct Staging {
+            AllocatedBuffer buffer;
+            vk::DeviceSize  size = 0;
+        };
+
+        /**
+         * Range of an array which changed since the last cull.
+         */
+        struct DirtyRange {
+            uint32_t first = UINT32_MAX;
+            uint32_t last  = 0;
+
+            inline void add(const uint32_t index) {
+                first = std::min(first, index);
+                last  = std::max(last, index + 1);
+            }
+
+            [[nodiscard]] inline bool empty() const { return first >= last; }
+        };
+
+        /**
+         * Record copies of everything which changed into the GPU buffers, staged through `frame_index`'s staging buffer.
+         */
+        void record_updates(const vk::raii::CommandBuffer &cmd, uint32_t frame_index);
+
+        /**
+         * Stage the dirty part of `items` at `offset` and record its copy into `buffer`.
+         *
+         * @return Where the next copy can be staged.
+         */
+        template <typename T>
+        vk::DeviceSize stage(const vk::raii::CommandBuffer &cmd, const Staging &staging, vk::DeviceSize offset, const AllocatedBuffer &buffer, const std::vector<T> &items, DirtyRange &dirty);
+
+        void cull_on_cpu(uint32_t frame_index, const std::array<glm::vec4, 6> &planes);
+
+        std::shared_ptr<VulkanContext> m_Context;
+        BindlessHeap                  *m_Bindless;
+        GpuSceneSettings               m_Settings;
+        uint32_t                       m_FramesInFlight;
+        bool                           m_DrawIndirectCount;
+
+        AllocatedBuffer m_InstanceBuffer;
+        AllocatedBuffer m_MeshBuffer;
+        AllocatedBuffer m_BatchBuffer;
+        AllocatedBuffer m_CommandBuffer;
+        AllocatedBuffer m_CountBuffer;
+
+        // Per frame in flight: staged updates, the view uniform, and the commands and counts written by the CPU fallback.
+        std::vector<Staging> m_Staging;
+        AllocatedBuffer      m_ViewBuffer;
+        vk::DeviceSize  m_ViewStride = 0;
+        AllocatedBuffer m_CpuDrawBuffer;
+        vk::DeviceSize  m_CpuDrawStride = 0;
+
+        vk::raii::DescriptorSetLayout m_SetLayout      = nullptr;
+        vk::raii::DescriptorPool      m_DescriptorPool = nullptr;
+        vk::DescriptorSet             m_Set;
+        vk::raii::PipelineLayout      m_PipelineLayout = nullptr;
+        PipelineHandle                m_CullPipeline;
+        bool                          m_Occlusion = false;
+
+        mutable std::mutex       m_Mutex;
+        std::vector<GpuInstance> m_Instances;
+        std::vector<GpuMesh>     m_Meshes;
+        std::vector<GpuBatch>    m_Batches;
+        IndexAllocator           m_InstanceIds;
+        uint32_t                 m_NextCommand = 0;
+
+        DirtyRange m_DirtyInstances;
+        DirtyRange m_DirtyMeshes;
+        DirtyRange m_DirtyBatches;
+
+        DrawSource m_DrawSource;
+        bool       m_CulledOnGpu = false;
+    };
+} // namespace engine
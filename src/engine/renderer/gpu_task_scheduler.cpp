@@ -0,0 +1,152 @@
+#include "gpu_task_scheduler.hpp"
+
+#include "engine/tools.hpp"
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+namespace engine {
+    GpuTaskStatus GpuTaskHandle::status() const {
+        return m_State ? m_State->status.load(std::memory_order_acquire) : GpuTaskStatus::Completed;
+    }
+
+    float GpuTaskHandle::progress() const {
+        if (!m_State || m_State->desc.slice_count == 0) {
+            return 1.0f;
+        }
+        return static_cast<float>(m_State->completed_slices.load(std::memory_order_relaxed)) / static_cast<float>(m_State->desc.slice_count);
+    }
+
+    void GpuTaskHandle::cancel() const {
+        if (m_State) {
+            m_State->cancel_requested.store(true, std::memory_order_release);
+        }
+    }
+
+    GpuTaskScheduler::GpuTaskScheduler(const std::shared_ptr<VulkanContext> &ctx, const GpuTaskSchedulerSettings &settings) : m_Context(ctx), m_Settings(settings) {}
+
+    GpuTaskScheduler::~GpuTaskScheduler() {
+        for (const auto &submission : m_InFlight) {
+            m_Context->timeline(submission.queue).wait(submission.timeline_value);
+        }
+    }
+
+    GpuTaskHandle GpuTaskScheduler::schedule(GpuTaskDesc desc) {
+        if (desc.queue != DeviceQueue::PrimaryLowPriority && desc.queue != DeviceQueue::TransferLowPriority && desc.queue != DeviceQueue::ComputeLowPriority) {
+            throw crash(CrashReason::CriticalFailure, "Background GPU task " + desc.name + " has to run on a low priority queue.");
+        }
+
+        auto state  = std::make_shared<GpuTaskHandle::State>();
+        state->desc = std::move(desc);
+
+        std::lock_guard lock(m_Mutex);
+        m_Scheduled.push_back(state);
+        return GpuTaskHandle(std::move(state));
+    }
+
+    void GpuTaskScheduler::pump() {
+        {
+            std::lock_guard lock(m_Mutex);
+            for (auto &task : m_Scheduled) {
+                m_Running.push_back(std::move(task));
+            }
+            m_Scheduled.clear();
+        }
+
+        retire();
+
+        uint32_t submitted = 0;
+        size_t   visited   = 0;
+        while (submitted < m_Settings.max_slices_per_pump && m_InFlight.size() < m_Settings.max_slices_in_flight && visited < m_Running.size()) {
+            // Round robin: the task at the front gets a slice and goes to the back.
+            auto task = m_Running.front();
+            m_Running.pop_front();
+            m_Running.push_back(task);
+            visited++;
+
+            if (task->cancel_requested.load(std::memory_order_acquire) || task->submitted_slices == task->desc.slice_count) {
+                continue;
+            }
+
+            submit_slice(task);
+            submitted++;
+            visited = 0;
+        }
+    }
+
+    void GpuTaskScheduler::retire() {
+        for (auto it = m_InFlight.begin(); it != m_InFlight.end();) {
+            if (!m_Context->timeline(it->queue).reached(it->timeline_value)) {
+                ++it;
+                continue;
+            }
+
+            it->task->slices_in_flight--;
+            it->task->completed_slices.fetch_add(1, std::memory_order_relaxed);
+            m_Pools[static_cast<size_t>(it->queue)].free.push_back(std::move(it->cmd));
+            it = m_InFlight.erase(it);
+        }
+
+        std::erase_if(m_Running, [](const std::shared_ptr<GpuTaskHandle::State> &task) {
+            if (task->slices_in_flight > 0) {
+                return false;
+            }
+
+            if (task->cancel_requested.load(std::memory_order_acquire)) {
+                task->status.store(GpuTaskStatus::Cancelled, std::memory_order_release);
+                return true;
+            }
+
+            if (task->completed_slices.load(std::memory_order_relaxed) == task->desc.slice_count) {
+                task->status.store(GpuTaskStatus::Completed, std::memory_order_release);
+                if (task->desc.on_complete) {
+                    task->desc.on_complete();
+                }
+                return true;
+            }
+
+            return false;
+        });
+    }
+
+    void GpuTaskScheduler::submit_slice(const std::shared_ptr<GpuTaskHandle::State> &task) {
+        const auto queue = m_Context->resolve(task->desc.queue);
+
+        auto cmd = take_command_buffer(queue);
+        cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        task->desc.record_slice(cmd, task->submitted_slices);
+        cmd.end();
+
+        const vk::CommandBufferSubmitInfo cbsi{*cmd, 0};
+        const uint64_t                    value = m_Context->submit(queue, cbsi);
+
+        if (task->submitted_slices == 0) {
+            spdlog::debug("Started background GPU task {} ({} slices).", task->desc.name, task->desc.slice_count);
+        }
+
+        task->submitted_slices++;
+        task->slices_in_flight++;
+        task->status.store(GpuTaskStatus::Running, std::memory_order_release);
+        m_InFlight.push_back(Submission{.task = task, .queue = queue, .timeline_value = value, .cmd = std::move(cmd)});
+    }
+
+    vk::raii::CommandBuffer GpuTaskScheduler::take_command_buffer(const DeviceQueue queue) {
+        auto &pool = m_Pools[static_cast<size_t>(queue)];
+        if (!*pool.pool) {
+            pool.pool = vk::raii::CommandPool(
+                m_Context->device(),
+                vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer, m_Context->queue_family(queue))
+            );
+        }
+
+        if (pool.free.empty()) {
+            return std::move(m_Context->device().allocateCommandBuffers(vk::CommandBufferAllocateInfo(*pool.pool, vk::CommandBufferLevel::ePrimary, 1)).front());
+        }
+
+        auto cmd = std::move(pool.free.back());
+        pool.free.pop_back();
+        cmd.reset();
+        return cmd;
+    }
+} // namespace engine
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "engine/renderer/vulkan_context.hpp"
+
+namespace engine {
+    enum class GpuTaskStatus {
+        Pending,
+        Running,
+        Completed,
+        Cancelled,
+    };
+
+    /**
+     * A long running piece of GPU work, split into slices which are small enough that running one doesn't get in the way of frames.
+     */
+    struct GpuTaskDesc {
+        std::string name;
+
+        /**
+         * How many slices the task is made of.
+         */
+        uint32_t slice_count = 1;
+
+        /**
+         * Record slice `slice` (in `[0, slice_count)`) into `cmd`. Slices are submitted in order to the same queue, so a slice can depend on the results of earlier ones with a
+         * pipeline barrier at its start.
+         */
+        std::function<void(const vk::raii::CommandBuffer &cmd, uint32_t slice)> record_slice;
+
+        /**
+         * Called from `GpuTaskScheduler::pump` once every slice has finished on the GPU. Not called for cancelled tasks.
+         */
+        std::function<void()> on_complete;
+
+        /**
+         * One of the low priority queues.
+         */
+        DeviceQueue queue = DeviceQueue::ComputeLowPriority;
+    };
+
+    class GpuTaskScheduler;
+
+    /**
+     * Shared between the scheduler and whoever scheduled a task. Safe to use from any thread.
+     */
+    class GpuTaskHandle {
+      public:
+        GpuTaskHandle() = default;
+
+        [[nodiscard]] GpuTaskStatus status() const;
+
+        /**
+         * The fraction of slices which have finished on the GPU.
+         */
+        [[nodiscard]] float progress() const;
+
+        [[nodiscard]] inline bool finished() const {
+            const auto current = status();
+            return current == GpuTaskStatus::Completed || current == GpuTaskStatus::Cancelled;
+        }
+
+        /**
+         * Stop submitting slices. Slices which were already submitted still run, the task counts as cancelled once they're done.
+         */
+        void cancel() const;
+
+        [[nodiscard]] inline explicit operator bool() const { return m_State != nullptr; }
+
+      private:
+        friend class GpuTaskScheduler;
+
+        struct State {
+            GpuTaskDesc desc;
+
+            std::atomic<GpuTaskStatus> status           = GpuTaskStatus::Pending;
+            std::atomic<uint32_t>      completed_slices = 0;
+            std::atomic<bool>          cancel_requested = false;
+
+            // Only touched by the scheduler.
+            uint32_t submitted_slices = 0;
+            uint32_t slices_in_flight = 0;
+        };
+
+        explicit GpuTaskHandle(std::shared_ptr<State> state) : m_State(std::move(state)) {}
+
+        std::shared_ptr<State> m_State;
+    };
+
+    struct GpuTaskSchedulerSettings {
+        /**
+         * How many slices may be submitted but not finished at once (across every task). Keeping this low keeps the low priority queue's backlog short, so the GPU can get back
+         * to frame work quickly when the hardware doesn't preempt.
+         */
+        uint32_t max_slices_in_flight = 2;
+
+        /**
+         * How many slices `pump` submits at most, which bounds the CPU time it takes per frame.
+         */
+        uint32_t max_slices_per_pump = 1;
+    };
+
+    /**
+     * Runs background GPU work (procedural generation and the like) on the low priority queues a slice at a time. The application pumps the scheduler once per frame, right after
+     * submitting the frame: finished slices are retired and new ones are submitted, round robin across the tasks which are running. Pumping never waits on the GPU.
+     *
+     * When the device has no separate low priority queue the work ends up on a normal queue (possibly the primary one). It's still sliced, so it only ever delays a frame by
+     * about a slice.
+     */
+    class GpuTaskScheduler {
+      public:
+        explicit GpuTaskScheduler(const std::shared_ptr<VulkanContext> &ctx, const GpuTaskSchedulerSettings &settings = {});
+
+        /**
+         * Cancels every task and waits for the slices already submitted.
+         */
+        ~GpuTaskScheduler();
+
+        GpuTaskScheduler(const GpuTaskScheduler &other)                = delete;
+        GpuTaskScheduler(GpuTaskScheduler &&other) noexcept            = delete;
+        GpuTaskScheduler &operator=(const GpuTaskScheduler &other)     = delete;
+        GpuTaskScheduler &operator=(GpuTaskScheduler &&other) noexcept = delete;
+
+        /**
+         * Queue a task. It starts on a later `pump`. Safe to call from any thread.
+         */
+        GpuTaskHandle schedule(GpuTaskDesc desc);
+
+        /**
+         * Retire finished slices and submit new ones. Completion callbacks run from here.
+         */
+        void pump();
+
+        inline void set_settings(const GpuTaskSchedulerSettings &settings) { m_Settings = settings; }
+
+        [[nodiscard]] inline const GpuTaskSchedulerSettings &settings() const { return m_Settings; }
+
+      private:
+        struct Submission {
+            std::shared_ptr<GpuTaskHandle::State> task;
+            DeviceQueue                           queue;
+            uint64_t                              timeline_value;
+            vk::raii::CommandBuffer               cmd = nullptr;
+        };
+
+        struct QueuePool {
+            vk::raii::CommandPool                pool = nullptr;
+            std::vector<vk::raii::CommandBuffer> free;
+        };
+
+        void retire();
+
+        void submit_slice(const std::shared_ptr<GpuTaskHandle::State> &task);
+
+        [[nodiscard]] vk::raii::CommandBuffer take_command_buffer(DeviceQueue queue);
+
+        std::shared_ptr<VulkanContext> m_Context;
+        GpuTaskSchedulerSettings       m_Settings;
+
+        std::mutex                                         m_Mutex;
+        std::vector<std::shared_ptr<GpuTaskHandle::State>> m_Scheduled;
+
+        // Only touched by `pump`. The pools are declared first so they outlive the command buffers in flight.
+        std::array<QueuePool, DEVICE_QUEUE_COUNT>         m_Pools;
+        std::deque<std::shared_ptr<GpuTaskHandle::State>> m_Running;
+        std::deque<Submission>                            m_InFlight;
+    };
+} // namespace engine
@@ -0,0 +1,135 @@
+#include "headless_surface.hpp"
+
+#include "engine/tools.hpp"
+
+namespace engine {
+    HeadlessSurface::HeadlessSurface(const std::shared_ptr<VulkanContext> &ctx, const vk::Extent2D extent) : m_Context(ctx), m_Extent(extent) {
+        m_ImageSize = static_cast<vk::DeviceSize>(m_Extent.width) * m_Extent.height * 4;
+
+        set_frames_in_flight(DEFAULT_FRAMES_IN_FLIGHT);
+    }
+
+    void HeadlessSurface::set_frames_in_flight(const uint32_t count) {
+        if (count == 0) {
+            throw crash(CrashReason::CriticalFailure, "A headless surface needs at least one frame in flight.");
+        }
+
+        if (count == frames_in_flight()) {
+            return;
+        }
+
+        for (const auto value : m_FrameTimelineValues) {
+            m_Context->timeline(DeviceQueue::Primary).wait(value);
+        }
+
+        // Frames which are kept keep their contents, so the last frame can still be read back unless it was removed.
+        if (m_LastSubmittedFrame.has_value() && m_LastSubmittedFrame.value() >= count) {
+            m_LastSubmittedFrame.reset();
+        }
+
+        m_Frames.reserve(count);
+        while (m_Frames.size() > count) {
+            m_Frames.pop_back();
+        }
+        while (m_Frames.size() < count) {
+            m_Frames.push_back(create_frame());
+        }
+
+        m_FrameTimelineValues.resize(count, 0);
+        m_CurrentFrame = 0;
+    }
+
+    HeadlessSurface::FrameResources HeadlessSurface::create_frame() const {
+        FrameResources frame;
+
+        frame.image = m_Context->allocator().create_image(
+            vk::ImageCreateInfo(
+                {},
+                vk::ImageType::e2D,
+                FORMAT,
+                vk::Extent3D(m_Extent, 1),
+                1,
+                1,
+                vk::SampleCountFlagBits::e1,
+                vk::ImageTiling::eOptimal,
+                vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc,
+                vk::SharingMode::eExclusive
+            ),
+            MemoryUsage::GpuOnly
+        );
+        frame.view = vk::raii::ImageView(
+            m_Context->device(),
+            vk::ImageViewCreateInfo({}, *frame.image.image, vk::ImageViewType::e2D, FORMAT, {}, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1))
+        );
+        frame.tracked.emplace(*frame.image.image, vk::ImageAspectFlagBits::eColor);
+
+        frame.readback = m_Context->allocator().create_buffer(
+            vk::BufferCreateInfo({}, m_ImageSize, vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive), MemoryUsage::Readback
+        );
+
+        return frame;
+    }
+
+    FrameInfo HeadlessSurface::begin_frame() {
+        m_Context->timeline(DeviceQueue::Primary).wait(m_FrameTimelineValues[m_CurrentFrame]);
+
+        return {.image       = *m_Frames[m_CurrentFrame].image.image,
+                .view        = *m_Frames[m_CurrentFrame].view,
+                .tracked_image = &m_Frames[m_CurrentFrame].tracked.value(),
+                .image_index = m_CurrentFrame,
+                .frame_index = m_CurrentFrame,
+                .extent      = m_Extent,
+                .format      = FORMAT,
+                .color_space = vk::ColorSpaceKHR::eSrgbNonlinear,
+                .final_state = ImageState{
+                    .layout = vk::ImageLayout::eTransferSrcOptimal,
+                    .access = vk::AccessFlagBits2::eTransferRead,
+                    .stage  = vk::PipelineStageFlagBits2::eTransfer,
+                    .owner  = VK_QUEUE_FAMILY_IGNORED,
+                },
+                .sync_info   = SyncInfo{
+                      .image_available_semaphore = m_NullSemaphore,
+                      .render_finished_semaphore = m_NullSemaphore,
+                }};
+    }
+
+    void HeadlessSurface::record_frame_end(const vk::raii::CommandBuffer &cmd, const FrameInfo &frame_info) {
+        const auto &frame = m_Frames[frame_info.frame_index];
+
+        cmd.copyImageToBuffer(
+            frame_info.image,
+            vk::ImageLayout::eTransferSrcOptimal,
+            *frame.readback.buffer,
+            vk::BufferImageCopy(0, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1), vk::Offset3D(0, 0, 0), vk::Extent3D(m_Extent, 1))
+        );
+
+        const vk::BufferMemoryBarrier2 to_host{
+            vk::PipelineStageFlagBits2::eTransfer,
+            vk::AccessFlagBits2::eTransferWrite,
+            vk::PipelineStageFlagBits2::eHost,
+            vk::AccessFlagBits2::eHostRead,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            *frame.readback.buffer,
+            0,
+            VK_WHOLE_SIZE,
+        };
+
+        cmd.pipelineBarrier2({{}, {}, to_host, {}});
+    }
+
+    void HeadlessSurface::end_frame(const FrameInfo &frame_info, const uint64_t timeline_value) {
+        m_FrameTimelineValues[frame_info.frame_index] = timeline_value;
+        m_LastSubmittedFrame                          = frame_info.frame_index;
+        m_CurrentFrame       = (m_CurrentFrame + 1) % frames_in_flight();
+    }
+
+    std::span<const std::byte> HeadlessSurface::read_back() const {
+        if (!m_LastSubmittedFrame.has_value()) {
+            return {};
+        }
+
+        m_Context->timeline(DeviceQueue::Primary).wait(m_FrameTimelineValues[m_LastSubmittedFrame.value()]);
+        return {m_Frames[m_LastSubmittedFrame.value()].readback.allocation.mapped(), m_ImageSize};
+    }
+} // namespace engine
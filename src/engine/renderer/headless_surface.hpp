@@ -0,0 +1,75 @@
+#pragma once
+
+#include <span>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "engine/renderer/render_target.hpp"
+#include "engine/renderer/vulkan_context.hpp"
+
+namespace engine {
+    /**
+     * A render target which doesn't need a window. Each frame in flight gets its own device-local image which is copied into a host visible buffer at the end of the frame, so
+     * the result of a frame can be read back on the CPU (for image diffing) once it's finished.
+     */
+    class HeadlessSurface final : public RenderTarget {
+      public:
+        static constexpr vk::Format FORMAT = vk::Format::eR8G8B8A8Srgb;
+
+        HeadlessSurface(const std::shared_ptr<VulkanContext> &ctx, vk::Extent2D extent);
+
+        HeadlessSurface(const HeadlessSurface &other)                = delete;
+        HeadlessSurface(HeadlessSurface &&other) noexcept            = default;
+        HeadlessSurface &operator=(const HeadlessSurface &other)     = delete;
+        HeadlessSurface &operator=(HeadlessSurface &&other) noexcept = default;
+
+        /**
+         * Headless images never go out of date, so this does nothing.
+         */
+        void recreate_swapchain() override {}
+
+        [[nodiscard]] inline uint32_t frames_in_flight() const override { return static_cast<uint32_t>(m_Frames.size()); }
+
+        void set_frames_in_flight(uint32_t count) override;
+
+        FrameInfo begin_frame() override;
+
+        void record_frame_end(const vk::raii::CommandBuffer &cmd, const FrameInfo &frame_info) override;
+
+        void end_frame(const FrameInfo &frame_info, uint64_t timeline_value) override;
+
+        /**
+         * Wait for the most recently submitted frame to finish and get its pixels (tightly packed rows of `FORMAT` texels). The returned span stays valid until that frame's
+         * resources are reused (`frames_in_flight()` frames later).
+         */
+        [[nodiscard]] std::span<const std::byte> read_back() const;
+
+        [[nodiscard]] inline vk::Extent2D extent() const { return m_Extent; }
+
+      private:
+        struct FrameResources {
+            AllocatedImage      image;
+            vk::raii::ImageView view = nullptr;
+            AllocatedBuffer     readback;
+
+            // Headless images aren't handed to anything outside of the renderer, so their state carries over from one use to the next.
+            std::optional<TrackedImage> tracked;
+        };
+
+        [[nodiscard]] FrameResources create_frame() const;
+
+        std::shared_ptr<VulkanContext> m_Context;
+
+        vk::Extent2D     m_Extent;
+        vk::DeviceSize   m_ImageSize;
+
+        std::vector<FrameResources> m_Frames;
+        std::vector<uint64_t>       m_FrameTimelineValues;
+
+        // Headless frames have nothing to wait on or signal for presentation, so these stay null.
+        vk::raii::Semaphore m_NullSemaphore = nullptr;
+
+        uint32_t                m_CurrentFrame = 0;
+        std::optional<uint32_t> m_LastSubmittedFrame;
+    };
+} // namespace engine
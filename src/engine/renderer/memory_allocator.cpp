@@ -0,0 +1,501 @@
+#include "memory_allocator.hpp"
+
+#include "engine/tools.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+#include <spdlog/spdlog.h>
+
+namespace engine {
+    struct Allocation::Record {
+        MemoryAllocator *allocator;
+        vk::DeviceMemory memory;
+        vk::DeviceSize   offset;
+        vk::DeviceSize   size;
+        vk::DeviceSize   alignment;
+        std::byte       *mapped;
+        uint32_t         memory_type;
+
+        // Both unset for dedicated allocations, which own their memory instead.
+        uint32_t               pool  = UINT32_MAX;
+        void                  *block = nullptr;
+        vk::raii::DeviceMemory dedicated_memory = nullptr;
+
+        void *user_data = nullptr;
+    };
+
+    static constexpr vk::DeviceSize MIN_BUDDY_BLOCK = 256;
+
+    BuddyAllocator::BuddyAllocator(const vk::DeviceSize size, const vk::DeviceSize min_block) : m_Size(size), m_MinBlock(min_block) {
+        const auto orders = static_cast<uint32_t>(std::countr_zero(size / min_block)) + 1;
+        m_Free.resize(orders);
+        m_Free.back().insert(0);
+    }
+
+    uint32_t BuddyAllocator::order_for(const vk::DeviceSize size) const {
+        const auto blocks = (std::max(size, m_MinBlock) + m_MinBlock - 1) / m_MinBlock;
+        return static_cast<uint32_t>(std::countr_zero(std::bit_ceil(blocks)));
+    }
+
+    std::optional<vk::DeviceSize> BuddyAllocator::allocate(const vk::DeviceSize size, const vk::DeviceSize alignment) {
+        // Ranges are aligned to their own size, so asking for at least `alignment` bytes takes care of alignment.
+        const uint32_t order = order_for(std::max(size, alignment));
+        if (order >= m_Free.size()) {
+            return std::nullopt;
+        }
+
+        uint32_t available = order;
+        while (available < m_Free.size() && m_Free[available].empty()) {
+            available++;
+        }
+        if (available == m_Free.size()) {
+            return std::nullopt;
+        }
+
+        const vk::DeviceSize offset = *m_Free[available].begin();
+        m_Free[available].erase(m_Free[available].begin());
+
+        // Split down to the order that was asked for, keeping the first half each time and freeing the second.
+        while (available > order) {
+            available--;
+            m_Free[available].insert(offset + order_size(available));
+        }
+
+        m_Allocated.emplace(offset, order);
+        m_Used += order_size(order);
+        return offset;
+    }
+
+    void BuddyAllocator::free(vk::DeviceSize offset) {
+        const auto it = m_Allocated.find(offset);
+        if (it == m_Allocated.end()) {
+            throw crash(CrashReason::CriticalFailure, "Freed a range which wasn't allocated from this buddy allocator.");
+        }
+
+        uint32_t order = it->second;
+        m_Allocated.erase(it);
+        m_Used -= order_size(order);
+
+        // Merge with the buddy for as long as it's free too.
+        while (order + 1 < m_Free.size()) {
+            const vk::DeviceSize buddy = offset ^ order_size(order);
+            if (m_Free[order].erase(buddy) == 0) {
+                break;
+            }
+            offset = std::min(offset, buddy);
+            order++;
+        }
+
+        m_Free[order].insert(offset);
+    }
+
+    Allocation::~Allocation() {
+        if (m_Record) {
+            m_Record->allocator->free(m_Record);
+        }
+    }
+
+    Allocation::Allocation(Allocation &&other) noexcept : m_Record(std::exchange(other.m_Record, nullptr)) {}
+
+    Allocation &Allocation::operator=(Allocation &&other) noexcept {
+        if (this != &other) {
+            if (m_Record) {
+                m_Record->allocator->free(m_Record);
+            }
+            m_Record = std::exchange(other.m_Record, nullptr);
+        }
+        return *this;
+    }
+
+    vk::DeviceMemory Allocation::memory() const {
+        return m_Record->memory;
+    }
+
+    vk::DeviceSize Allocation::offset() const {
+        return m_Record->offset;
+    }
+
+    vk::DeviceSize Allocation::size() const {
+        return m_Record->size;
+    }
+
+    std::byte *Allocation::mapped() const {
+        return m_Record->mapped;
+    }
+
+    uint32_t Allocation::memory_type() const {
+        return m_Record->memory_type;
+    }
+
+    bool Allocation::dedicated() const {
+        return m_Record->block == nullptr;
+    }
+
+    void Allocation::set_user_data(void *user_data) {
+        m_Record->user_data = user_data;
+    }
+
+    void *Allocation::user_data() const {
+        return m_Record->user_data;
+    }
+
+    MemoryAllocator::MemoryAllocator(const vk::raii::PhysicalDevice &physical_device, const vk::raii::Device &device, const bool memory_budget_supported)
+        : m_PhysicalDevice(&physical_device), m_Device(&device), m_MemoryBudgetSupported(memory_budget_supported), m_MemoryProperties(physical_device.getMemoryProperties()) {
+        m_HeapBlockBytes.resize(m_MemoryProperties.memoryHeapCount, 0);
+        m_HeapAllocatedBytes.resize(m_MemoryProperties.memoryHeapCount, 0);
+
+        m_Pools.reserve(m_MemoryProperties.memoryTypeCount * 2);
+        for (uint32_t type = 0; type < m_MemoryProperties.memoryTypeCount; type++) {
+            const vk::DeviceSize heap_size = m_MemoryProperties.memoryHeaps[heap_of(type)].size;
+
+            // 64MiB blocks on big heaps, an eighth of the heap (but at least 1MiB) on small ones.
+            vk::DeviceSize block_size = 64ull * 1024 * 1024;
+            if (heap_size < 1024ull * 1024 * 1024) {
+                block_size = std::max<vk::DeviceSize>(std::bit_floor(heap_size / 8), 1024 * 1024);
+            }
+
+            m_Pools.push_back(Pool{.memory_type = type, .block_size = block_size});
+            m_Pools.push_back(Pool{.memory_type = type, .block_size = block_size});
+        }
+    }
+
+    MemoryAllocator::~MemoryAllocator() {
+        for (const auto &pool : m_Pools) {
+            for (const auto &block : pool.blocks) {
+                if (!block->allocations.empty()) {
+                    spdlog::error("Memory allocator destroyed while {} allocations in memory type {} are still alive.", block->allocations.size(), pool.memory_type);
+                }
+            }
+        }
+    }
+
+    uint32_t MemoryAllocator::find_memory_type(const uint32_t type_bits, const MemoryUsage usage) const {
+        vk::MemoryPropertyFlags required, preferred, avoided;
+        switch (usage) {
+        case MemoryUsage::GpuOnly:
+            preferred = vk::MemoryPropertyFlagBits::eDeviceLocal;
+            avoided   = vk::MemoryPropertyFlagBits::eHostVisible;
+            break;
+        case MemoryUsage::Upload:
+            required = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+            avoided  = vk::MemoryPropertyFlagBits::eHostCached;
+            break;
+        case MemoryUsage::Readback:
+            required  = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+            preferred = vk::MemoryPropertyFlagBits::eHostCached;
+            break;
+        case MemoryUsage::Transient:
+            preferred = vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eLazilyAllocated;
+            avoided   = vk::MemoryPropertyFlagBits::eHostVisible;
+            break;
+        }
+
+        std::optional<uint32_t> best;
+        int                     best_score = 0;
+        for (uint32_t type = 0; type < m_MemoryProperties.memoryTypeCount; type++) {
+            const auto flags = m_MemoryProperties.memoryTypes[type].propertyFlags;
+            if (!(type_bits & (1u << type)) || (flags & required) != required) {
+                continue;
+            }
+
+            // Preferred properties count for more than avoided ones, so device local + host visible (BAR) memory still beats host memory for GPU only resources.
+            const int score = std::popcount(static_cast<uint32_t>(flags & preferred)) * 2 - std::popcount(static_cast<uint32_t>(flags & avoided));
+            if (!best.has_value() || score > best_score) {
+                best       = type;
+                best_score = score;
+            }
+        }
+
+        if (!best.has_value()) {
+            throw crash(CrashReason::OutOfVideoMemory, "No memory type is suitable for the requested memory.");
+        }
+
+        return best.value();
+    }
+
+    Allocation MemoryAllocator::allocate(const vk::MemoryRequirements &requirements, const MemoryUsage usage, const bool linear, const bool dedicated) {
+        const uint32_t memory_type = find_memory_type(requirements.memoryTypeBits, usage);
+
+        std::lock_guard lock(m_Mutex);
+        if (dedicated || requirements.size > m_Pools[memory_type * 2].block_size / 2) {
+            return allocate_dedicated(requirements, memory_type, nullptr, nullptr);
+        }
+        return allocate_from_pool(requirements, memory_type, linear);
+    }
+
+    AllocatedBuffer MemoryAllocator::create_buffer(const vk::BufferCreateInfo &info, const MemoryUsage usage) {
+        AllocatedBuffer result;
+        result.buffer = vk::raii::Buffer(*m_Device, info);
+
+        const auto requirements = m_Device->getBufferMemoryRequirements2<vk::MemoryRequirements2, vk::MemoryDedicatedRequirements>(vk::BufferMemoryRequirementsInfo2(*result.buffer));
+        const auto &memory_requirements    = requirements.get<vk::MemoryRequirements2>().memoryRequirements;
+        const auto &dedicated_requirements = requirements.get<vk::MemoryDedicatedRequirements>();
+
+        const uint32_t memory_type = find_memory_type(memory_requirements.memoryTypeBits, usage);
+        {
+            std::lock_guard lock(m_Mutex);
+            if (dedicated_requirements.prefersDedicatedAllocation || dedicated_requirements.requiresDedicatedAllocation ||
+                memory_requirements.size > m_Pools[memory_type * 2].block_size / 2) {
+                result.allocation = allocate_dedicated(memory_requirements, memory_type, nullptr, *result.buffer);
+            } else {
+                result.allocation = allocate_from_pool(memory_requirements, memory_type, true);
+            }
+        }
+
+        result.buffer.bindMemory(result.allocation.memory(), result.allocation.offset());
+        return result;
+    }
+
+    AllocatedImage MemoryAllocator::create_image(const vk::ImageCreateInfo &info, const MemoryUsage usage) {
+        AllocatedImage result;
+        result.image = vk::raii::Image(*m_Device, info);
+
+        const auto requirements = m_Device->getImageMemoryRequirements2<vk::MemoryRequirements2, vk::MemoryDedicatedRequirements>(vk::ImageMemoryRequirementsInfo2(*result.image));
+        const auto &memory_requirements    = requirements.get<vk::MemoryRequirements2>().memoryRequirements;
+        const auto &dedicated_requirements = requirements.get<vk::MemoryDedicatedRequirements>();
+
+        const uint32_t memory_type = find_memory_type(memory_requirements.memoryTypeBits, usage);
+        {
+            std::lock_guard lock(m_Mutex);
+            if (dedicated_requirements.prefersDedicatedAllocation || dedicated_requirements.requiresDedicatedAllocation ||
+                memory_requirements.size > m_Pools[memory_type * 2].block_size / 2) {
+                result.allocation = allocate_dedicated(memory_requirements, memory_type, *result.image, nullptr);
+            } else {
+                result.allocation = allocate_from_pool(memory_requirements, memory_type, info.tiling == vk::ImageTiling::eLinear);
+            }
+        }
+
+        result.image.bindMemory(result.allocation.memory(), result.allocation.offset());
+        return result;
+    }
+
+    Allocation MemoryAllocator::allocate_dedicated(const vk::MemoryRequirements &requirements, const uint32_t memory_type, const vk::Image image, const vk::Buffer buffer) {
+        vk::MemoryAllocateInfo          allocate_info(requirements.size, memory_type);
+        vk::MemoryDedicatedAllocateInfo dedicated_info(image, buffer);
+        if (image || buffer) {
+            allocate_info.pNext = &dedicated_info;
+        }
+
+        auto record              = std::make_unique<Allocation::Record>();
+        record->allocator        = this;
+        record->dedicated_memory = vk::raii::DeviceMemory(*m_Device, allocate_info);
+        record->memory           = *record->dedicated_memory;
+        record->offset           = 0;
+        record->size             = requirements.size;
+        record->alignment        = requirements.alignment;
+        record->memory_type      = memory_type;
+        record->mapped           = nullptr;
+        if (m_MemoryProperties.memoryTypes[memory_type].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible) {
+            record->mapped = static_cast<std::byte *>(record->dedicated_memory.mapMemory(0, VK_WHOLE_SIZE));
+        }
+
+        m_HeapBlockBytes[heap_of(memory_type)] += requirements.size;
+        m_HeapAllocatedBytes[heap_of(memory_type)] += requirements.size;
+        return Allocation(record.release());
+    }
+
+    Allocation MemoryAllocator::allocate_from_pool(const vk::MemoryRequirements &requirements, const uint32_t memory_type, const bool linear) {
+        const uint32_t pool_index = memory_type * 2 + (linear ? 1 : 0);
+        auto          &pool       = m_Pools[pool_index];
+
+        Block                        *block = nullptr;
+        std::optional<vk::DeviceSize> offset;
+        for (const auto &candidate : pool.blocks) {
+            offset = candidate->buddy.allocate(requirements.size, requirements.alignment);
+            if (offset.has_value()) {
+                block = candidate.get();
+                break;
+            }
+        }
+
+        if (!block) {
+            const uint32_t heap = heap_of(memory_type);
+            if (m_HeapBlockBytes[heap] + pool.block_size > m_MemoryProperties.memoryHeaps[heap].size) {
+                spdlog::warn("Allocating another {} byte block on memory heap {} goes over the heap's size.", pool.block_size, heap);
+            }
+
+            auto fresh    = std::make_unique<Block>(Block{.buddy = BuddyAllocator(pool.block_size, MIN_BUDDY_BLOCK)});
+            fresh->memory = vk::raii::DeviceMemory(*m_Device, vk::MemoryAllocateInfo(pool.block_size, memory_type));
+            if (m_MemoryProperties.memoryTypes[memory_type].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible) {
+                fresh->mapped = static_cast<std::byte *>(fresh->memory.mapMemory(0, VK_WHOLE_SIZE));
+            }
+
+            m_HeapBlockBytes[heap] += pool.block_size;
+            offset = fresh->buddy.allocate(requirements.size, requirements.alignment);
+            block  = fresh.get();
+            pool.blocks.push_back(std::move(fresh));
+        }
+
+        auto record         = std::make_unique<Allocation::Record>();
+        record->allocator   = this;
+        record->memory      = *block->memory;
+        record->offset      = offset.value();
+        record->size        = requirements.size;
+        record->alignment   = requirements.alignment;
+        record->mapped      = block->mapped ? block->mapped + offset.value() : nullptr;
+        record->memory_type = memory_type;
+        record->pool        = pool_index;
+        record->block       = block;
+
+        block->allocations.insert(record.get());
+        m_HeapAllocatedBytes[heap_of(memory_type)] += requirements.size;
+        return Allocation(record.release());
+    }
+
+    void MemoryAllocator::free(Allocation::Record *record) {
+        std::unique_ptr<Allocation::Record> owned(record);
+
+        std::lock_guard lock(m_Mutex);
+        const uint32_t  heap = heap_of(record->memory_type);
+        m_HeapAllocatedBytes[heap] -= record->size;
+
+        if (!record->block) {
+            m_HeapBlockBytes[heap] -= record->size;
+            return;
+        }
+
+        auto *block = static_cast<Block *>(record->block);
+        block->buddy.free(record->offset);
+        block->allocations.erase(record);
+        if (block->buddy.empty()) {
+            trim(m_Pools[record->pool]);
+        }
+    }
+
+    void MemoryAllocator::trim(Pool &pool) {
+        bool kept_one = false;
+        std::erase_if(pool.blocks, [&](const std::unique_ptr<Block> &block) {
+            if (!block->buddy.empty()) {
+                return false;
+            }
+            if (!kept_one) {
+                kept_one = true;
+                return false;
+            }
+
+            m_HeapBlockBytes[heap_of(pool.memory_type)] -= pool.block_size;
+            return true;
+        });
+    }
+
+    std::vector<HeapBudget> MemoryAllocator::budget() const {
+        std::lock_guard lock(m_Mutex);
+
+        std::vector<HeapBudget> heaps(m_MemoryProperties.memoryHeapCount);
+        for (uint32_t heap = 0; heap < heaps.size(); heap++) {
+            heaps[heap] = HeapBudget{
+                .size                  = m_MemoryProperties.memoryHeaps[heap].size,
+                .budget                = m_MemoryProperties.memoryHeaps[heap].size / 10 * 8,
+                .usage                 = m_HeapBlockBytes[heap],
+                .allocator_blocks      = m_HeapBlockBytes[heap],
+                .allocator_allocations = m_HeapAllocatedBytes[heap],
+            };
+        }
+
+        if (m_MemoryBudgetSupported) {
+            const auto properties = m_PhysicalDevice->getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+            const auto &budget    = properties.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+            for (uint32_t heap = 0; heap < heaps.size(); heap++) {
+                heaps[heap].budget = budget.heapBudget[heap];
+                heaps[heap].usage  = budget.heapUsage[heap];
+            }
+        }
+
+        return heaps;
+    }
+
+    DefragmentationPlan MemoryAllocator::plan_defragmentation(const vk::DeviceSize max_bytes) {
+        std::lock_guard lock(m_Mutex);
+
+        DefragmentationPlan plan;
+        vk::DeviceSize      planned = 0;
+
+        for (auto &pool : m_Pools) {
+            if (pool.blocks.size() < 2) {
+                continue;
+            }
+
+            // Empty the least used blocks into the most used ones.
+            std::vector<Block *> blocks;
+            for (const auto &block : pool.blocks) {
+                blocks.push_back(block.get());
+            }
+            std::ranges::sort(blocks, {}, [](const Block *block) { return block->buddy.used(); });
+
+            // A block which received something is never emptied again in the same plan.
+            std::vector<bool> targeted(blocks.size(), false);
+            for (size_t source = 0; source + 1 < blocks.size() && planned < max_bytes; source++) {
+                if (targeted[source]) {
+                    continue;
+                }
+
+                for (auto *record : blocks[source]->allocations) {
+                    if (planned >= max_bytes) {
+                        break;
+                    }
+
+                    for (size_t target = blocks.size() - 1; target > source; target--) {
+                        const auto offset = blocks[target]->buddy.allocate(record->size, record->alignment);
+                        if (!offset.has_value()) {
+                            continue;
+                        }
+
+                        targeted[target] = true;
+                        plan.m_Reservations.push_back({.record = record, .block = blocks[target], .offset = offset.value()});
+                        plan.m_Moves.push_back(DefragmentationPlan::Move{
+                            .user_data  = record->user_data,
+                            .src_memory = record->memory,
+                            .src_offset = record->offset,
+                            .dst_memory = *blocks[target]->memory,
+                            .dst_offset = offset.value(),
+                            .size       = record->size,
+                        });
+                        planned += record->size;
+                        break;
+                    }
+                }
+            }
+        }
+
+        return plan;
+    }
+
+    void MemoryAllocator::apply(DefragmentationPlan &plan) {
+        std::lock_guard lock(m_Mutex);
+
+        for (const auto &reservation : plan.m_Reservations) {
+            auto *record = reservation.record;
+            auto *source = static_cast<Block *>(record->block);
+            auto *target = static_cast<Block *>(reservation.block);
+
+            source->buddy.free(record->offset);
+            source->allocations.erase(record);
+
+            record->block  = target;
+            record->memory = *target->memory;
+            record->offset = reservation.offset;
+            record->mapped = target->mapped ? target->mapped + reservation.offset : nullptr;
+            target->allocations.insert(record);
+        }
+
+        for (auto &pool : m_Pools) {
+            trim(pool);
+        }
+
+        plan.m_Reservations.clear();
+        plan.m_Moves.clear();
+    }
+
+    void MemoryAllocator::cancel(DefragmentationPlan &plan) {
+        std::lock_guard lock(m_Mutex);
+
+        for (const auto &reservation : plan.m_Reservations) {
+            static_cast<Block *>(reservation.block)->buddy.free(reservation.offset);
+        }
+
+        plan.m_Reservations.clear();
+        plan.m_Moves.clear();
+    }
+} // namespace engine
@@ -0,0 +1,315 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace engine {
+    class MemoryAllocator;
+
+    enum class MemoryUsage {
+        /**
+         * Only ever touched by the GPU.
+         */
+        GpuOnly,
+
+        /**
+         * Written by the CPU and read by the GPU (staging buffers, per-frame constants). Always host visible and coherent.
+         */
+        Upload,
+
+        /**
+         * Written by the GPU and read by the CPU. Always host visible and coherent, cached if possible.
+         */
+        Readback,
+
+        /**
+         * Attachments whose contents never leave the GPU's tile memory (created with `eTransientAttachment`). Lazily allocated where the device has such memory (tile based
+         * GPUs), so it may never be backed by anything at all. Same as `GpuOnly` everywhere else.
+         */
+        Transient,
+    };
+
+    /**
+     * Splits power of two sized ranges in half until they're just big enough. Everything handed out is aligned to its own (power of two) size, which covers any alignment
+     * requirement up to that size. This only keeps track of offsets, it doesn't own any memory.
+     */
+    class BuddyAllocator {
+      public:
+        /**
+         * @param size Has to be `min_block` times a power of two.
+         */
+        BuddyAllocator(vk::DeviceSize size, vk::DeviceSize min_block);
+
+        [[nodiscard]] std::optional<vk::DeviceSize> allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+
+        void free(vk::DeviceSize offset);
+
+        /**
+         * Bytes handed out, including what was lost rounding sizes up.
+         */
+        [[nodiscard]] inline vk::DeviceSize used() const { return m_Used; }
+
+        [[nodiscard]] inline vk::DeviceSize size() const { return m_Size; }
+
+        [[nodiscard]] inline bool empty() const { return m_Used == 0; }
+
+      private:
+        [[nodiscard]] uint32_t order_for(vk::DeviceSize size) const;
+
+        [[nodiscard]] inline vk::DeviceSize order_size(const uint32_t order) const { return m_MinBlock << order; }
+
+        vk::DeviceSize m_Size;
+        vk::DeviceSize m_MinBlock;
+        vk::DeviceSize m_Used = 0;
+
+        // Free ranges of each order (order 0 is `m_MinBlock` bytes), ordered so buddies can be found quickly.
+        std::vector<std::set<vk::DeviceSize>> m_Free;
+
+        // The order of every range which is handed out, by offset.
+        std::unordered_map<vk::DeviceSize, uint32_t> m_Allocated;
+    };
+
+    /**
+     * A range of device memory handed out by a `MemoryAllocator`, freed again when this is destroyed. Defragmentation may move an allocation to a different place (see
+     * `MemoryAllocator::plan_defragmentation`), so don't hold on to `memory()` and `offset()` across one.
+     */
+    class Allocation {
+      public:
+        Allocation() = default;
+        ~Allocation();
+
+        Allocation(const Allocation &other) = delete;
+        Allocation(Allocation &&other) noexcept;
+        Allocation &operator=(const Allocation &other) = delete;
+        Allocation &operator=(Allocation &&other) noexcept;
+
+        [[nodiscard]] vk::DeviceMemory memory() const;
+
+        [[nodiscard]] vk::DeviceSize offset() const;
+
+        [[nodiscard]] vk::DeviceSize size() const;
+
+        /**
+         * Where the allocation is mapped, or null if its memory isn't host visible. Host visible memory stays mapped for as long as it exists.
+         */
+        [[nodiscard]] std::byte *mapped() const;
+
+        [[nodiscard]] uint32_t memory_type() const;
+
+        /**
+         * Whether the allocation has its own `vk::DeviceMemory` instead of being part of a shared block.
+         */
+        [[nodiscard]] bool dedicated() const;
+
+        /**
+         * Handed back in defragmentation moves, so the owner of an allocation can recognize it.
+         */
+        void set_user_data(void *user_data);
+
+        [[nodiscard]] void *user_data() const;
+
+        [[nodiscard]] inline explicit operator bool() const { return m_Record != nullptr; }
+
+      private:
+        friend class MemoryAllocator;
+
+        struct Record;
+
+        explicit Allocation(Record *record) : m_Record(record) {}
+
+        Record *m_Record = nullptr;
+    };
+
+    /**
+     * A buffer and the memory bound to it. The buffer is destroyed before its memory is freed.
+     */
+    struct AllocatedBuffer {
+        Allocation       allocation;
+        vk::raii::Buffer buffer = nullptr;
+    };
+
+    /**
+     * An image and the memory bound to it. The image is destroyed before its memory is freed.
+     */
+    struct AllocatedImage {
+        Allocation      allocation;
+        vk::raii::Image image = nullptr;
+    };
+
+    struct HeapBudget {
+        vk::DeviceSize size;
+
+        /**
+         * How much of the heap the engine can use without hurting the rest of the system (from `VK_EXT_memory_budget`, or an estimate without it).
+         */
+        vk::DeviceSize budget;
+
+        /**
+         * How much of the heap is in use by this process (from `VK_EXT_memory_budget`, or what this allocator allocated without it).
+         */
+        vk::DeviceSize usage;
+
+        /**
+         * Bytes of `vk::DeviceMemory` this allocator owns on the heap (blocks and dedicated allocations).
+         */
+        vk::DeviceSize allocator_blocks;
+
+        /**
+         * Bytes handed out to allocations.
+         */
+        vk::DeviceSize allocator_allocations;
+    };
+
+    /**
+     * A set of allocations which could be moved to make blocks empty, along with the new places reserved for them.
+     *
+     * To carry a plan out: for every move, create a new resource bound at the destination, copy the contents over, make sure nothing uses the old resource anymore, and then
+     * `MemoryAllocator::apply` the plan, which points the allocations at their new places and frees the blocks that became empty. Allocations which are part of a plan must not
+     * be freed until it has been applied or cancelled.
+     */
+    class DefragmentationPlan {
+      public:
+        struct Move {
+            void            *user_data;
+            vk::DeviceMemory src_memory;
+            vk::DeviceSize   src_offset;
+            vk::DeviceMemory dst_memory;
+            vk::DeviceSize   dst_offset;
+            vk::DeviceSize   size;
+        };
+
+        [[nodiscard]] inline const std::vector<Move> &moves() const { return m_Moves; }
+
+        [[nodiscard]] inline bool empty() const { return m_Moves.empty(); }
+
+      private:
+        friend class MemoryAllocator;
+
+        struct Reservation {
+            Allocation::Record *record;
+            void               *block;
+            vk::DeviceSize      offset;
+        };
+
+        std::vector<Move>        m_Moves;
+        std::vector<Reservation> m_Reservations;
+    };
+
+    /**
+     * Sub-allocates device memory. Each memory type gets a heap of fixed size blocks (with separate blocks for linear and optimal resources, so `bufferImageGranularity` never
+     * matters), and each block is split up with a `BuddyAllocator`. Big resources, and ones the driver wants to have to themselves, get dedicated allocations instead.
+     *
+     * Everything is safe to call from any thread.
+     */
+    class MemoryAllocator {
+      public:
+        MemoryAllocator(const vk::raii::PhysicalDevice &physical_device, const vk::raii::Device &device, bool memory_budget_supported);
+
+        /**
+         * Every allocation has to have been freed by now.
+         */
+        ~MemoryAllocator();
+
+        MemoryAllocator(const MemoryAllocator &other)                = delete;
+        MemoryAllocator(MemoryAllocator &&other) noexcept            = delete;
+        MemoryAllocator &operator=(const MemoryAllocator &other)     = delete;
+        MemoryAllocator &operator=(MemoryAllocator &&other) noexcept = delete;
+
+        /**
+         * @param linear Whether the memory is for a buffer or linear image (as opposed to an optimally tiled image).
+         * @param dedicated Force a dedicated allocation.
+         */
+        [[nodiscard]] Allocation allocate(const vk::MemoryRequirements &requirements, MemoryUsage usage, bool linear, bool dedicated = false);
+
+        /**
+         * Create a buffer and bind memory to it (dedicated if the driver prefers that).
+         */
+        [[nodiscard]] AllocatedBuffer create_buffer(const vk::BufferCreateInfo &info, MemoryUsage usage);
+
+        /**
+         * Create an image and bind memory to it (dedicated if it's big or the driver prefers that).
+         */
+        [[nodiscard]] AllocatedImage create_image(const vk::ImageCreateInfo &info, MemoryUsage usage);
+
+        /**
+         * The memory type out of `type_bits` which suits `usage` best.
+         *
+         * @throws crash If none of them can be used for `usage`.
+         */
+        [[nodiscard]] uint32_t find_memory_type(uint32_t type_bits, MemoryUsage usage) const;
+
+        /**
+         * Budget and usage of every memory heap.
+         */
+        [[nodiscard]] std::vector<HeapBudget> budget() const;
+
+        /**
+         * Find allocations in sparsely used blocks which fit into fuller blocks of the same kind, and reserve space for them there.
+         *
+         * @param max_bytes Stop planning once this many bytes would be moved.
+         */
+        [[nodiscard]] DefragmentationPlan plan_defragmentation(vk::DeviceSize max_bytes);
+
+        /**
+         * Move every allocation in the plan to its destination and release blocks which ended up empty.
+         */
+        void apply(DefragmentationPlan &plan);
+
+        /**
+         * Give up on a plan, releasing the space reserved for it.
+         */
+        void cancel(DefragmentationPlan &plan);
+
+      private:
+        friend class Allocation;
+
+        struct Block {
+            vk::raii::DeviceMemory memory = nullptr;
+            BuddyAllocator         buddy;
+            std::byte             *mapped = nullptr;
+
+            std::unordered_set<Allocation::Record *> allocations;
+        };
+
+        struct Pool {
+            uint32_t                            memory_type;
+            vk::DeviceSize                      block_size;
+            std::vector<std::unique_ptr<Block>> blocks;
+        };
+
+        [[nodiscard]] Allocation allocate_dedicated(const vk::MemoryRequirements &requirements, uint32_t memory_type, vk::Image image, vk::Buffer buffer);
+
+        [[nodiscard]] Allocation allocate_from_pool(const vk::MemoryRequirements &requirements, uint32_t memory_type, bool linear);
+
+        void free(Allocation::Record *record);
+
+        /**
+         * Free empty blocks in `pool`, except for one (so a pool that keeps going between empty and not doesn't keep allocating and freeing blocks).
+         */
+        void trim(Pool &pool);
+
+        [[nodiscard]] inline uint32_t heap_of(const uint32_t memory_type) const { return m_MemoryProperties.memoryTypes[memory_type].heapIndex; }
+
+        const vk::raii::PhysicalDevice *m_PhysicalDevice;
+        const vk::raii::Device         *m_Device;
+        bool                            m_MemoryBudgetSupported;
+
+        vk::PhysicalDeviceMemoryProperties m_MemoryProperties;
+
+        mutable std::mutex m_Mutex;
+
+        // Indexed by memory_type * 2 + (linear ? 1 : 0).
+        std::vector<Pool> m_Pools;
+
+        std::vector<vk::DeviceSize> m_HeapBlockBytes;
+        std::vector<vk::DeviceSize> m_HeapAllocatedBytes;
+    };
+} // namespace engine
@@ -0,0 +1,156 @@
+#include "pipeline_cache.hpp"
+
+#include "engine/tools.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <span>
+
+#include <spdlog/spdlog.h>
+
+namespace engine {
+    namespace {
+        constexpr uint32_t FILE_MAGIC   = 0x48435045; // "EPCH"
+        constexpr uint32_t FILE_VERSION = 1;
+
+        struct FileHeader {
+            uint32_t                          magic;
+            uint32_t                          version;
+            uint32_t                          vendor_id;
+            uint32_t                          device_id;
+            uint32_t                          driver_version;
+            std::array<uint8_t, VK_UUID_SIZE> device_uuid;
+            std::array<uint8_t, VK_UUID_SIZE> pipeline_cache_uuid;
+            uint64_t                          data_size;
+            uint64_t                          checksum;
+        };
+
+        // FNV-1a, only meant to catch truncated or corrupted files.
+        uint64_t checksum(const std::span<const uint8_t> data) {
+            uint64_t hash = 0xcbf29ce484222325ull;
+            for (const auto byte : data) {
+                hash = (hash ^ byte) * 0x100000001b3ull;
+            }
+            return hash;
+        }
+    } // namespace
+
+    PipelineCache::PipelineCache(const vk::raii::PhysicalDevice &physical_device, const vk::raii::Device &device, std::filesystem::path path) : m_Path(std::move(path)) {
+        const auto  properties_chain = physical_device.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>();
+        const auto &properties       = properties_chain.get<vk::PhysicalDeviceProperties2>().properties;
+
+        m_Identity.vendor_id           = properties.vendorID;
+        m_Identity.device_id           = properties.deviceID;
+        m_Identity.driver_version      = properties.driverVersion;
+        m_Identity.device_uuid         = properties_chain.get<vk::PhysicalDeviceIDProperties>().deviceUUID;
+        m_Identity.pipeline_cache_uuid = properties.pipelineCacheUUID;
+
+        const auto initial_data = load();
+        m_SavedChecksum         = initial_data.empty() ? 0 : checksum(initial_data);
+        m_Cache                 = vk::raii::PipelineCache(device, vk::PipelineCacheCreateInfo({}, initial_data.size(), initial_data.data()));
+        m_LastSaveDue           = std::chrono::steady_clock::now();
+    }
+
+    std::vector<uint8_t> PipelineCache::load() const {
+        std::ifstream file(m_Path, std::ios::binary);
+        if (!file) {
+            return {};
+        }
+
+        FileHeader header{};
+        if (!file.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+            spdlog::warn("Ignoring the pipeline cache at {} (it's truncated).", m_Path.string());
+            return {};
+        }
+
+        if (header.magic != FILE_MAGIC || header.version != FILE_VERSION) {
+            spdlog::warn("Ignoring the pipeline cache at {} (it isn't a pipeline cache, or was written by another version).", m_Path.string());
+            return {};
+        }
+
+        if (header.vendor_id != m_Identity.vendor_id || header.device_id != m_Identity.device_id || header.device_uuid != m_Identity.device_uuid ||
+            header.driver_version != m_Identity.driver_version || header.pipeline_cache_uuid != m_Identity.pipeline_cache_uuid) {
+            spdlog::info("Ignoring the pipeline cache at {} (it was made for another GPU or driver).", m_Path.string());
+            return {};
+        }
+
+        // Checked before allocating anything, so a corrupted size can't make us allocate an absurd amount of memory.
+        const auto header_end = file.tellg();
+        file.seekg(0, std::ios::end);
+        const auto file_end = file.tellg();
+        file.seekg(header_end);
+        if (!file || header.data_size != static_cast<uint64_t>(file_end - header_end)) {
+            spdlog::warn("Ignoring the pipeline cache at {} (it's corrupted).", m_Path.string());
+            return {};
+        }
+
+        std::vector<uint8_t> data(header.data_size);
+        if (!file.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size())) || checksum(data) != header.checksum) {
+            spdlog::warn("Ignoring the pipeline cache at {} (it's corrupted).", m_Path.string());
+            return {};
+        }
+
+        // The driver validates its own header too, but some drivers have been known to crash on mismatched data instead of ignoring it.
+        vk::PipelineCacheHeaderVersionOne driver_header{};
+        if (data.size() < sizeof(driver_header)) {
+            return {};
+        }
+        std::memcpy(&driver_header, data.data(), sizeof(driver_header));
+        if (driver_header.headerVersion != vk::PipelineCacheHeaderVersion::eOne || driver_header.vendorID != m_Identity.vendor_id ||
+            driver_header.deviceID != m_Identity.device_id || !std::ranges::equal(driver_header.pipelineCacheUUID, m_Identity.pipeline_cache_uuid)) {
+            return {};
+        }
+
+        spdlog::info("Loaded {} bytes of pipeline cache from {}.", data.size(), m_Path.string());
+        return data;
+    }
+
+    void PipelineCache::save() {
+        std::lock_guard lock(m_SaveMutex);
+
+        std::vector<uint8_t> data;
+        try {
+            data = m_Cache.getData();
+        } catch (const vk::SystemError &error) {
+            spdlog::warn("Couldn't read back the pipeline cache ({}).", error.what());
+            return;
+        }
+
+        const uint64_t data_checksum = checksum(data);
+        if (data.empty() || data_checksum == m_SavedChecksum) {
+            return;
+        }
+
+        const FileHeader header{
+            .magic               = FILE_MAGIC,
+            .version             = FILE_VERSION,
+            .vendor_id           = m_Identity.vendor_id,
+            .device_id           = m_Identity.device_id,
+            .driver_version      = m_Identity.driver_version,
+            .device_uuid         = m_Identity.device_uuid,
+            .pipeline_cache_uuid = m_Identity.pipeline_cache_uuid,
+            .data_size           = data.size(),
+            .checksum            = data_checksum,
+        };
+
+        const bool written = write_file_atomically(m_Path, "pipeline cache", [&](std::ostream &file) {
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+        });
+        if (written) {
+            m_SavedChecksum = data_checksum;
+        }
+    }
+
+    bool PipelineCache::save_due() {
+        std::lock_guard lock(m_TimerMutex);
+        const auto      now = std::chrono::steady_clock::now();
+        if (now - m_LastSaveDue < SAVE_INTERVAL) {
+            return false;
+        }
+
+        m_LastSaveDue = now;
+        return true;
+    }
+} // namespace engine
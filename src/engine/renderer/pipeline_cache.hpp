@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace engine {
+    /**
+     * The `vk::PipelineCache` every pipeline should be created with, kept on disk between runs so shaders the driver has already compiled don't have to be compiled again.
+     *
+     * The file starts with a header of our own recording the device (UUID, vendor, device id and driver version) and a checksum of the data, so a cache from another GPU, an
+     * older driver, or a half written file is thrown away instead of being handed to the driver. Saving writes a temporary file and renames it over the old one.
+     *
+     * Creating pipelines with the cache is safe from any thread, and so is saving.
+     */
+    class PipelineCache {
+      public:
+        /**
+         * How often `save_due` says the cache should be saved.
+         */
+        static constexpr std::chrono::seconds SAVE_INTERVAL{60};
+
+        /**
+         * Loads `path` if it's a valid cache for `physical_device`, otherwise starts empty.
+         */
+        PipelineCache(const vk::raii::PhysicalDevice &physical_device, const vk::raii::Device &device, std::filesystem::path path);
+
+        PipelineCache(const PipelineCache &other)                = delete;
+        PipelineCache(PipelineCache &&other) noexcept            = delete;
+        PipelineCache &operator=(const PipelineCache &other)     = delete;
+        PipelineCache &operator=(PipelineCache &&other) noexcept = delete;
+
+        [[nodiscard]] inline const vk::raii::PipelineCache &cache() const { return m_Cache; }
+
+        [[nodiscard]] inline vk::PipelineCache operator*() const { return *m_Cache; }
+
+        [[nodiscard]] inline const std::filesystem::path &path() const { return m_Path; }
+
+        /**
+         * Write the cache to disk if anything was added since the last save. Failing to save is only logged.
+         */
+        void save();
+
+        /**
+         * Whether `SAVE_INTERVAL` has passed since the last time this returned true (or the cache was created).
+         */
+        [[nodiscard]] bool save_due();
+
+      private:
+        struct DeviceIdentity {
+            uint32_t                          vendor_id      = 0;
+            uint32_t                          device_id      = 0;
+            uint32_t                          driver_version = 0;
+            std::array<uint8_t, VK_UUID_SIZE> device_uuid{};
+            std::array<uint8_t, VK_UUID_SIZE> pipeline_cache_uuid{};
+        };
+
+        [[nodiscard]] std::vector<uint8_t> load() const;
+
+        DeviceIdentity          m_Identity;
+        std::filesystem::path   m_Path;
+        vk::raii::PipelineCache m_Cache = nullptr;
+
+        std::mutex m_SaveMutex;
+        uint64_t   m_SavedChecksum = 0;
+
+        std::mutex                            m_TimerMutex;
+        std::chrono::steady_clock::time_point m_LastSaveDue;
+    };
+} // namespace engine
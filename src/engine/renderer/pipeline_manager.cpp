@@ -0,0 +1,380 @@
+#include "pipeline_manager.hpp"
+
+#include <spdlog/spdlog.h>
+
+namespace engine {
+    namespace {
+        // FNV-1a over everything which makes two pipelines (or two parts of one) different.
+        class Hasher {
+          public:
+            template <typename T>
+                requires std::is_trivially_copyable_v<T>
+            Hasher &add(const T &value) {
+                return add_bytes(&value, sizeof(T));
+            }
+
+            template <typename T>
+            Hasher &add(const std::vector<T> &values) {
+                add(values.size());
+                return add_bytes(values.data(), values.size() * sizeof(T));
+            }
+
+            Hasher &add(const ShaderStageDesc &stage) {
+                add(stage.spirv);
+                add(stage.entry_point.size());
+                return add_bytes(stage.entry_point.data(), stage.entry_point.size());
+            }
+
+            Hasher &add(const vk::PipelineLayout layout) { return add(static_cast<VkPipelineLayout>(layout)); }
+
+            [[nodiscard]] inline uint64_t value() const { return m_Value; }
+
+          private:
+            Hasher &add_bytes(const void *data, const size_t size) {
+                for (size_t i = 0; i < size; i++) {
+                    m_Value = (m_Value ^ static_cast<const uint8_t *>(data)[i]) * 0x100000001b3ull;
+                }
+                return *this;
+            }
+
+            uint64_t m_Value = 0xcbf29ce484222325ull;
+        };
+
+        /**
+         * The fixed function state of a graphics pipeline, filled in from its description. The create infos point at each other, so this can't be moved.
+         */
+        struct GraphicsState {
+            explicit GraphicsState(const GraphicsPipelineDesc &desc) {
+                vertex_input   = vk::PipelineVertexInputStateCreateInfo({}, desc.vertex_bindings, desc.vertex_attributes);
+                input_assembly = vk::PipelineInputAssemblyStateCreateInfo({}, desc.topology, false);
+                viewport       = vk::PipelineViewportStateCreateInfo({}, 1, nullptr, 1, nullptr);
+
+                rasterization           = vk::PipelineRasterizationStateCreateInfo({}, false, false, desc.polygon_mode, desc.cull_mode, desc.front_face);
+                rasterization.lineWidth = 1.0f;
+                multisample             = vk::PipelineMultisampleStateCreateInfo({}, desc.samples);
+                depth_stencil           = vk::PipelineDepthStencilStateCreateInfo({}, desc.depth_test, desc.depth_write, desc.depth_compare);
+
+                blend_attachments = desc.blend;
+                if (blend_attachments.empty()) {
+                    vk::PipelineColorBlendAttachmentState opaque{};
+                    opaque.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+                    blend_attachments.assign(desc.color_formats.size(), opaque);
+                }
+                color_blend = vk::PipelineColorBlendStateCreateInfo({}, false, vk::LogicOp::eCopy, blend_attachments);
+
+                dynamic   = vk::PipelineDynamicStateCreateInfo({}, dynamic_states);
+                rendering = vk::PipelineRenderingCreateInfo(0, desc.color_formats, desc.depth_format, desc.stencil_format);
+            }
+
+            GraphicsState(const GraphicsState &other)            = delete;
+            GraphicsState &operator=(const GraphicsState &other) = delete;
+
+            vk::PipelineVertexInputStateCreateInfo             vertex_input;
+            vk::PipelineInputAssemblyStateCreateInfo           input_assembly;
+            vk::PipelineViewportStateCreateInfo                viewport;
+            vk::PipelineRasterizationStateCreateInfo           rasterization;
+            vk::PipelineMultisampleStateCreateInfo             multisample;
+            vk::PipelineDepthStencilStateCreateInfo            depth_stencil;
+            std::vector<vk::PipelineColorBlendAttachmentState> blend_attachments;
+            vk::PipelineColorBlendStateCreateInfo              color_blend;
+            std::array<vk::DynamicState, 2>                    dynamic_states = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+            vk::PipelineDynamicStateCreateInfo                 dynamic;
+            vk::PipelineRenderingCreateInfo                    rendering;
+        };
+
+        /**
+         * Shader modules only have to live until the pipelines using them are created.
+         */
+        struct ShaderStages {
+            /**
+             * Does nothing if `desc` has no SPIR-V.
+             */
+            void add(const vk::raii::Device &device, const vk::ShaderStageFlagBits stage, const ShaderStageDesc &desc) {
+                if (desc.spirv.empty()) {
+                    return;
+                }
+                modules.emplace_back(device, vk::ShaderModuleCreateInfo({}, desc.spirv));
+                infos.emplace_back(vk::PipelineShaderStageCreateFlags{}, stage, *modules.back(), desc.entry_point.c_str());
+            }
+
+            std::vector<vk::raii::ShaderModule>            modules;
+            std::vector<vk::PipelineShaderStageCreateInfo> infos;
+        };
+
+        uint64_t desc_key(const GraphicsPipelineDesc &desc) {
+            return Hasher()
+                .add(desc.vertex)
+                .add(desc.fragment)
+                .add(desc.layout)
+                .add(desc.vertex_bindings)
+                .add(desc.vertex_attributes)
+                .add(desc.topology)
+                .add(desc.polygon_mode)
+                .add(desc.cull_mode)
+                .add(desc.front_face)
+                .add(desc.samples)
+                .add(desc.depth_test)
+                .add(desc.depth_write)
+                .add(desc.depth_compare)
+                .add(desc.color_formats)
+                .add(desc.blend)
+                .add(desc.depth_format)
+                .add(desc.stencil_format)
+                .value();
+        }
+
+        uint64_t desc_key(const ComputePipelineDesc &desc) {
+            // Salted so a compute pipeline can never collide with a graphics pipeline made from the same bytes.
+            return Hasher().add(uint32_t{0xc0de}).add(desc.shader).add(desc.layout).value();
+        }
+    } // namespace
+
+    PipelineHandle::Entry::~Entry() {
+        if (*pipeline) {
+            retire(std::move(pipeline));
+        }
+    }
+
+    void PipelineHandle::Entry::retire(vk::raii::Pipeline &&old) const {
+        // Frames only reuse their resources once the frame which used them before has finished, so once `frames_in_flight` more frames than the one being recorded have
+        // ended, the last frame which could have bound the pipeline is done with it.
+        context->retire(std::move(old), DeviceQueue::Primary, frames_in_flight->load(std::memory_order_relaxed) + 1);
+    }
+
+    PipelineStatus PipelineHandle::status() const {
+        return m_Entry ? m_Entry->status.load(std::memory_order_acquire) : PipelineStatus::Failed;
+    }
+
+    vk::Pipeline PipelineHandle::get() const {
+        for (const Entry *entry = m_Entry.get(); entry; entry = entry->fallback.get()) {
+            if (const VkPipeline pipeline = entry->current.load(std::memory_order_acquire)) {
+                return pipeline;
+            }
+        }
+        return nullptr;
+    }
+
+    PipelineManager::PipelineManager(const std::shared_ptr<VulkanContext> &ctx, JobSystem &jobs, const uint32_t frames_in_flight)
+        : m_Context(ctx), m_Jobs(jobs), m_UseLibraries(ctx->capabilities().graphics_pipeline_library),
+          m_FramesInFlight(std::make_shared<std::atomic<uint32_t>>(frames_in_flight)) {
+        if (m_UseLibraries) {
+            const auto properties = ctx->physical_device().getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceGraphicsPipelineLibraryPropertiesEXT>();
+            if (!properties.get<vk::PhysicalDeviceGraphicsPipelineLibraryPropertiesEXT>().graphicsPipelineLibraryFastLinking) {
+                spdlog::info("Graphics pipeline libraries don't support fast linking on this device, the first link of a pipeline may take a while.");
+            }
+        }
+    }
+
+    PipelineManager::~PipelineManager() {
+        try {
+            m_Jobs.wait(m_Compiles);
+        } catch (const std::exception &error) {
+            spdlog::error("A pipeline compile failed while shutting down: {}", error.what());
+        }
+
+        for (auto &[key, library] : m_Libraries) {
+            if (*library->pipeline) {
+                m_Context->retire(std::move(library->pipeline));
+            }
+        }
+    }
+
+    PipelineHandle PipelineManager::request(const GraphicsPipelineDesc &desc, const PipelineHandle &fallback) {
+        return request(desc_key(desc), desc, fallback);
+    }
+
+    PipelineHandle PipelineManager::request(const ComputePipelineDesc &desc, const PipelineHandle &fallback) {
+        return request(desc_key(desc), desc, fallback);
+    }
+
+    PipelineHandle PipelineManager::request(const uint64_t key, std::variant<GraphicsPipelineDesc, ComputePipelineDesc> desc, const PipelineHandle &fallback) {
+        std::shared_ptr<Entry> entry;
+        {
+            std::lock_guard lock(m_Mutex);
+            const auto      it = m_Entries.find(key);
+            if (it != m_Entries.end() && it->second->desc == desc) {
+                return PipelineHandle(it->second);
+            }
+
+            entry                   = std::make_shared<Entry>();
+            entry->context          = m_Context;
+            entry->frames_in_flight = m_FramesInFlight;
+            entry->desc             = std::move(desc);
+            entry->fallback         = fallback.m_Entry;
+
+            // A hash collision just means the other pipeline isn't deduplicated anymore.
+            m_Entries[key] = entry;
+        }
+
+        m_Pending.fetch_add(1, std::memory_order_relaxed);
+        m_Jobs.schedule("compile_pipeline", [this, entry] { compile(entry); }, m_Compiles);
+        return PipelineHandle(entry);
+    }
+
+    void PipelineManager::compile(const std::shared_ptr<Entry> &entry) {
+        const auto &device = m_Context->device();
+        const auto &cache  = m_Context->pipeline_cache().cache();
+
+        try {
+            if (const auto *compute = std::get_if<ComputePipelineDesc>(&entry->desc)) {
+                ShaderStages stages;
+                stages.add(device, vk::ShaderStageFlagBits::eCompute, compute->shader);
+                publish(*entry, vk::raii::Pipeline(device, cache, vk::ComputePipelineCreateInfo({}, stages.infos.at(0), compute->layout)), PipelineStatus::Optimized);
+            } else if (const auto &graphics = std::get<GraphicsPipelineDesc>(entry->desc); m_UseLibraries) {
+                const std::array libraries = {
+                    library(LibraryPart::VertexInput, graphics),
+                    library(LibraryPart::PreRasterization, graphics),
+                    library(LibraryPart::FragmentShader, graphics),
+                    library(LibraryPart::FragmentOutput, graphics),
+                };
+                publish(*entry, link(libraries, graphics.layout, false), PipelineStatus::Fast);
+
+                // Linking with optimization is a full compile, so it gets its own job rather than holding up other pipelines' fast links.
+                m_Jobs.schedule(
+                    "optimize_pipeline",
+                    [this, entry, libraries, layout = graphics.layout] {
+                        try {
+                            publish(*entry, link(libraries, layout, true), PipelineStatus::Optimized);
+                        } catch (const std::exception &error) {
+                            // The fast linked pipeline still works, so this is only worth a warning.
+                            spdlog::warn("Couldn't optimize a pipeline: {}", error.what());
+                        }
+                    },
+                    m_Compiles
+                );
+            } else {
+                GraphicsState state(graphics);
+                ShaderStages  stages;
+                stages.add(device, vk::ShaderStageFlagBits::eVertex, graphics.vertex);
+                stages.add(device, vk::ShaderStageFlagBits::eFragment, graphics.fragment);
+
+                vk::GraphicsPipelineCreateInfo info{};
+                info.pNext               = &state.rendering;
+                info.setStages(stages.infos);
+                info.pVertexInputState   = &state.vertex_input;
+                info.pInputAssemblyState = &state.input_assembly;
+                info.pViewportState      = &state.viewport;
+                info.pRasterizationState = &state.rasterization;
+                info.pMultisampleState   = &state.multisample;
+                info.pDepthStencilState  = &state.depth_stencil;
+                info.pColorBlendState    = &state.color_blend;
+                info.pDynamicState       = &state.dynamic;
+                info.layout              = graphics.layout;
+
+                publish(*entry, vk::raii::Pipeline(device, cache, info), PipelineStatus::Optimized);
+            }
+        } catch (const std::exception &error) {
+            spdlog::error("Couldn't compile a pipeline: {}", error.what());
+            entry->status.store(PipelineStatus::Failed, std::memory_order_release);
+        }
+
+        m_Pending.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    vk::Pipeline PipelineManager::library(const LibraryPart part, const GraphicsPipelineDesc &desc) {
+        Hasher hasher;
+        hasher.add(part);
+        switch (part) {
+        case LibraryPart::VertexInput:
+            hasher.add(desc.vertex_bindings).add(desc.vertex_attributes).add(desc.topology);
+            break;
+        case LibraryPart::PreRasterization:
+            hasher.add(desc.vertex).add(desc.layout).add(desc.polygon_mode).add(desc.cull_mode).add(desc.front_face);
+            break;
+        case LibraryPart::FragmentShader:
+            hasher.add(desc.fragment).add(desc.layout).add(desc.samples).add(desc.depth_test).add(desc.depth_write).add(desc.depth_compare);
+            break;
+        case LibraryPart::FragmentOutput:
+            hasher.add(desc.samples).add(desc.color_formats).add(desc.blend).add(desc.depth_format).add(desc.stencil_format);
+            break;
+        }
+
+        std::shared_ptr<Library> library;
+        {
+            std::lock_guard lock(m_Mutex);
+            auto           &slot = m_Libraries[hasher.value()];
+            if (!slot) {
+                slot = std::make_shared<Library>();
+            }
+            library = slot;
+        }
+
+        // Whoever gets here first compiles the library, anyone else asking for it in the meantime waits for them instead of compiling it again. If compiling throws, the
+        // next caller tries again.
+        std::call_once(library->once, [&] {
+            const auto &device = m_Context->device();
+
+            GraphicsState state(desc);
+            ShaderStages  stages;
+            if (part == LibraryPart::PreRasterization) {
+                stages.add(device, vk::ShaderStageFlagBits::eVertex, desc.vertex);
+            } else if (part == LibraryPart::FragmentShader) {
+                stages.add(device, vk::ShaderStageFlagBits::eFragment, desc.fragment);
+            }
+
+            vk::GraphicsPipelineLibraryCreateInfoEXT library_info{};
+            library_info.pNext = &state.rendering;
+
+            vk::GraphicsPipelineCreateInfo info{};
+            info.pNext = &library_info;
+            info.flags = vk::PipelineCreateFlagBits::eLibraryKHR | vk::PipelineCreateFlagBits::eRetainLinkTimeOptimizationInfoEXT;
+            info.setStages(stages.infos);
+
+            switch (part) {
+            case LibraryPart::VertexInput:
+                library_info.flags       = vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface;
+                info.pVertexInputState   = &state.vertex_input;
+                info.pInputAssemblyState = &state.input_assembly;
+                break;
+            case LibraryPart::PreRasterization:
+                library_info.flags       = vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders;
+                info.pViewportState      = &state.viewport;
+                info.pRasterizationState = &state.rasterization;
+                info.pDynamicState       = &state.dynamic;
+                info.layout              = desc.layout;
+                break;
+            case LibraryPart::FragmentShader:
+                library_info.flags      = vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader;
+                info.pMultisampleState  = &state.multisample;
+                info.pDepthStencilState = &state.depth_stencil;
+                info.layout             = desc.layout;
+                break;
+            case LibraryPart::FragmentOutput:
+                library_info.flags     = vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface;
+                info.pMultisampleState = &state.multisample;
+                info.pColorBlendState  = &state.color_blend;
+                break;
+            }
+
+            library->pipeline = vk::raii::Pipeline(device, m_Context->pipeline_cache().cache(), info);
+        });
+
+        return *library->pipeline;
+    }
+
+    vk::raii::Pipeline PipelineManager::link(const std::array<vk::Pipeline, 4> &libraries, const vk::PipelineLayout layout, const bool optimize) const {
+        const vk::PipelineLibraryCreateInfoKHR library_info(libraries);
+
+        vk::GraphicsPipelineCreateInfo info{};
+        info.pNext  = &library_info;
+        info.layout = layout;
+        if (optimize) {
+            info.flags = vk::PipelineCreateFlagBits::eLinkTimeOptimizationEXT;
+        }
+
+        return vk::raii::Pipeline(m_Context->device(), m_Context->pipeline_cache().cache(), info);
+    }
+
+    void PipelineManager::publish(Entry &entry, vk::raii::Pipeline pipeline, const PipelineStatus status) const {
+        std::lock_guard lock(entry.mutex);
+
+        // The pipeline being replaced may still be bound in frames which haven't finished (or are being recorded right now).
+        if (*entry.pipeline) {
+            entry.retire(std::move(entry.pipeline));
+        }
+
+        entry.pipeline = std::move(pipeline);
+        entry.current.store(static_cast<VkPipeline>(*entry.pipeline), std::memory_order_release);
+        entry.status.store(status, std::memory_order_release);
+    }
+} // namespace engine
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "engine/job_system.hpp"
+#include "engine/renderer/vulkan_context.hpp"
+
+namespace engine {
+    struct ShaderStageDesc {
+        std::vector<uint32_t> spirv;
+        std::string           entry_point = "main";
+
+        bool operator==(const ShaderStageDesc &other) const = default;
+    };
+
+    /**
+     * Everything a graphics pipeline is made from. Viewport and scissor are always dynamic, and pipelines are always made for dynamic rendering.
+     */
+    struct GraphicsPipelineDesc {
+        ShaderStageDesc vertex;
+
+        /**
+         * Leave the SPIR-V empty for depth only pipelines.
+         */
+        ShaderStageDesc fragment;
+
+        vk::PipelineLayout layout;
+
+        std::vector<vk::VertexInputBindingDescription>   vertex_bindings;
+        std::vector<vk::VertexInputAttributeDescription> vertex_attributes;
+        vk::PrimitiveTopology                            topology = vk::PrimitiveTopology::eTriangleList;
+
+        vk::PolygonMode         polygon_mode = vk::PolygonMode::eFill;
+        vk::CullModeFlags       cull_mode    = vk::CullModeFlagBits::eBack;
+        vk::FrontFace           front_face   = vk::FrontFace::eCounterClockwise;
+        vk::SampleCountFlagBits samples      = vk::SampleCountFlagBits::e1;
+
+        bool          depth_test    = false;
+        bool          depth_write   = false;
+        vk::CompareOp depth_compare = vk::CompareOp::eLessOrEqual;
+
+        std::vector<vk::Format> color_formats;
+
+        /**
+         * One per color format, or empty to write every color attachment without blending.
+         */
+        std::vector<vk::PipelineColorBlendAttachmentState> blend;
+
+        vk::Format depth_format   = vk::Format::eUndefined;
+        vk::Format stencil_format = vk::Format::eUndefined;
+
+        bool operator==(const GraphicsPipelineDesc &other) const = default;
+    };
+
+    struct ComputePipelineDesc {
+        ShaderStageDesc    shader;
+        vk::PipelineLayout layout;
+
+        bool operator==(const ComputePipelineDesc &other) const = default;
+    };
+
+    enum class PipelineStatus {
+        /**
+         * Still compiling, the fallback (if any) is used in the meantime.
+         */
+        Pending,
+
+        /**
+         * Usable, but linked without link time optimization. The optimized pipeline replaces it once it's done.
+         */
+        Fast,
+
+        Optimized,
+
+        /**
+         * Compiling failed (the error was logged). The fallback keeps being used.
+         */
+        Failed,
+    };
+
+    /**
+     * A pipeline which may still be compiling. Fetch the pipeline with `get` every time it's bound rather than holding on to it, since it changes once compiling finishes.
+     */
+    class PipelineHandle {
+        struct Entry;
+
+      public:
+        PipelineHandle() = default;
+
+        [[nodiscard]] PipelineStatus status() const;
+
+        /**
+         * Whether `get` returns this pipeline itself (as opposed to a fallback).
+         */
+        [[nodiscard]] inline bool ready() const { return status() == PipelineStatus::Fast || status() == PipelineStatus::Optimized; }
+
+        /**
+         * The best pipeline available right now: this one if it's ready, otherwise its fallback's `get`. Null if neither is ready, in which case whatever uses the pipeline
+         * should be skipped this frame.
+         */
+        [[nodiscard]] vk::Pipeline get() const;
+
+        [[nodiscard]] inline explicit operator bool() const { return static_cast<bool>(m_Entry); }
+
+      private:
+        friend class PipelineManager;
+
+        explicit PipelineHandle(std::shared_ptr<Entry> entry) : m_Entry(std::move(entry)) {}
+
+        struct Entry {
+            std::shared_ptr<VulkanContext>                          context;
+            std::shared_ptr<const std::atomic<uint32_t>>            frames_in_flight;
+            std::variant<GraphicsPipelineDesc, ComputePipelineDesc> desc;
+            std::shared_ptr<Entry>                                  fallback;
+
+            std::atomic<VkPipeline>     current = VK_NULL_HANDLE;
+            std::atomic<PipelineStatus> status  = PipelineStatus::Pending;
+
+            std::mutex         mutex;
+            vk::raii::Pipeline pipeline = nullptr;
+
+            ~Entry();
+
+            /**
+             * Destroy a pipeline which may be bound in frames which haven't finished, including the one being recorded right now.
+             */
+            void retire(vk::raii::Pipeline &&old) const;
+        };
+
+        std::shared_ptr<Entry> m_Entry;
+    };
+
+    /**
+     * Compiles pipelines on the job system so nothing ever waits on the driver's shader compiler in the middle of a frame. Every pipeline is created with the context's
+     * pipeline cache.
+     *
+     * With `VK_EXT_graphics_pipeline_library`, graphics pipelines are built from four libraries (vertex input, pre-rasterization shaders, fragment shader and fragment output).
+     * Libraries are shared by every pipeline with the same state for that part, so a new material usually only compiles one or two of them. Once they exist the pipeline is
+     * quickly linked without optimization (so it's usable right away), and an optimized pipeline is linked in the background to replace it.
+     *
+     * Without it pipelines are compiled whole, and the fallback passed to `request` is used until they're done.
+     */
+    class PipelineManager {
+      public:
+        /**
+         * @param frames_in_flight How many frames may be in flight, which is how long a replaced pipeline has to be kept around for.
+         */
+        PipelineManager(const std::shared_ptr<VulkanContext> &ctx, JobSystem &jobs, uint32_t frames_in_flight);
+
+        /**
+         * Waits for every compile which is still running.
+         */
+        ~PipelineManager();
+
+        PipelineManager(const PipelineManager &other)                = delete;
+        PipelineManager(PipelineManager &&other) noexcept            = delete;
+        PipelineManager &operator=(const PipelineManager &other)     = delete;
+        PipelineManager &operator=(PipelineManager &&other) noexcept = delete;
+
+        /**
+         * Start compiling a pipeline. Requesting a pipeline which was requested before returns the same handle (with the fallback it was first requested with).
+         *
+         * @param fallback What `PipelineHandle::get` returns until the pipeline is ready (usually a simple pipeline that was compiled up front).
+         */
+        PipelineHandle request(const GraphicsPipelineDesc &desc, const PipelineHandle &fallback = {});
+
+        PipelineHandle request(const ComputePipelineDesc &desc, const PipelineHandle &fallback = {});
+
+        /**
+         * Has to be kept up to date with the render target's.
+         */
+        inline void set_frames_in_flight(const uint32_t count) { m_FramesInFlight->store(count, std::memory_order_relaxed); }
+
+        /**
+         * Whether graphics pipelines are built from pipeline libraries.
+         */
+        [[nodiscard]] inline bool uses_libraries() const { return m_UseLibraries; }
+
+        /**
+         * How many pipelines are still compiling (or waiting to).
+         */
+        [[nodiscard]] inline uint32_t pending() const { return m_Pending.load(std::memory_order_relaxed); }
+
+      private:
+        enum class LibraryPart {
+            VertexInput,
+            PreRasterization,
+            FragmentShader,
+            FragmentOutput,
+        };
+
+        struct Library {
+            std::once_flag     once;
+            vk::raii::Pipeline pipeline = nullptr;
+        };
+
+        using Entry = PipelineHandle::Entry;
+
+        PipelineHandle request(uint64_t key, std::variant<GraphicsPipelineDesc, ComputePipelineDesc> desc, const PipelineHandle &fallback);
+
+        void compile(const std::shared_ptr<Entry> &entry);
+
+        /**
+         * Get the library for `part` of `desc`, compiling it if nobody has yet (or waiting for whoever is).
+         */
+        [[nodiscard]] vk::Pipeline library(LibraryPart part, const GraphicsPipelineDesc &desc);
+
+        [[nodiscard]] vk::raii::Pipeline link(const std::array<vk::Pipeline, 4> &libraries, vk::PipelineLayout layout, bool optimize) const;
+
+        void publish(Entry &entry, vk::raii::Pipeline pipeline, PipelineStatus status) const;
+
+        std::shared_ptr<VulkanContext> m_Context;
+        JobSystem                     &m_Jobs;
+        bool                           m_UseLibraries;
+
+        // Shared with every entry, since entries (and their pipelines) can outlive the manager.
+        std::shared_ptr<std::atomic<uint32_t>> m_FramesInFlight;
+
+        std::mutex                                             m_Mutex;
+        std::unordered_map<uint64_t, std::shared_ptr<Entry>>   m_Entries;
+        std::unordered_map<uint64_t, std::shared_ptr<Library>> m_Libraries;
+
+        // Every compile job is added to this, so the destructor can wait for them.
+        JobCounterHandle      m_Compiles = std::make_shared<JobCounter>();
+        std::atomic<uint32_t> m_Pending  = 0;
+    };
+} // namespace engine
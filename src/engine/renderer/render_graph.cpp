@@ -0,0 +1,1119 @@
+#include "render_graph.hpp"
+
+#include "engine/engine_context.hpp"
+#include "engine/renderer/tracked_image.hpp"
+#include "engine/tools.hpp"
+
+#include <algorithm>
+
+namespace engine {
+    static bool lifetimes_overlap(const uint32_t first_a, const uint32_t last_a, const uint32_t first_b, const uint32_t last_b) {
+        return first_a <= last_b && first_b <= last_a;
+    }
+
+    static constexpr vk::ImageUsageFlags ATTACHMENT_USAGE_FLAGS = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eDepthStencilAttachment |
+                                                                  vk::ImageUsageFlagBits::eInputAttachment | vk::ImageUsageFlagBits::eTransientAttachment;
+
+    static vk::ImageLayout attachment_layout(const bool depth, const bool read_only) {
+        if (!depth) {
+            return vk::ImageLayout::eColorAttachmentOptimal;
+        }
+        return read_only ? vk::ImageLayout::eDepthStencilReadOnlyOptimal : vk::ImageLayout::eDepthStencilAttachmentOptimal;
+    }
+
+    static vk::AttachmentLoadOp load_op(const AttachmentLoad load) {
+        switch (load) {
+        case AttachmentLoad::Clear:
+            return vk::AttachmentLoadOp::eClear;
+        case AttachmentLoad::DontCare:
+            return vk::AttachmentLoadOp::eDontCare;
+        default:
+            return vk::AttachmentLoadOp::eLoad;
+        }
+    }
+
+    RenderGraphResourcePool::RenderGraphResourcePool(const std::shared_ptr<VulkanContext> &ctx) : m_Context(ctx) {}
+
+    vk::DeviceSize RenderGraphResourcePool::memory_size() const {
+        vk::DeviceSize total = 0;
+        for (const auto size : m_BlockSizes) {
+            total += size;
+        }
+        return total;
+    }
+
+    void RenderGraphResourcePool::realize(const std::vector<ImageRequest> &images, const std::vector<BufferRequest> &buffers) {
+        if (images == m_ImageRequests && buffers == m_BufferRequests) {
+            return;
+        }
+
+        m_ImageViews.clear();
+        m_Images.clear();
+        m_Buffers.clear();
+        m_Blocks.clear();
+        m_BlockSizes.clear();
+        m_ImageAliases.assign(images.size(), {});
+        m_BufferAliases.assign(buffers.size(), {});
+
+        m_ImageRequests  = images;
+        m_BufferRequests = buffers;
+
+        const auto &device = m_Context->device();
+
+        struct Item {
+            bool                   is_image;
+            uint32_t               index;
+            vk::MemoryRequirements requirements;
+            uint32_t               memory_type;
+            uint32_t               first_level;
+            uint32_t               last_level;
+
+            uint32_t       block  = 0;
+            vk::DeviceSize offset = 0;
+        };
+
+        std::vector<Item> items;
+        items.reserve(images.size() + buffers.size());
+
+        m_Images.reserve(images.size());
+        for (uint32_t i = 0; i < images.size(); i++) {
+            const auto &desc = images[i].desc;
+            m_Images.emplace_back(
+                device,
+                vk::ImageCreateInfo(
+                    {},
+                    vk::ImageType::e2D,
+                    desc.format,
+                    vk::Extent3D(desc.extent, 1),
+                    desc.mip_levels,
+                    desc.array_layers,
+                    desc.samples,
+                    vk::ImageTiling::eOptimal,
+                    desc.usage,
+                    vk::SharingMode::eExclusive
+                )
+            );
+
+            const auto requirements = m_Images.back().getMemoryRequirements();
+            const auto usage        = desc.usage & vk::ImageUsageFlagBits::eTransientAttachment ? MemoryUsage::Transient : MemoryUsage::GpuOnly;
+            items.push_back(Item{
+                .is_image     = true,
+                .index        = i,
+                .requirements = requirements,
+                .memory_type  = m_Context->allocator().find_memory_type(requirements.memoryTypeBits, usage),
+                .first_level  = images[i].first_level,
+                .last_level   = images[i].last_level,
+            });
+        }
+
+        m_Buffers.reserve(buffers.size());
+        for (uint32_t i = 0; i < buffers.size(); i++) {
+            m_Buffers.emplace_back(device, vk::BufferCreateInfo({}, buffers[i].desc.size, buffers[i].desc.usage, vk::SharingMode::eExclusive));
+
+            const auto requirements = m_Buffers.back().getMemoryRequirements();
+            items.push_back(Item{
+                .is_image     = false,
+                .index        = i,
+                .requirements = requirements,
+                .memory_type  = m_Context->allocator().find_memory_type(requirements.memoryTypeBits, MemoryUsage::GpuOnly),
+                .first_level  = buffers[i].first_level,
+                .last_level   = buffers[i].last_level,
+            });
+        }
+
+        // Place the biggest resources first so each block is sized by the first (largest) resource placed into it.
+        std::ranges::stable_sort(items, std::ranges::greater{}, [](const Item &item) { return item.requirements.size; });
+
+        struct Block {
+            bool                  images;
+            uint32_t              memory_type;
+            vk::DeviceSize        size;
+            vk::DeviceSize        alignment;
+            std::vector<uint32_t> items;
+        };
+
+        std::vector<Block> blocks;
+
+        const auto fits_at = [&](const Block &block, const Item &item, const vk::DeviceSize offset) {
+            if (offset + item.requirements.size > block.size) {
+                return false;
+            }
+
+            return std::ranges::none_of(block.items, [&](const uint32_t other_index) {
+                const auto &other = items[other_index];
+                return lifetimes_overlap(item.first_level, item.last_level, other.first_level, other.last_level) && offset < other.offset + other.requirements.size &&
+                       other.offset < offset + item.requirements.size;
+            });
+        };
+
+        for (uint32_t i = 0; i < items.size(); i++) {
+            auto &item = items[i];
+
+            bool placed = false;
+            for (uint32_t b = 0; b < blocks.size() && !placed; b++) {
+                auto &block = blocks[b];
+                // Images and buffers never share a block so we don't have to care about bufferImageGranularity.
+                if (block.images != item.is_image || block.memory_type != item.memory_type) {
+                    continue;
+                }
+
+                std::vector<vk::DeviceSize> candidates = {0};
+                for (const auto other_index : block.items) {
+                    const auto &other     = items[other_index];
+                    const auto  alignment = item.requirements.alignment;
+                    candidates.push_back((other.offset + other.requirements.size + alignment - 1) / alignment * alignment);
+                }
+                std::ranges::sort(candidates);
+
+                for (const auto offset : candidates) {
+                    if (fits_at(block, item, offset)) {
+                        item.block  = b;
+                        item.offset = offset;
+                        block.items.push_back(i);
+                        block.alignment = std::max(block.alignment, item.requirements.alignment);
+                        placed          = true;
+                        break;
+                    }
+                }
+            }
+
+            if (!placed) {
+                item.block  = static_cast<uint32_t>(blocks.size());
+                item.offset = 0;
+                blocks.push_back(Block{
+                    .images      = item.is_image,
+                    .memory_type = item.memory_type,
+                    .size        = item.requirements.size,
+                    .alignment   = item.requirements.alignment,
+                    .items       = {i},
+                });
+            }
+        }
+
+        m_Blocks.reserve(blocks.size());
+        // Each aliasing block is a single allocation, resources are placed at offsets inside of it.
+        for (const auto &block : blocks) {
+            m_Blocks.push_back(m_Context->allocator().allocate(vk::MemoryRequirements(block.size, block.alignment, 1u << block.memory_type), MemoryUsage::GpuOnly, !block.images));
+            m_BlockSizes.push_back(block.size);
+        }
+
+        for (const auto &block : blocks) {
+            for (const auto item_index : block.items) {
+                const auto &item = items[item_index];
+                if (item.is_image) {
+                    m_Images[item.index].bindMemory(m_Blocks[item.block].memory(), m_Blocks[item.block].offset() + item.offset);
+                } else {
+                    m_Buffers[item.index].bindMemory(m_Blocks[item.block].memory(), m_Blocks[item.block].offset() + item.offset);
+                }
+
+                auto &aliases = item.is_image ? m_ImageAliases[item.index] : m_BufferAliases[item.index];
+                for (const auto other_index : block.items) {
+                    const auto &other = items[other_index];
+                    if (other.last_level < item.first_level && item.offset < other.offset + other.requirements.size && other.offset < item.offset + item.requirements.size) {
+                        aliases.push_back(other.index);
+                    }
+                }
+            }
+        }
+
+        m_ImageViews.reserve(images.size());
+        for (uint32_t i = 0; i < images.size(); i++) {
+            const auto &desc = images[i].desc;
+            m_ImageViews.emplace_back(
+                device,
+                vk::ImageViewCreateInfo(
+                    {},
+                    *m_Images[i],
+                    desc.array_layers > 1 ? vk::ImageViewType::e2DArray : vk::ImageViewType::e2D,
+                    desc.format,
+                    {},
+                    vk::ImageSubresourceRange(desc.aspect, 0, desc.mip_levels, 0, desc.array_layers)
+                )
+            );
+        }
+    }
+
+    RenderGraphImage RenderGraphPassBuilder::read(const RenderGraphImage image, const ImageState &usage) {
+        m_Graph.check_image(image);
+        m_Graph.add_access(m_Pass, m_Graph.m_Passes[m_Pass].images, image.index, AccessKind::Read, usage);
+        return image;
+    }
+
+    RenderGraphImage RenderGraphPassBuilder::write(const RenderGraphImage image, const ImageState &usage) {
+        m_Graph.check_image(image);
+        m_Graph.add_access(m_Pass, m_Graph.m_Passes[m_Pass].images, image.index, AccessKind::Write, usage);
+        return image;
+    }
+
+    RenderGraphImage RenderGraphPassBuilder::modify(const RenderGraphImage image, const ImageState &usage) {
+        m_Graph.check_image(image);
+        m_Graph.add_access(m_Pass, m_Graph.m_Passes[m_Pass].images, image.index, AccessKind::Modify, usage);
+        return image;
+    }
+
+    RenderGraphBuffer RenderGraphPassBuilder::read(const RenderGraphBuffer buffer, const BufferState &usage) {
+        m_Graph.check_buffer(buffer);
+        m_Graph.add_access(m_Pass, m_Graph.m_Passes[m_Pass].buffers, buffer.index, AccessKind::Read, ImageState{.access = usage.access, .stage = usage.stage});
+        return buffer;
+    }
+
+    RenderGraphBuffer RenderGraphPassBuilder::write(const RenderGraphBuffer buffer, const BufferState &usage) {
+        m_Graph.check_buffer(buffer);
+        m_Graph.add_access(m_Pass, m_Graph.m_Passes[m_Pass].buffers, buffer.index, AccessKind::Write, ImageState{.access = usage.access, .stage = usage.stage});
+        return buffer;
+    }
+
+    RenderGraphBuffer RenderGraphPassBuilder::modify(const RenderGraphBuffer buffer, const BufferState &usage) {
+        m_Graph.check_buffer(buffer);
+        m_Graph.add_access(m_Pass, m_Graph.m_Passes[m_Pass].buffers, buffer.index, AccessKind::Modify, ImageState{.access = usage.access, .stage = usage.stage});
+        return buffer;
+    }
+
+    RenderGraphImage RenderGraphPassBuilder::color_attachment(const RenderGraphImage image, const AttachmentLoad load, const vk::ClearColorValue &clear) {
+        m_Graph.check_image(image);
+
+        // Clearing counts as a write, so whatever was in the image before can be discarded by the transition.
+        const bool loads = load == AttachmentLoad::Load;
+        m_Graph.add_access(
+            m_Pass,
+            m_Graph.m_Passes[m_Pass].images,
+            image.index,
+            loads ? AccessKind::Modify : AccessKind::Write,
+            ImageState{
+                .layout = attachment_layout(false, false),
+                .access = loads ? vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite : vk::AccessFlagBits2::eColorAttachmentWrite,
+                .stage  = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+                .owner  = VK_QUEUE_FAMILY_IGNORED,
+            }
+        );
+        m_Graph.add_attachment(m_Pass, RenderGraph::Attachment{.image = image.index, .depth = false, .read_only = false, .load = load, .clear = clear});
+        return image;
+    }
+
+    RenderGraphImage RenderGraphPassBuilder::depth_attachment(const RenderGraphImage image, AttachmentLoad load, const vk::ClearDepthStencilValue &clear, const bool read_only) {
+        m_Graph.check_image(image);
+
+        if (read_only) {
+            load = AttachmentLoad::Load;
+        }
+
+        const bool       loads  = load == AttachmentLoad::Load;
+        AccessKind       kind   = loads ? AccessKind::Modify : AccessKind::Write;
+        vk::AccessFlags2 access = vk::AccessFlagBits2::eDepthStencilAttachmentWrite;
+        if (loads) {
+            access |= vk::AccessFlagBits2::eDepthStencilAttachmentRead;
+        }
+        if (read_only) {
+            kind   = AccessKind::Read;
+            access = vk::AccessFlagBits2::eDepthStencilAttachmentRead;
+        }
+
+        m_Graph.add_access(
+            m_Pass,
+            m_Graph.m_Passes[m_Pass].images,
+            image.index,
+            kind,
+            ImageState{
+                .layout = attachment_layout(true, read_only),
+                .access = access,
+                .stage  = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+                .owner  = VK_QUEUE_FAMILY_IGNORED,
+            }
+        );
+        m_Graph.add_attachment(m_Pass, RenderGraph::Attachment{.image = image.index, .depth = true, .read_only = read_only, .load = load, .clear = clear});
+        return image;
+    }
+
+    void RenderGraphPassBuilder::side_effect() {
+        m_Graph.m_Passes[m_Pass].side_effect = true;
+    }
+
+    void RenderGraphPassBuilder::secondary_contents() {
+        m_Graph.m_Passes[m_Pass].secondary_contents = true;
+    }
+
+    RenderGraph::RenderGraph(const std::shared_ptr<EngineContext> &engine, RenderGraphResourcePool *transient_pool)
+        : m_Context(engine->vulkan()), m_TransientPool(transient_pool), m_Checking(engine->debug_settings().enable_render_graph_checking) {}
+
+    RenderGraphImage RenderGraph::import_image(
+        std::string                      name,
+        const vk::Image                  image,
+        const vk::ImageSubresourceRange &range,
+        const ImageState                &initial_state,
+        std::optional<ImageState>        final_state,
+        const vk::ImageView              view,
+        const vk::Extent2D               extent,
+        const vk::Format                 format
+    ) {
+        if (m_Checking && !image) {
+            throw crash(CrashReason::CriticalFailure, "Render graph image '" + name + "' was imported with a null handle.");
+        }
+
+        m_Images.push_back(ImageResource{
+            .name          = std::move(name),
+            .imported      = true,
+            .image         = image,
+            .view          = view,
+            .range         = range,
+            .extent        = extent,
+            .format        = format,
+            .samples       = vk::SampleCountFlagBits::e1,
+            .initial_state = ResourceState::from(initial_state),
+            .final_state   = final_state,
+            .desc          = {},
+        });
+        m_Compiled = false;
+        return RenderGraphImage{static_cast<uint32_t>(m_Images.size() - 1)};
+    }
+
+    RenderGraphImage RenderGraph::import_image(
+        std::string name, TrackedImage &image, std::optional<ImageState> final_state, const vk::ImageView view, const vk::Extent2D extent, const vk::Format format
+    ) {
+        const auto range         = image.full_range();
+        auto       initial_state = image.uniform_state(range);
+        if (!initial_state.has_value()) {
+            if (m_Checking) {
+                throw crash(CrashReason::CriticalFailure, "Render graph image '" + name + "' was imported while its subresources are in different states.");
+            }
+
+            initial_state = image.state(0, 0);
+        }
+
+        m_Images.push_back(ImageResource{
+            .name          = std::move(name),
+            .imported      = true,
+            .image         = image.image(),
+            .view          = view,
+            .range         = range,
+            .extent        = extent,
+            .format        = format,
+            .samples       = vk::SampleCountFlagBits::e1,
+            .initial_state = initial_state.value(),
+            .final_state   = final_state,
+            .desc          = {},
+            .tracked       = &image,
+        });
+        m_Compiled = false;
+        return RenderGraphImage{static_cast<uint32_t>(m_Images.size() - 1)};
+    }
+
+    RenderGraphImage RenderGraph::import_frame(std::string name, const FrameInfo &frame_info) {
+        return import_image(std::move(name), *frame_info.tracked_image, frame_info.final_state, frame_info.view, frame_info.extent, frame_info.format);
+    }
+
+    RenderGraphImage RenderGraph::create_image(std::string name, const TransientImageDesc &desc) {
+        m_Images.push_back(ImageResource{
+            .name          = std::move(name),
+            .imported      = false,
+            .image         = nullptr,
+            .view          = nullptr,
+            .range         = vk::ImageSubresourceRange(desc.aspect, 0, desc.mip_levels, 0, desc.array_layers),
+            .extent        = desc.extent,
+            .format        = desc.format,
+            .samples       = desc.samples,
+            .initial_state = ResourceState{},
+            .final_state   = std::nullopt,
+            .desc          = desc,
+        });
+        m_Compiled = false;
+        return RenderGraphImage{static_cast<uint32_t>(m_Images.size() - 1)};
+    }
+
+    RenderGraphBuffer RenderGraph::import_buffer(std::string name, const vk::Buffer buffer, const BufferState &initial_state, std::optional<BufferState> final_state) {
+        if (m_Checking && !buffer) {
+            throw crash(CrashReason::CriticalFailure, "Render graph buffer '" + name + "' was imported with a null handle.");
+        }
+
+        std::optional<ImageState> final;
+        if (final_state.has_value()) {
+            final = ImageState{.access = final_state->access, .stage = final_state->stage};
+        }
+
+        m_Buffers.push_back(BufferResource{
+            .name          = std::move(name),
+            .imported      = true,
+            .buffer        = buffer,
+            .initial_state = ResourceState::from(ImageState{.access = initial_state.access, .stage = initial_state.stage}),
+            .final_state   = final,
+            .desc          = {},
+        });
+        m_Compiled = false;
+        return RenderGraphBuffer{static_cast<uint32_t>(m_Buffers.size() - 1)};
+    }
+
+    RenderGraphBuffer RenderGraph::create_buffer(std::string name, const TransientBufferDesc &desc) {
+        m_Buffers.push_back(BufferResource{
+            .name          = std::move(name),
+            .imported      = false,
+            .buffer        = nullptr,
+            .initial_state = {},
+            .final_state   = std::nullopt,
+            .desc          = desc,
+        });
+        m_Compiled = false;
+        return RenderGraphBuffer{static_cast<uint32_t>(m_Buffers.size() - 1)};
+    }
+
+    void RenderGraph::add_pass(std::string name, const RenderGraphSetup &setup, RenderGraphExecute execute) {
+        m_Passes.push_back(Pass{.name = std::move(name), .execute = std::move(execute)});
+        m_Compiled = false;
+
+        RenderGraphPassBuilder builder(*this, static_cast<uint32_t>(m_Passes.size() - 1));
+        setup(builder);
+    }
+
+    void RenderGraph::add_access(const uint32_t pass, std::vector<Access> &accesses, const uint32_t resource, const AccessKind kind, const ImageState &usage) const {
+        // A pass touching the same resource more than once gets a single combined access.
+        for (auto &access : accesses) {
+            if (access.resource != resource) {
+                continue;
+            }
+
+            if (m_Checking && access.usage.layout != usage.layout) {
+                throw crash(
+                    CrashReason::CriticalFailure,
+                    "Render graph pass '" + m_Passes[pass].name + "' uses the same image in two different layouts (" + vk::to_string(access.usage.layout) + " and " +
+                        vk::to_string(usage.layout) + ")."
+                );
+            }
+
+            access.usage.layout = usage.layout;
+            access.usage.access |= usage.access;
+            access.usage.stage |= usage.stage;
+            if (access.kind != kind) {
+                access.kind = AccessKind::Modify;
+            }
+            return;
+        }
+
+        accesses.push_back(Access{.resource = resource, .kind = kind, .usage = usage});
+    }
+
+    void RenderGraph::add_attachment(const uint32_t pass, const Attachment &attachment) {
+        auto &attachments = m_Passes[pass].attachments;
+        for (const auto &other : attachments) {
+            if (m_Checking && (other.image == attachment.image || (other.depth && attachment.depth))) {
+                throw crash(
+                    CrashReason::CriticalFailure,
+                    "Render graph pass '" + m_Passes[pass].name + "' uses '" + m_Images[attachment.image].name + "' as an attachment when it already has that attachment."
+                );
+            }
+        }
+
+        attachments.push_back(attachment);
+    }
+
+    void RenderGraph::compile() {
+        cull_passes();
+        assign_levels();
+        choose_store_ops();
+        allocate_transients();
+        build_barriers();
+        build_inheritance();
+        m_Compiled = true;
+    }
+
+    void RenderGraph::cull_passes() {
+        // Only true data dependencies matter here, a pass needs whichever pass last wrote each resource it reads.
+        std::vector<std::vector<uint32_t>> producers(m_Passes.size());
+        std::vector<uint32_t>              last_image_writer(m_Images.size(), UINT32_MAX);
+        std::vector<uint32_t>              last_buffer_writer(m_Buffers.size(), UINT32_MAX);
+        std::vector<uint32_t>              stack;
+
+        for (uint32_t i = 0; i < m_Passes.size(); i++) {
+            auto &pass   = m_Passes[i];
+            bool  root   = pass.side_effect;
+            pass.active  = false;
+
+            for (const auto &access : pass.images) {
+                if (access.kind != AccessKind::Write && last_image_writer[access.resource] != UINT32_MAX) {
+                    producers[i].push_back(last_image_writer[access.resource]);
+                }
+
+                if (access.kind != AccessKind::Read) {
+                    last_image_writer[access.resource] = i;
+                    root |= m_Images[access.resource].imported;
+                }
+            }
+
+            for (const auto &access : pass.buffers) {
+                if (access.kind != AccessKind::Write && last_buffer_writer[access.resource] != UINT32_MAX) {
+                    producers[i].push_back(last_buffer_writer[access.resource]);
+                }
+
+                if (access.kind != AccessKind::Read) {
+                    last_buffer_writer[access.resource] = i;
+                    root |= m_Buffers[access.resource].imported;
+                }
+            }
+
+            if (root) {
+                stack.push_back(i);
+            }
+        }
+
+        while (!stack.empty()) {
+            const uint32_t index = stack.back();
+            stack.pop_back();
+
+            if (m_Passes[index].active) {
+                continue;
+            }
+
+            m_Passes[index].active = true;
+            for (const auto producer : producers[index]) {
+                if (!m_Passes[producer].active) {
+                    stack.push_back(producer);
+                }
+            }
+        }
+    }
+
+    void RenderGraph::assign_levels() {
+        // An access is exclusive if it writes or changes the layout, it then has to come after every earlier access. Shared accesses (reads in the current layout) only have to
+        // come after the last exclusive one, so they can all end up in the same level.
+        struct Tracker {
+            uint32_t              last_exclusive = UINT32_MAX;
+            std::vector<uint32_t> shared;
+            vk::ImageLayout       layout = vk::ImageLayout::eUndefined;
+        };
+
+        std::vector<Tracker> image_trackers(m_Images.size());
+        std::vector<Tracker> buffer_trackers(m_Buffers.size());
+        for (uint32_t i = 0; i < m_Images.size(); i++) {
+            image_trackers[i].layout = m_Images[i].initial_state.layout;
+        }
+
+        const auto is_exclusive = [](const Tracker &tracker, const Access &access) {
+            return access.kind != AccessKind::Read || access.usage.layout != tracker.layout;
+        };
+
+        uint32_t level_count = 0;
+        for (uint32_t i = 0; i < m_Passes.size(); i++) {
+            auto &pass = m_Passes[i];
+            if (!pass.active) {
+                continue;
+            }
+
+            uint32_t   level      = 0;
+            const auto depends_on = [&](const uint32_t other) {
+                if (other != UINT32_MAX) {
+                    level = std::max(level, m_Passes[other].level + 1);
+                }
+            };
+
+            const auto gather = [&](const std::vector<Access> &accesses, const std::vector<Tracker> &trackers) {
+                for (const auto &access : accesses) {
+                    const auto &tracker = trackers[access.resource];
+                    depends_on(tracker.last_exclusive);
+                    if (is_exclusive(tracker, access)) {
+                        for (const auto other : tracker.shared) {
+                            depends_on(other);
+                        }
+                    }
+                }
+            };
+
+            const auto update = [&](const std::vector<Access> &accesses, std::vector<Tracker> &trackers) {
+                for (const auto &access : accesses) {
+                    auto &tracker = trackers[access.resource];
+                    if (is_exclusive(tracker, access)) {
+                        tracker.last_exclusive = i;
+                        tracker.shared.clear();
+                        tracker.layout = access.usage.layout;
+                    } else {
+                        tracker.shared.push_back(i);
+                    }
+                }
+            };
+
+            gather(pass.images, image_trackers);
+            gather(pass.buffers, buffer_trackers);
+            pass.level = level;
+            update(pass.images, image_trackers);
+            update(pass.buffers, buffer_trackers);
+
+            level_count = std::max(level_count, level + 1);
+        }
+
+        m_Levels.assign(level_count, Level{});
+        for (uint32_t i = 0; i < m_Passes.size(); i++) {
+            if (m_Passes[i].active) {
+                m_Levels[m_Passes[i].level].passes.push_back(i);
+            }
+        }
+    }
+
+    void RenderGraph::choose_store_ops() {
+        // Transient images which are only ever attachments could live in lazily allocated memory, as long as their contents never have to be stored.
+        for (auto &image : m_Images) {
+            image.lazy = !image.imported && !(image.desc.usage & ~ATTACHMENT_USAGE_FLAGS);
+        }
+
+        for (uint32_t i = 0; i < m_Passes.size(); i++) {
+            auto &pass = m_Passes[i];
+            if (!pass.active) {
+                continue;
+            }
+
+            for (const auto &access : pass.images) {
+                m_Images[access.resource].lazy &= std::ranges::any_of(pass.attachments, [&](const Attachment &attachment) { return attachment.image == access.resource; });
+            }
+
+            for (auto &attachment : pass.attachments) {
+                auto &image = m_Images[attachment.image];
+                if (attachment.read_only) {
+                    attachment.store = vk::AttachmentStoreOp::eNone;
+                    continue;
+                }
+
+                // The contents only have to be stored if the next pass to touch the image looks at them. Imported images are looked at by their owner once the graph is done.
+                attachment.store = image.imported ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare;
+                for (uint32_t j = i + 1; j < m_Passes.size(); j++) {
+                    if (!m_Passes[j].active) {
+                        continue;
+                    }
+
+                    const auto next = std::ranges::find(m_Passes[j].images, attachment.image, &Access::resource);
+                    if (next != m_Passes[j].images.end()) {
+                        attachment.store = next->kind == AccessKind::Write ? vk::AttachmentStoreOp::eDontCare : vk::AttachmentStoreOp::eStore;
+                        break;
+                    }
+                }
+
+                image.lazy &= attachment.store != vk::AttachmentStoreOp::eStore;
+            }
+        }
+    }
+
+    void RenderGraph::allocate_transients() {
+        std::vector<uint32_t> image_first(m_Images.size(), UINT32_MAX), image_last(m_Images.size(), 0);
+        std::vector<uint32_t> buffer_first(m_Buffers.size(), UINT32_MAX), buffer_last(m_Buffers.size(), 0);
+
+        for (const auto &pass : m_Passes) {
+            if (!pass.active) {
+                continue;
+            }
+
+            for (const auto &access : pass.images) {
+                image_first[access.resource] = std::min(image_first[access.resource], pass.level);
+                image_last[access.resource]  = std::max(image_last[access.resource], pass.level);
+            }
+
+            for (const auto &access : pass.buffers) {
+                buffer_first[access.resource] = std::min(buffer_first[access.resource], pass.level);
+                buffer_last[access.resource]  = std::max(buffer_last[access.resource], pass.level);
+            }
+        }
+
+        std::vector<RenderGraphResourcePool::ImageRequest>  image_requests;
+        std::vector<RenderGraphResourcePool::BufferRequest> buffer_requests;
+
+        for (uint32_t i = 0; i < m_Images.size(); i++) {
+            auto &image           = m_Images[i];
+            image.transient_index = UINT32_MAX;
+            if (!image.imported && image_first[i] != UINT32_MAX) {
+                auto desc = image.desc;
+                if (image.lazy) {
+                    desc.usage |= vk::ImageUsageFlagBits::eTransientAttachment;
+                }
+
+                image.transient_index = static_cast<uint32_t>(image_requests.size());
+                image_requests.push_back({desc, image_first[i], image_last[i]});
+            }
+        }
+
+        for (uint32_t i = 0; i < m_Buffers.size(); i++) {
+            auto &buffer           = m_Buffers[i];
+            buffer.transient_index = UINT32_MAX;
+            if (!buffer.imported && buffer_first[i] != UINT32_MAX) {
+                buffer.transient_index = static_cast<uint32_t>(buffer_requests.size());
+                buffer_requests.push_back({buffer.desc, buffer_first[i], buffer_last[i]});
+            }
+        }
+
+        if (image_requests.empty() && buffer_requests.empty()) {
+            return;
+        }
+
+        if (!m_TransientPool) {
+            throw crash(CrashReason::CriticalFailure, "Render graph uses transient resources but was created without a transient resource pool.");
+        }
+
+        m_TransientPool->realize(image_requests, buffer_requests);
+
+        for (auto &image : m_Images) {
+            if (image.transient_index != UINT32_MAX) {
+                image.image = *m_TransientPool->m_Images[image.transient_index];
+                image.view  = *m_TransientPool->m_ImageViews[image.transient_index];
+            }
+        }
+
+        for (auto &buffer : m_Buffers) {
+            if (buffer.transient_index != UINT32_MAX) {
+                buffer.buffer = *m_TransientPool->m_Buffers[buffer.transient_index];
+            }
+        }
+    }
+
+    void RenderGraph::build_barriers() {
+        std::vector<ResourceState> image_states, buffer_states;
+        image_states.reserve(m_Images.size());
+        buffer_states.reserve(m_Buffers.size());
+        for (const auto &image : m_Images) {
+            image_states.push_back(image.initial_state);
+        }
+        for (const auto &buffer : m_Buffers) {
+            buffer_states.push_back(buffer.initial_state);
+        }
+
+        // Transient index -> resource index, so aliasing barriers can find the state of whatever used the memory before.
+        std::vector<uint32_t> transient_images, transient_buffers;
+        for (uint32_t i = 0; i < m_Images.size(); i++) {
+            if (m_Images[i].transient_index != UINT32_MAX) {
+                transient_images.resize(std::max<size_t>(transient_images.size(), m_Images[i].transient_index + 1));
+                transient_images[m_Images[i].transient_index] = i;
+            }
+        }
+        for (uint32_t i = 0; i < m_Buffers.size(); i++) {
+            if (m_Buffers[i].transient_index != UINT32_MAX) {
+                transient_buffers.resize(std::max<size_t>(transient_buffers.size(), m_Buffers[i].transient_index + 1));
+                transient_buffers[m_Buffers[i].transient_index] = i;
+            }
+        }
+
+        struct Combined {
+            ImageState usage;
+            AccessKind kind;
+        };
+
+        std::vector<std::optional<Combined>> combined_images(m_Images.size()), combined_buffers(m_Buffers.size());
+        std::vector<bool>                    image_used(m_Images.size(), false), buffer_used(m_Buffers.size(), false);
+
+        const auto combine = [](std::optional<Combined> &combined, const Access &access) {
+            if (!combined.has_value()) {
+                combined = Combined{.usage = access.usage, .kind = access.kind};
+                return;
+            }
+
+            combined->usage.access |= access.usage.access;
+            combined->usage.stage |= access.usage.stage;
+            if (combined->kind != access.kind) {
+                combined->kind = AccessKind::Modify;
+            }
+        };
+
+        for (auto &level : m_Levels) {
+            std::vector<uint32_t> touched_images, touched_buffers;
+            for (const auto pass_index : level.passes) {
+                for (const auto &access : m_Passes[pass_index].images) {
+                    if (!combined_images[access.resource].has_value()) {
+                        touched_images.push_back(access.resource);
+                    }
+                    combine(combined_images[access.resource], access);
+                }
+
+                for (const auto &access : m_Passes[pass_index].buffers) {
+                    if (!combined_buffers[access.resource].has_value()) {
+                        touched_buffers.push_back(access.resource);
+                    }
+                    combine(combined_buffers[access.resource], access);
+                }
+            }
+
+            // Whatever used a transient's memory before it has to be completely done with it. This goes into the transient's own barrier rather than a separate one, since
+            // barriers in the same `pipelineBarrier2` aren't ordered against each other (so the layout transition could otherwise run while the old alias is still in use).
+            const auto first_use = [&](const std::string &name, const Combined &combined, const std::vector<uint32_t> &aliases, const std::vector<uint32_t> &transient_to_resource,
+                                       const std::vector<ResourceState> &states) {
+                if (m_Checking && combined.kind != AccessKind::Write) {
+                    throw crash(CrashReason::CriticalFailure, "Transient render graph resource '" + name + "' is read before anything writes to it.");
+                }
+
+                ResourceState::Transition dependency{};
+                for (const auto alias : aliases) {
+                    const auto &state = states[transient_to_resource[alias]];
+                    dependency.src_stage |= state.write_stages | state.read_stages;
+                    dependency.src_access |= state.write_access;
+                }
+                return dependency;
+            };
+
+            for (const auto index : touched_images) {
+                auto       &resource = m_Images[index];
+                const auto  combined = combined_images[index].value();
+                combined_images[index].reset();
+
+                ResourceState::Transition alias{};
+                if (!resource.imported && !image_used[index]) {
+                    alias = first_use(resource.name, combined, m_TransientPool->m_ImageAliases[resource.transient_index], transient_images, image_states);
+                }
+                image_used[index] = true;
+
+                const auto transition = image_states[index].transition(combined.usage, combined.kind);
+                if (transition || alias.src_stage) {
+                    const auto src = transition.value_or(ResourceState::Transition{.old_layout = combined.usage.layout});
+                    level.barriers.image(vk::ImageMemoryBarrier2{
+                        src.src_stage | alias.src_stage,
+                        src.src_access | alias.src_access,
+                        combined.usage.stage,
+                        combined.usage.access,
+                        src.old_layout,
+                        combined.usage.layout,
+                        VK_QUEUE_FAMILY_IGNORED,
+                        VK_QUEUE_FAMILY_IGNORED,
+                        resource.image,
+                        resource.range,
+                    });
+                }
+            }
+
+            for (const auto index : touched_buffers) {
+                auto       &resource = m_Buffers[index];
+                const auto  combined = combined_buffers[index].value();
+                combined_buffers[index].reset();
+
+                ResourceState::Transition alias{};
+                if (!resource.imported && !buffer_used[index]) {
+                    alias = first_use(resource.name, combined, m_TransientPool->m_BufferAliases[resource.transient_index], transient_buffers, buffer_states);
+                }
+                buffer_used[index] = true;
+
+                const auto transition = buffer_states[index].transition(combined.usage, combined.kind);
+                if (transition || alias.src_stage) {
+                    const auto src = transition.value_or(ResourceState::Transition{});
+                    level.barriers.buffer(vk::BufferMemoryBarrier2{
+                        src.src_stage | alias.src_stage,
+                        src.src_access | alias.src_access,
+                        combined.usage.stage,
+                        combined.usage.access,
+                        VK_QUEUE_FAMILY_IGNORED,
+                        VK_QUEUE_FAMILY_IGNORED,
+                        resource.buffer,
+                        0,
+                        VK_WHOLE_SIZE,
+                    });
+                }
+            }
+        }
+
+        m_FinalBarriers.clear();
+        for (uint32_t i = 0; i < m_Images.size(); i++) {
+            auto &resource = m_Images[i];
+            if (!resource.final_state.has_value()) {
+                resource.end_state = image_states[i];
+                continue;
+            }
+
+            const auto &final = resource.final_state.value();
+            if (const auto transition = image_states[i].transition(final, final.access & WRITE_ACCESS_FLAGS ? AccessKind::Modify : AccessKind::Read)) {
+                m_FinalBarriers.image(vk::ImageMemoryBarrier2{
+                    transition->src_stage,
+                    transition->src_access,
+                    final.stage,
+                    final.access,
+                    transition->old_layout,
+                    final.layout,
+                    VK_QUEUE_FAMILY_IGNORED,
+                    VK_QUEUE_FAMILY_IGNORED,
+                    resource.image,
+                    resource.range,
+                });
+            }
+            resource.end_state = image_states[i];
+        }
+
+        for (uint32_t i = 0; i < m_Buffers.size(); i++) {
+            const auto &resource = m_Buffers[i];
+            if (!resource.final_state.has_value()) {
+                continue;
+            }
+
+            const auto &final = resource.final_state.value();
+            if (const auto transition = buffer_states[i].transition(final, final.access & WRITE_ACCESS_FLAGS ? AccessKind::Modify : AccessKind::Read)) {
+                m_FinalBarriers.buffer(vk::BufferMemoryBarrier2{
+                    transition->src_stage,
+                    transition->src_access,
+                    final.stage,
+                    final.access,
+                    VK_QUEUE_FAMILY_IGNORED,
+                    VK_QUEUE_FAMILY_IGNORED,
+                    resource.buffer,
+                    0,
+                    VK_WHOLE_SIZE,
+                });
+            }
+        }
+    }
+
+    void RenderGraph::build_inheritance() {
+        for (auto &pass : m_Passes) {
+            pass.color_formats.clear();
+            pass.inheritance = vk::CommandBufferInheritanceRenderingInfo{};
+            if (!pass.active || !pass.secondary_contents) {
+                continue;
+            }
+
+            pass.inheritance.flags                = vk::RenderingFlagBits::eContentsSecondaryCommandBuffers;
+            pass.inheritance.rasterizationSamples = vk::SampleCountFlagBits::e1;
+            for (const auto &attachment : pass.attachments) {
+                const auto &image = m_Images[attachment.image];
+                if (m_Checking && image.format == vk::Format::eUndefined) {
+                    throw crash(
+                        CrashReason::CriticalFailure,
+                        "Render graph image '" + image.name + "' is an attachment of a pass with secondary contents, but was imported without a format."
+                    );
+                }
+
+                pass.inheritance.rasterizationSamples = image.samples;
+                if (!attachment.depth) {
+                    pass.color_formats.push_back(image.format);
+                    continue;
+                }
+
+                if (image.range.aspectMask & vk::ImageAspectFlagBits::eDepth) {
+                    pass.inheritance.depthAttachmentFormat = image.format;
+                }
+                if (image.range.aspectMask & vk::ImageAspectFlagBits::eStencil) {
+                    pass.inheritance.stencilAttachmentFormat = image.format;
+                }
+            }
+            pass.inheritance.setColorAttachmentFormats(pass.color_formats);
+        }
+    }
+
+    void RenderGraph::execute(const vk::raii::CommandBuffer &cmd) {
+        if (!m_Compiled) {
+            compile();
+        }
+
+        for (const auto &level : m_Levels) {
+            level.barriers.record(cmd);
+            for (const auto pass_index : level.passes) {
+                const auto &pass = m_Passes[pass_index];
+                if (pass.attachments.empty()) {
+                    pass.execute(cmd, *this);
+                } else {
+                    execute_rendering(cmd, pass);
+                }
+            }
+        }
+
+        m_FinalBarriers.record(cmd);
+
+        for (const auto &image : m_Images) {
+            if (image.tracked) {
+                image.tracked->set_state(image.range, image.end_state);
+            }
+        }
+    }
+
+    void RenderGraph::execute_rendering(const vk::raii::CommandBuffer &cmd, const Pass &pass) const {
+        std::vector<vk::RenderingAttachmentInfo>   colors;
+        std::optional<vk::RenderingAttachmentInfo> depth, stencil;
+        vk::Extent2D                               extent(UINT32_MAX, UINT32_MAX);
+
+        for (const auto &attachment : pass.attachments) {
+            const auto &image = m_Images[attachment.image];
+            if (m_Checking && (!image.view || image.extent.width == 0 || image.extent.height == 0)) {
+                throw crash(CrashReason::CriticalFailure, "Render graph image '" + image.name + "' is used as an attachment, but was imported without a view and extent.");
+            }
+
+            extent.width  = std::min(extent.width, image.extent.width);
+            extent.height = std::min(extent.height, image.extent.height);
+
+            const vk::RenderingAttachmentInfo info(
+                image.view,
+                attachment_layout(attachment.depth, attachment.read_only),
+                vk::ResolveModeFlagBits::eNone,
+                nullptr,
+                vk::ImageLayout::eUndefined,
+                load_op(attachment.load),
+                attachment.store,
+                attachment.clear
+            );
+
+            if (!attachment.depth) {
+                colors.push_back(info);
+                continue;
+            }
+
+            if (image.range.aspectMask & vk::ImageAspectFlagBits::eDepth) {
+                depth = info;
+            }
+            if (image.range.aspectMask & vk::ImageAspectFlagBits::eStencil) {
+                stencil = info;
+            }
+        }
+
+        const vk::Rect2D         area({0, 0}, extent);
+        const vk::RenderingFlags flags = pass.secondary_contents ? vk::RenderingFlagBits::eContentsSecondaryCommandBuffers : vk::RenderingFlags{};
+        cmd.beginRendering(vk::RenderingInfo(flags, area, 1, 0, colors, depth ? &depth.value() : nullptr, stencil ? &stencil.value() : nullptr));
+        if (!pass.secondary_contents) {
+            cmd.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f));
+            cmd.setScissor(0, area);
+        }
+
+        pass.execute(cmd, *this);
+
+        cmd.endRendering();
+    }
+
+    vk::Image RenderGraph::image(const RenderGraphImage image) const {
+        check_image(image);
+        return m_Images[image.index].image;
+    }
+
+    vk::ImageView RenderGraph::image_view(const RenderGraphImage image) const {
+        check_image(image);
+        return m_Images[image.index].view;
+    }
+
+    const vk::ImageSubresourceRange &RenderGraph::subresource_range(const RenderGraphImage image) const {
+        check_image(image);
+        return m_Images[image.index].range;
+    }
+
+    vk::Buffer RenderGraph::buffer(const RenderGraphBuffer buffer) const {
+        check_buffer(buffer);
+        return m_Buffers[buffer.index].buffer;
+    }
+
+    bool RenderGraph::is_pass_active(const std::string_view name) const {
+        return std::ranges::any_of(m_Passes, [&](const Pass &pass) { return pass.active && pass.name == name; });
+    }
+
+    std::optional<vk::AttachmentStoreOp> RenderGraph::attachment_store_op(const std::string_view name, const RenderGraphImage image) const {
+        for (const auto &pass : m_Passes) {
+            if (pass.name != name) {
+                continue;
+            }
+
+            const auto attachment = std::ranges::find(pass.attachments, image.index, &Attachment::image);
+            if (attachment != pass.attachments.end()) {
+                return attachment->store;
+            }
+        }
+        return std::nullopt;
+    }
+
+    const vk::CommandBufferInheritanceRenderingInfo *RenderGraph::rendering_inheritance(const std::string_view name) const {
+        for (const auto &pass : m_Passes) {
+            if (pass.name == name && pass.active && pass.secondary_contents) {
+                return &pass.inheritance;
+            }
+        }
+        return nullptr;
+    }
+
+    void RenderGraph::check_image(const RenderGraphImage image) const {
+        if (m_Checking && image.index >= m_Images.size()) {
+            throw crash(CrashReason::CriticalFailure, "Invalid render graph image handle (" + std::to_string(image.index) + ").");
+        }
+    }
+
+    void RenderGraph::check_buffer(const RenderGraphBuffer buffer) const {
+        if (m_Checking && buffer.index >= m_Buffers.size()) {
+            throw crash(CrashReason::CriticalFailure, "Invalid render graph buffer handle (" + std::to_string(buffer.index) + ").");
+        }
+    }
+} // namespace engine
@@ -0,0 +1,380 @@
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "engine/fwd.hpp"
+#include "engine/renderer/barrier_batch.hpp"
+#include "engine/renderer/render_target.hpp"
+#include "engine/renderer/resource_state.hpp"
+#include "engine/renderer/vulkan_context.hpp"
+
+namespace engine {
+    struct RenderGraphImage {
+        uint32_t index = UINT32_MAX;
+
+        [[nodiscard]] inline bool valid() const { return index != UINT32_MAX; }
+    };
+
+    struct RenderGraphBuffer {
+        uint32_t index = UINT32_MAX;
+
+        [[nodiscard]] inline bool valid() const { return index != UINT32_MAX; }
+    };
+
+    /**
+     * What a rendering pass starts an attachment with.
+     */
+    enum class AttachmentLoad {
+        /**
+         * Whatever an earlier pass (or whoever owns an imported image) left in it.
+         */
+        Load,
+
+        /**
+         * The clear value, for free on most GPUs (no separate clear, no transition to a transfer layout).
+         */
+        Clear,
+
+        /**
+         * Undefined contents, for passes which are going to overwrite every pixel anyway.
+         */
+        DontCare,
+    };
+
+    struct TransientImageDesc {
+        vk::Format              format;
+        vk::Extent2D            extent;
+        vk::ImageUsageFlags     usage;
+        vk::ImageAspectFlags    aspect       = vk::ImageAspectFlagBits::eColor;
+        uint32_t                mip_levels   = 1;
+        uint32_t                array_layers = 1;
+        vk::SampleCountFlagBits samples      = vk::SampleCountFlagBits::e1;
+
+        bool operator==(const TransientImageDesc &other) const = default;
+    };
+
+    struct TransientBufferDesc {
+        vk::DeviceSize       size;
+        vk::BufferUsageFlags usage;
+
+        bool operator==(const TransientBufferDesc &other) const = default;
+    };
+
+    /**
+     * Owns the memory behind a render graph's transient resources. Transient resources whose lifetimes don't overlap share memory. A pool must only be used by one frame in
+     * flight at a time (the graph may destroy and recreate the pool's resources while compiling if the set of transients changed since the last compile), so keep one per frame
+     * and only compile a graph against it once that frame's previous submission has finished.
+     */
+    class RenderGraphResourcePool {
+      public:
+        explicit RenderGraphResourcePool(const std::shared_ptr<VulkanContext> &ctx);
+
+        RenderGraphResourcePool(const RenderGraphResourcePool &other)                = delete;
+        RenderGraphResourcePool(RenderGraphResourcePool &&other) noexcept            = default;
+        RenderGraphResourcePool &operator=(const RenderGraphResourcePool &other)     = delete;
+        RenderGraphResourcePool &operator=(RenderGraphResourcePool &&other) noexcept = default;
+
+        /**
+         * Total size of all device memory blocks currently owned by this pool.
+         */
+        [[nodiscard]] vk::DeviceSize memory_size() const;
+
+      private:
+        friend class RenderGraph;
+
+        struct ImageRequest {
+            TransientImageDesc desc;
+            uint32_t           first_level;
+            uint32_t           last_level;
+
+            bool operator==(const ImageRequest &other) const = default;
+        };
+
+        struct BufferRequest {
+            TransientBufferDesc desc;
+            uint32_t            first_level;
+            uint32_t            last_level;
+
+            bool operator==(const BufferRequest &other) const = default;
+        };
+
+        /**
+         * Make sure there is an image/buffer for each request. The indices of the resulting resources match the requests.
+         */
+        void realize(const std::vector<ImageRequest> &images, const std::vector<BufferRequest> &buffers);
+
+        std::shared_ptr<VulkanContext> m_Context;
+
+        std::vector<ImageRequest>  m_ImageRequests;
+        std::vector<BufferRequest> m_BufferRequests;
+
+        std::vector<Allocation>             m_Blocks;
+        std::vector<vk::DeviceSize>         m_BlockSizes;
+        std::vector<vk::raii::Image>        m_Images;
+        std::vector<vk::raii::ImageView>    m_ImageViews;
+        std::vector<vk::raii::Buffer>       m_Buffers;
+
+        /**
+         * For each transient, the earlier transients which occupied (some of) the same memory.
+         */
+        std::vector<std::vector<uint32_t>> m_ImageAliases;
+        std::vector<std::vector<uint32_t>> m_BufferAliases;
+    };
+
+    class RenderGraph;
+
+    /**
+     * Used by a pass's setup function to declare every resource the pass touches and how.
+     */
+    class RenderGraphPassBuilder {
+      public:
+        /**
+         * The pass reads the image's current contents.
+         */
+        RenderGraphImage read(RenderGraphImage image, const ImageState &usage);
+
+        /**
+         * The pass completely overwrites the image (its previous contents may be discarded).
+         */
+        RenderGraphImage write(RenderGraphImage image, const ImageState &usage);
+
+        /**
+         * The pass reads and writes the image (blending, load-op load, read-modify-write storage images, ...).
+         */
+        RenderGraphImage modify(RenderGraphImage image, const ImageState &usage);
+
+        RenderGraphBuffer read(RenderGraphBuffer buffer, const BufferState &usage);
+        RenderGraphBuffer write(RenderGraphBuffer buffer, const BufferState &usage);
+        RenderGraphBuffer modify(RenderGraphBuffer buffer, const BufferState &usage);
+
+        /**
+         * Render to the image as a color attachment. Store ops aren't up to the pass: the graph stores the result only if a later pass (or the owner of an imported image)
+         * needs it.
+         */
+        RenderGraphImage color_attachment(RenderGraphImage image, AttachmentLoad load = AttachmentLoad::Load, const vk::ClearColorValue &clear = {});
+
+        /**
+         * Use the image as the depth (and stencil, if its aspect has stencil) attachment.
+         *
+         * @param read_only Depth testing without depth writes. The contents are always loaded and never stored.
+         */
+        RenderGraphImage depth_attachment(
+            RenderGraphImage image, AttachmentLoad load = AttachmentLoad::Load, const vk::ClearDepthStencilValue &clear = {}, bool read_only = false
+        );
+
+        /**
+         * The pass does something which isn't visible to the graph (like writing to a host visible buffer), so it must never be culled.
+         */
+        void side_effect();
+
+        /**
+         * Begin the pass's rendering with `eContentsSecondaryCommandBuffers`, so its execute function records everything into secondary command buffers (for example with
+         * `Application::record_parallel`, passing `RenderGraph::rendering_inheritance`). The graph doesn't set the viewport and scissor for such passes, since secondary
+         * command buffers don't inherit them.
+         */
+        void secondary_contents();
+
+      private:
+        friend class RenderGraph;
+
+        RenderGraphPassBuilder(RenderGraph &graph, uint32_t pass) : m_Graph(graph), m_Pass(pass) {}
+
+        RenderGraph &m_Graph;
+        uint32_t     m_Pass;
+    };
+
+    using RenderGraphSetup   = std::function<void(RenderGraphPassBuilder &)>;
+    using RenderGraphExecute = std::function<void(const vk::raii::CommandBuffer &, const RenderGraph &)>;
+
+    /**
+     * A single frame's worth of GPU work, described as passes which declare the images and buffers they use. Compiling the graph culls passes whose results are never used,
+     * groups the rest into dependency levels, places transient resources into shared (aliased) memory, and works out the minimal set of barriers between levels. Every level
+     * gets at most one `pipelineBarrier2`, no matter how many resources change state at that point.
+     *
+     * Passes which write imported resources (or declare side effects) are the roots of the graph, anything they don't (transitively) depend on gets culled.
+     *
+     * Passes with attachments are rendering passes: the graph wraps their execute function in `beginRendering`/`endRendering` (with the viewport and scissor set to the render
+     * area, which is the smallest attachment's extent) and picks every attachment's store op from what happens to it later. Transient images which are only ever used as
+     * attachments and never stored are created as transient attachments in lazily allocated memory where the device has it, so on tile based GPUs they never touch memory.
+     */
+    class RenderGraph {
+      public:
+        /**
+         * @param transient_pool Where transient resources are allocated. May be null if the graph never creates any transient resources.
+         */
+        RenderGraph(const std::shared_ptr<EngineContext> &engine, RenderGraphResourcePool *transient_pool = nullptr);
+
+        /**
+         * Use an image which is owned outside of the graph.
+         *
+         * @param initial_state The state the image is in when the graph starts executing.
+         * @param final_state The state the image should be left in once the graph finishes executing. If not provided, the image is left in whatever state the last pass used.
+         * @param view, extent, format Only needed to use the image as an attachment (and the format only by passes with secondary contents).
+         */
+        RenderGraphImage import_image(
+            std::string                      name,
+            vk::Image                        image,
+            const vk::ImageSubresourceRange &range,
+            const ImageState                &initial_state,
+            std::optional<ImageState>        final_state = std::nullopt,
+            vk::ImageView                    view        = nullptr,
+            vk::Extent2D                     extent      = {},
+            vk::Format                       format      = vk::Format::eUndefined
+        );
+
+        /**
+         * Use an image whose state is tracked outside of the graph. The graph starts from the image's tracked state and hands the state it leaves the image in back once it has
+         * been recorded.
+         */
+        RenderGraphImage import_image(
+            std::string name, TrackedImage &image, std::optional<ImageState> final_state = std::nullopt, vk::ImageView view = nullptr, vk::Extent2D extent = {},
+            vk::Format format = vk::Format::eUndefined
+        );
+
+        /**
+         * Import the image a frame is rendered into, leaving it in the state the render target wants it in at the end of the frame. It can be used as a color attachment
+         * straight away.
+         */
+        RenderGraphImage import_frame(std::string name, const FrameInfo &frame_info);
+
+        RenderGraphImage create_image(std::string name, const TransientImageDesc &desc);
+
+        RenderGraphBuffer import_buffer(std::string name, vk::Buffer buffer, const BufferState &initial_state, std::optional<BufferState> final_state = std::nullopt);
+
+        RenderGraphBuffer create_buffer(std::string name, const TransientBufferDesc &desc);
+
+        void add_pass(std::string name, const RenderGraphSetup &setup, RenderGraphExecute execute);
+
+        void compile();
+
+        /**
+         * Record every pass (and the barriers between them) into `cmd`. Compiles the graph first if that hasn't been done yet.
+         */
+        void execute(const vk::raii::CommandBuffer &cmd);
+
+        [[nodiscard]] vk::Image image(RenderGraphImage image) const;
+
+        [[nodiscard]] vk::ImageView image_view(RenderGraphImage image) const;
+
+        [[nodiscard]] const vk::ImageSubresourceRange &subresource_range(RenderGraphImage image) const;
+
+        [[nodiscard]] vk::Buffer buffer(RenderGraphBuffer buffer) const;
+
+        /**
+         * Whether a pass survived culling. Only meaningful after compiling.
+         */
+        [[nodiscard]] bool is_pass_active(std::string_view name) const;
+
+        /**
+         * The store op chosen for `image` as an attachment of the pass called `name`. Only meaningful after compiling.
+         */
+        [[nodiscard]] std::optional<vk::AttachmentStoreOp> attachment_store_op(std::string_view name, RenderGraphImage image) const;
+
+        /**
+         * What secondary command buffers executed inside the pass called `name` have to inherit (attachment formats and sample count). Null unless the pass declared
+         * `secondary_contents`. Only meaningful after compiling, and stays valid until the graph is changed.
+         */
+        [[nodiscard]] const vk::CommandBufferInheritanceRenderingInfo *rendering_inheritance(std::string_view name) const;
+
+      private:
+        friend class RenderGraphPassBuilder;
+
+        struct Access {
+            uint32_t     resource;
+            AccessKind   kind;
+            ImageState   usage;
+        };
+
+        struct Attachment {
+            uint32_t              image;
+            bool                  depth;
+            bool                  read_only;
+            AttachmentLoad        load;
+            vk::ClearValue        clear;
+            vk::AttachmentStoreOp store = vk::AttachmentStoreOp::eStore;
+        };
+
+        struct Pass {
+            std::string        name;
+            RenderGraphExecute execute;
+            std::vector<Access> images;
+            std::vector<Access> buffers;
+            std::vector<Attachment> attachments;
+            bool               side_effect        = false;
+            bool               secondary_contents = false;
+
+            // Only filled in for passes with secondary contents.
+            std::vector<vk::Format>                   color_formats;
+            vk::CommandBufferInheritanceRenderingInfo inheritance;
+
+            bool     active = false;
+            uint32_t level  = 0;
+        };
+
+        struct ImageResource {
+            std::string               name;
+            bool                      imported;
+            vk::Image                 image;
+            vk::ImageView             view;
+            vk::ImageSubresourceRange range;
+            vk::Extent2D              extent;
+            vk::Format                format;
+            vk::SampleCountFlagBits   samples;
+            ResourceState             initial_state;
+            std::optional<ImageState> final_state;
+            TransientImageDesc        desc;
+            TrackedImage             *tracked         = nullptr;
+            uint32_t                  transient_index = UINT32_MAX;
+            bool                      lazy            = false;
+            ResourceState             end_state;
+        };
+
+        struct BufferResource {
+            std::string               name;
+            bool                      imported;
+            vk::Buffer                buffer;
+            ResourceState             initial_state;
+            std::optional<ImageState> final_state;
+            TransientBufferDesc       desc;
+            uint32_t                  transient_index = UINT32_MAX;
+        };
+
+        struct Level {
+            std::vector<uint32_t> passes;
+            BarrierBatch          barriers;
+        };
+
+        void add_access(uint32_t pass, std::vector<Access> &accesses, uint32_t resource, AccessKind kind, const ImageState &usage) const;
+
+        void add_attachment(uint32_t pass, const Attachment &attachment);
+
+        void cull_passes();
+        void assign_levels();
+        void choose_store_ops();
+        void allocate_transients();
+        void build_barriers();
+        void build_inheritance();
+
+        void execute_rendering(const vk::raii::CommandBuffer &cmd, const Pass &pass) const;
+
+        void check_image(RenderGraphImage image) const;
+        void check_buffer(RenderGraphBuffer buffer) const;
+
+        std::shared_ptr<VulkanContext> m_Context;
+        RenderGraphResourcePool       *m_TransientPool;
+        bool                           m_Checking;
+
+        std::vector<Pass>           m_Passes;
+        std::vector<ImageResource>  m_Images;
+        std::vector<BufferResource> m_Buffers;
+
+        bool               m_Compiled = false;
+        std::vector<Level> m_Levels;
+        BarrierBatch       m_FinalBarriers;
+    };
+} // namespace engine
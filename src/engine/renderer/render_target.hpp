@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "engine/renderer/tracked_image.hpp"
+#include "engine/renderer/vulkan_context.hpp"
+
+namespace engine {
+    struct SyncInfo {
+        /**
+         * Signaled once `FrameInfo::image` may be written to. This is a null semaphore for targets which don't have to wait on anything (headless targets).
+         */
+        const vk::raii::Semaphore &image_available_semaphore;
+
+        /**
+         * Must be signaled by the frame's submission once rendering is done. This is a null semaphore for targets which don't consume it (headless targets).
+         */
+        const vk::raii::Semaphore &render_finished_semaphore;
+    };
+
+    struct FrameInfo {
+        vk::Image image;
+
+        /**
+         * A 2D view of all of `image`, for rendering straight into it.
+         */
+        vk::ImageView view;
+
+        /**
+         * Tracks the state of `image`. At the start of the frame it's known to be in an undefined layout and only usable after `RenderTarget::ACQUIRE_WAIT_STAGE`.
+         */
+        TrackedImage *tracked_image;
+
+        uint32_t  image_index;
+        uint32_t  frame_index;
+
+        vk::Extent2D      extent;
+        vk::Format        format;
+        vk::ColorSpaceKHR color_space;
+
+        /**
+         * The state `image` must be left in by the end of the frame's command buffer (present source for a swapchain, transfer source for a headless target).
+         */
+        ImageState final_state;
+
+        SyncInfo sync_info;
+    };
+
+    /**
+     * Something the application can render frames into. This is either a window's swapchain (`engine::Surface`) or a set of offscreen images (`engine::HeadlessSurface`).
+     */
+    class RenderTarget {
+      public:
+        static constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+        /**
+         * The stages which wait for `SyncInfo::image_available_semaphore`. The first barrier on a frame's image has to start from (one of) these stages so it chains onto the
+         * semaphore wait, which is why `FrameInfo::tracked_image` starts out as having been used by them.
+         */
+        static constexpr vk::PipelineStageFlags2 ACQUIRE_WAIT_STAGE = vk::PipelineStageFlagBits2::eColorAttachmentOutput | vk::PipelineStageFlagBits2::eTransfer;
+
+        virtual ~RenderTarget() = default;
+
+        virtual void recreate_swapchain() = 0;
+
+        /**
+         * How many frames the CPU may be ahead of the GPU by (each one has its own set of per-frame resources). `FrameInfo::frame_index` is always less than this.
+         */
+        [[nodiscard]] virtual uint32_t frames_in_flight() const = 0;
+
+        /**
+         * Change how many frames may be in flight. 1 gives the lowest latency, 3 gives the most throughput when the CPU and GPU times vary a lot. This waits for every frame in
+         * flight to finish, so don't call it every frame (and never between `begin_frame` and `end_frame`).
+         */
+        virtual void set_frames_in_flight(uint32_t count) = 0;
+
+        /**
+         * Called right before the application samples input for the next frame. Targets which can tell how far ahead of the display the CPU is block here to keep input
+         * latency down (see `engine::FramePacer`).
+         */
+        virtual void wait_for_input() {}
+
+        virtual FrameInfo begin_frame() = 0;
+
+        /**
+         * Called with the frame's command buffer after the application has finished recording into it (and before it is ended). Targets can use this to append their own work
+         * (for example, copying the image back to host memory).
+         */
+        virtual void record_frame_end(const vk::raii::CommandBuffer &cmd, const FrameInfo &frame_info) {}
+
+        /**
+         * @param timeline_value The value of the primary queue's timeline which is signaled once the frame's submission has finished. `begin_frame` waits for this before
+         * reusing the frame's resources.
+         */
+        virtual void end_frame(const FrameInfo &frame_info, uint64_t timeline_value) = 0;
+    };
+} // namespace engine
@@ -0,0 +1,62 @@
+#include "resource_state.hpp"
+
+namespace engine {
+    ResourceState ResourceState::from(const ImageState &state) {
+        ResourceState resource_state{.layout = state.layout};
+        if (state.access & WRITE_ACCESS_FLAGS) {
+            resource_state.write_stages = state.stage;
+            resource_state.write_access = state.access & WRITE_ACCESS_FLAGS;
+        } else {
+            resource_state.read_stages = state.stage;
+            resource_state.read_access = state.access;
+        }
+        return resource_state;
+    }
+
+    std::optional<ResourceState::Transition> ResourceState::transition(const ImageState &usage, const AccessKind kind) {
+        const bool writes        = kind != AccessKind::Read;
+        const bool discard       = kind == AccessKind::Write;
+        const bool layout_change = usage.layout != layout;
+
+        std::optional<Transition> result;
+        if (writes || layout_change) {
+            // Layout transitions are writes too, so both cases have to wait for every earlier access.
+            const auto src_stage = write_stages | read_stages;
+            if (layout_change || src_stage) {
+                result = Transition{
+                    .src_stage  = src_stage,
+                    .src_access = write_access,
+                    .old_layout = discard && layout_change ? vk::ImageLayout::eUndefined : layout,
+                };
+            }
+
+            layout = usage.layout;
+            if (writes) {
+                write_stages = usage.stage;
+                write_access = usage.access & WRITE_ACCESS_FLAGS;
+                read_stages  = {};
+                read_access  = {};
+            } else {
+                // The transition itself is a write which is only ordered before this reader's stages, so later readers from other stages have to chain onto it.
+                write_stages = usage.stage;
+                write_access = {};
+                read_stages  = usage.stage;
+                read_access  = usage.access;
+            }
+        } else {
+            const bool already_visible = !(usage.stage & ~read_stages) && !(usage.access & ~read_access);
+            if (write_stages && !already_visible) {
+                result = Transition{
+                    .src_stage  = write_stages,
+                    .src_access = write_access,
+                    .old_layout = layout,
+                };
+            }
+
+            read_stages |= usage.stage;
+            read_access |= usage.access;
+        }
+
+        return result;
+    }
+} // namespace engine
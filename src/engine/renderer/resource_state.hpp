@@ -0,0 +1,62 @@
+#pragma once
+
+#include <optional>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "engine/renderer/vulkan_context.hpp"
+
+namespace engine {
+    enum class AccessKind {
+        /**
+         * Reads the current contents.
+         */
+        Read,
+
+        /**
+         * Completely overwrites the contents (the previous contents may be discarded).
+         */
+        Write,
+
+        /**
+         * Reads and writes the contents (blending, load-op load, read-modify-write storage, ...).
+         */
+        Modify,
+    };
+
+    inline constexpr vk::AccessFlags2 WRITE_ACCESS_FLAGS = vk::AccessFlagBits2::eShaderWrite | vk::AccessFlagBits2::eShaderStorageWrite |
+                                                           vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eDepthStencilAttachmentWrite |
+                                                           vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eHostWrite | vk::AccessFlagBits2::eMemoryWrite;
+
+    /**
+     * What is known about a resource (or a single image subresource) at some point in a queue's timeline. Reads since the last write are tracked so that a later write waits
+     * for all of them, and so a read which the last write has already been made visible to doesn't need another barrier.
+     */
+    struct ResourceState {
+        struct Transition {
+            vk::PipelineStageFlags2 src_stage;
+            vk::AccessFlags2        src_access;
+            vk::ImageLayout         old_layout;
+
+            bool operator==(const Transition &other) const = default;
+        };
+
+        vk::ImageLayout         layout = vk::ImageLayout::eUndefined;
+        vk::PipelineStageFlags2 write_stages;
+        vk::AccessFlags2        write_access;
+        vk::PipelineStageFlags2 read_stages;
+        vk::AccessFlags2        read_access;
+
+        bool operator==(const ResourceState &other) const = default;
+
+        /**
+         * The state a resource is in right after being used as described by `state`.
+         */
+        static ResourceState from(const ImageState &state);
+
+        /**
+         * Move to `usage`, returning the source half of the barrier needed to get there (if any barrier is needed at all).
+         */
+        std::optional<Transition> transition(const ImageState &usage, AccessKind kind);
+    };
+} // namespace engine
@@ -1,5 +1,6 @@
 #include "surface.hpp"
 
+#include "engine/tools.hpp"
 #include "engine/window.hpp"
 
 namespace engine {
@@ -51,33 +52,77 @@ namespace engine {
         return formats[0];
     }
 
-    Surface::Surface(const std::shared_ptr<VulkanContext> &ctx, const Window *window) : m_Context(ctx), m_Window(window) {
+    Surface::Surface(const std::shared_ptr<VulkanContext> &ctx, const Window *window) : m_Context(ctx), m_Window(window), m_Pacer(ctx->supports_present_wait()) {
         m_Surface = window->create_surface_raw(ctx->instance());
         recreate_swapchain();
 
-        m_ImageAvailableSemaphores.reserve(MAX_FRAMES_IN_FLIGHT);
-        m_RenderFinishedSemaphores.reserve(MAX_FRAMES_IN_FLIGHT);
-        m_InFlightFences.reserve(MAX_FRAMES_IN_FLIGHT);
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        set_frames_in_flight(DEFAULT_FRAMES_IN_FLIGHT);
+    }
+
+    Surface::~Surface() {
+        if (m_Context) {
+            m_Context->device().waitIdle();
+            m_Context->deletion_queue().flush();
+        }
+    }
+
+    void Surface::set_frames_in_flight(const uint32_t count) {
+        if (count == 0) {
+            throw crash(CrashReason::CriticalFailure, "A surface needs at least one frame in flight.");
+        }
+
+        if (count == frames_in_flight()) {
+            return;
+        }
+
+        // Once every frame in flight has finished, every acquire semaphore has been waited on and can be destroyed.
+        for (const auto value : m_FrameTimelineValues) {
+            m_Context->timeline(DeviceQueue::Primary).wait(value);
+        }
+
+        m_ImageAvailableSemaphores.clear();
+        m_ImageAvailableSemaphores.reserve(count);
+        for (uint32_t i = 0; i < count; i++) {
             m_ImageAvailableSemaphores.emplace_back(m_Context->device(), vk::SemaphoreCreateInfo());
-            m_RenderFinishedSemaphores.emplace_back(m_Context->device(), vk::SemaphoreCreateInfo());
-            m_InFlightFences.emplace_back(m_Context->device(), vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled));
         }
+
+        m_FrameTimelineValues.assign(count, 0);
+        m_CurrentFrame = 0;
     }
 
-    void Surface::recreate_swapchain() {
-        m_Context->device().waitIdle();
+    void Surface::set_vsync(const bool vsync) {
+        if (vsync == m_Vsync) {
+            return;
+        }
+
+        m_Vsync = vsync;
+        recreate_swapchain();
+    }
 
+    void Surface::wait_for_input() {
+        m_Pacer.wait_for_input(m_Swapchain, m_Context->timeline(DeviceQueue::Primary), m_PresentMode == vk::PresentModeKHR::eFifo);
+    }
+
+    void Surface::set_image_count(const uint32_t count) {
+        if (count == m_RequestedImageCount) {
+            return;
+        }
+
+        m_RequestedImageCount = count;
+        recreate_swapchain();
+    }
+
+    void Surface::recreate_swapchain() {
         const auto present_modes   = m_Context->physical_device().getSurfacePresentModesKHR(*m_Surface);
         const auto surface_formats = m_Context->physical_device().getSurfaceFormatsKHR(*m_Surface);
         const auto capabilities    = m_Context->physical_device().getSurfaceCapabilitiesKHR(*m_Surface);
 
         m_Extent = clamp_extent(m_Window->get_inner_size(), capabilities.minImageExtent, capabilities.maxImageExtent);
 
-        m_PresentMode   = select_present_mode(present_modes, false);
+        m_PresentMode   = select_present_mode(present_modes, m_Vsync);
         m_SurfaceFormat = select_surface_format(surface_formats);
 
-        uint32_t min_image_count = capabilities.minImageCount + 1;
+        uint32_t min_image_count = m_RequestedImageCount == 0 ? capabilities.minImageCount + 1 : std::max(m_RequestedImageCount, capabilities.minImageCount);
         if (capabilities.maxImageCount > 0 && min_image_count > capabilities.maxImageCount) {
             min_image_count = capabilities.maxImageCount;
         }
@@ -112,38 +157,91 @@ namespace engine {
             //       mechanic using entt or just eventpp's callbacklist).
         }
 
-        m_Swapchain = vk::raii::SwapchainKHR(m_Context->device(), create_info);
-        m_Images    = m_Swapchain.getImages();
+        auto swapchain = vk::raii::SwapchainKHR(m_Context->device(), create_info);
+
+        // The old swapchain can't be destroyed right away (frames in flight may still be rendering into its images), but nothing else has to stop for it either. Presentation
+        // doesn't signal anything the timeline can see, so it also has to survive a full set of frames in flight.
+        if (m_Swapchain != nullptr) {
+            const uint32_t frames = std::max(frames_in_flight(), 1u);
+            m_Context->retire(std::move(m_ImageViews), DeviceQueue::Primary, frames);
+            m_Context->retire(std::move(m_Swapchain), DeviceQueue::Primary, frames);
+            m_Context->retire(std::move(m_RenderFinishedSemaphores), DeviceQueue::Primary, frames);
+        }
+
+        m_Swapchain = std::move(swapchain);
+        m_Pacer.reset();
+        m_Images = m_Swapchain.getImages();
+
+        m_RenderFinishedSemaphores.clear();
+        m_RenderFinishedSemaphores.reserve(m_Images.size());
+        for (size_t i = 0; i < m_Images.size(); i++) {
+            m_RenderFinishedSemaphores.emplace_back(m_Context->device(), vk::SemaphoreCreateInfo());
+        }
+
+        m_ImageViews.clear();
+        m_ImageViews.reserve(m_Images.size());
+        m_TrackedImages.clear();
+        m_TrackedImages.reserve(m_Images.size());
+        for (const auto image : m_Images) {
+            m_ImageViews.emplace_back(
+                m_Context->device(),
+                vk::ImageViewCreateInfo({}, image, vk::ImageViewType::e2D, m_SurfaceFormat.format, {}, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1))
+            );
+            m_TrackedImages.emplace_back(image, vk::ImageAspectFlagBits::eColor, 1, 1, create_info.imageSharingMode == vk::SharingMode::eConcurrent);
+        }
     }
 
-    FrameInfo Surface::begin_frame() const {
-        auto       _           = m_Context->device().waitForFences(*m_InFlightFences[m_CurrentFrame], true, UINT64_MAX);
+    FrameInfo Surface::begin_frame() {
+        m_Context->timeline(DeviceQueue::Primary).wait(m_FrameTimelineValues[m_CurrentFrame]);
         const auto image_index = m_Swapchain.acquireNextImage(UINT64_MAX, m_ImageAvailableSemaphores[m_CurrentFrame], nullptr).second;
-        m_Context->device().resetFences(*m_InFlightFences[m_CurrentFrame]);
+
+        // Whatever was in the image before it was presented is gone now, the only thing left to wait on is the acquire semaphore.
+        m_TrackedImages[image_index].reset(ImageState{
+            .layout = vk::ImageLayout::eUndefined,
+            .access = vk::AccessFlagBits2::eNone,
+            .stage  = ACQUIRE_WAIT_STAGE,
+            .owner  = VK_QUEUE_FAMILY_IGNORED,
+        });
 
         return {.image      = m_Images[image_index],
+                .view       = *m_ImageViews[image_index],
+                .tracked_image = &m_TrackedImages[image_index],
                 .image_index = image_index,
                 .frame_index = m_CurrentFrame,
                 .extent     = m_Extent,
                 .format     = m_SurfaceFormat.format,
                 .color_space = m_SurfaceFormat.colorSpace,
+                .final_state = ImageState{
+                    .layout = vk::ImageLayout::ePresentSrcKHR,
+                    .access = vk::AccessFlagBits2::eNone,
+                    .stage  = vk::PipelineStageFlagBits2::eBottomOfPipe,
+                    .owner  = VK_QUEUE_FAMILY_IGNORED,
+                },
                 .sync_info   = SyncInfo{
                       .image_available_semaphore = m_ImageAvailableSemaphores[m_CurrentFrame],
-                      .render_finished_semaphore = m_RenderFinishedSemaphores[m_CurrentFrame],
-                      .in_flight_fence           = m_InFlightFences[m_CurrentFrame],
+                      .render_finished_semaphore = m_RenderFinishedSemaphores[image_index],
                 }};
     }
 
-    void Surface::end_frame(const FrameInfo &frame_info) {
+    void Surface::end_frame(const FrameInfo &frame_info, const uint64_t timeline_value) {
+        m_FrameTimelineValues[m_CurrentFrame] = timeline_value;
+
+        // Advanced before presenting, so a present which throws (out of date) doesn't make the next frame wait for this one.
+        m_CurrentFrame = (m_CurrentFrame + 1) % frames_in_flight();
+
         vk::PresentInfoKHR present_info{};
         present_info.setSwapchains(*m_Swapchain);
-        present_info.setWaitSemaphores(*m_RenderFinishedSemaphores[m_CurrentFrame]);
+        present_info.setWaitSemaphores(*m_RenderFinishedSemaphores[frame_info.image_index]);
         present_info.setImageIndices(frame_info.image_index);
 
-        if (m_Context->queues().present.presentKHR(present_info) == vk::Result::eSuboptimalKHR) {
-            recreate_swapchain();
+        const uint64_t   present_id = m_Pacer.on_present(timeline_value);
+        vk::PresentIdKHR present_id_info(1, &present_id);
+        if (m_Context->supports_present_wait()) {
+            present_info.pNext = &present_id_info;
         }
 
-        m_CurrentFrame = (m_CurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        if (m_Context->present(present_info) == vk::Result::eSuboptimalKHR) {
+            recreate_swapchain();
+        }
     }
 } // namespace engine
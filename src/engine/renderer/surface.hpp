@@ -2,45 +2,58 @@
 
 #include <vulkan/vulkan_raii.hpp>
 
+#include "engine/renderer/frame_pacer.hpp"
+#include "engine/renderer/render_target.hpp"
 #include "engine/renderer/vulkan_context.hpp"
 
 namespace engine {
     class Window;
 
-    struct SyncInfo {
-        const vk::raii::Semaphore &image_available_semaphore;
-        const vk::raii::Semaphore &render_finished_semaphore;
-        const vk::raii::Fence &in_flight_fence;
-    };
-
-    struct FrameInfo {
-        vk::Image image;
-        uint32_t image_index;
-        uint32_t frame_index;
-
-        vk::Extent2D extent;
-        vk::Format format;
-        vk::ColorSpaceKHR color_space;
-
-        SyncInfo sync_info;
-    };
-
-    class Surface {
+    class Surface final : public RenderTarget {
     public:
-        static constexpr size_t MAX_FRAMES_IN_FLIGHT = 2;
-
         Surface(const std::shared_ptr<VulkanContext> &ctx, const Window *window);
 
+        /**
+         * Waits for the device to go idle, since old swapchains retired to the context's deletion queue have to be destroyed before the surface they belong to.
+         */
+        ~Surface() override;
+
         Surface(const Surface &other)                = delete;
         Surface(Surface &&other) noexcept            = default;
         Surface &operator=(const Surface &other)     = delete;
         Surface &operator=(Surface &&other) noexcept = default;
 
-        void recreate_swapchain();
+        void recreate_swapchain() override;
+
+        [[nodiscard]] inline uint32_t frames_in_flight() const override { return static_cast<uint32_t>(m_FrameTimelineValues.size()); }
 
-        FrameInfo begin_frame() const;
+        void set_frames_in_flight(uint32_t count) override;
 
-        void end_frame(const FrameInfo &frame_info);
+        /**
+         * How many images the swapchain actually has. This can differ from what was asked for with `set_image_count`, since the surface dictates the limits.
+         */
+        [[nodiscard]] inline uint32_t image_count() const { return static_cast<uint32_t>(m_Images.size()); }
+
+        /**
+         * Ask for a swapchain with `count` images (clamped to what the surface supports), recreating the swapchain if that changes anything. 0 means one more than the minimum
+         * the surface needs.
+         */
+        void set_image_count(uint32_t count);
+
+        [[nodiscard]] inline bool vsync() const { return m_Vsync; }
+
+        /**
+         * Switch between fifo presentation (vsync) and the lowest latency mode available (mailbox, then immediate). Recreates the swapchain if that changes anything.
+         */
+        void set_vsync(bool vsync);
+
+        [[nodiscard]] inline FramePacer &pacer() { return m_Pacer; }
+
+        void wait_for_input() override;
+
+        FrameInfo begin_frame() override;
+
+        void end_frame(const FrameInfo &frame_info, uint64_t timeline_value) override;
 
       private:
         std::shared_ptr<VulkanContext> m_Context;
@@ -53,12 +66,21 @@ namespace engine {
         vk::PresentModeKHR m_PresentMode;
         vk::Extent2D m_Extent;
 
-        std::vector<vk::Image> m_Images;
+        std::vector<vk::Image>           m_Images;
+        std::vector<vk::raii::ImageView> m_ImageViews;
+        std::vector<TrackedImage>        m_TrackedImages;
 
+        // Per frame in flight.
         std::vector<vk::raii::Semaphore> m_ImageAvailableSemaphores;
+        std::vector<uint64_t>            m_FrameTimelineValues;
+
+        // Per swapchain image, a present's wait is only known to be done once its image has been acquired again.
         std::vector<vk::raii::Semaphore> m_RenderFinishedSemaphores;
-        std::vector<vk::raii::Fence> m_InFlightFences;
 
-        uint32_t m_CurrentFrame = 0;
+        FramePacer m_Pacer;
+        bool       m_Vsync = false;
+
+        uint32_t m_RequestedImageCount = 0;
+        uint32_t m_CurrentFrame        = 0;
     };
 } // engine
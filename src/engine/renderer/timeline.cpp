@@ -0,0 +1,31 @@
+#include "timeline.hpp"
+
+namespace engine {
+    Timeline::Timeline(const vk::raii::Device &device, const uint64_t initial_value) : m_Device(&device), m_Submitted(initial_value), m_Completed(initial_value) {
+        vk::SemaphoreTypeCreateInfo type_info(vk::SemaphoreType::eTimeline, initial_value);
+        m_Semaphore = vk::raii::Semaphore(device, vk::SemaphoreCreateInfo({}, &type_info));
+    }
+
+    uint64_t Timeline::completed() const {
+        const uint64_t value = m_Semaphore.getCounterValue();
+
+        uint64_t cached = m_Completed.load(std::memory_order_relaxed);
+        while (cached < value && !m_Completed.compare_exchange_weak(cached, value, std::memory_order_release, std::memory_order_relaxed)) {}
+        return value;
+    }
+
+    bool Timeline::wait(const uint64_t value, const uint64_t timeout) const {
+        if (value <= m_Completed.load(std::memory_order_acquire)) {
+            return true;
+        }
+
+        const vk::Semaphore semaphore = *m_Semaphore;
+        if (m_Device->waitSemaphores(vk::SemaphoreWaitInfo({}, semaphore, value), timeout) == vk::Result::eTimeout) {
+            return false;
+        }
+
+        uint64_t cached = m_Completed.load(std::memory_order_relaxed);
+        while (cached < value && !m_Completed.compare_exchange_weak(cached, value, std::memory_order_release, std::memory_order_relaxed)) {}
+        return true;
+    }
+} // namespace engine
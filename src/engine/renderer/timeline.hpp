@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace engine {
+    /**
+     * A timeline semaphore along with the last value submitted for it. Every submission to a queue signals the next value of that queue's timeline (see
+     * `VulkanContext::submit`), so "has this work finished" is just a comparison against a single number, whether the question comes from the CPU, another queue, or something
+     * waiting to free a resource.
+     */
+    class Timeline {
+      public:
+        explicit Timeline(const vk::raii::Device &device, uint64_t initial_value = 0);
+
+        Timeline(const Timeline &other)                = delete;
+        Timeline(Timeline &&other) noexcept            = delete;
+        Timeline &operator=(const Timeline &other)     = delete;
+        Timeline &operator=(Timeline &&other) noexcept = delete;
+
+        [[nodiscard]] inline const vk::raii::Semaphore &semaphore() const { return m_Semaphore; }
+
+        /**
+         * The value the next submission will signal. Values must be signaled in order, so whoever submits has to keep anyone else from submitting until it has called
+         * `mark_submitted` (`VulkanContext::submit` holds the queue's lock).
+         */
+        [[nodiscard]] inline uint64_t next() const { return submitted() + 1; }
+
+        /**
+         * Record that a submission signaling `value` went through. Only called once it did, so a failed submission never leaves behind a value nothing will signal.
+         */
+        inline void mark_submitted(const uint64_t value) { m_Submitted.store(value, std::memory_order_release); }
+
+        /**
+         * The last value passed to `mark_submitted`. Waiting for this waits for everything submitted so far.
+         */
+        [[nodiscard]] inline uint64_t submitted() const { return m_Submitted.load(std::memory_order_acquire); }
+
+        /**
+         * The value the GPU has reached.
+         */
+        [[nodiscard]] uint64_t completed() const;
+
+        [[nodiscard]] inline bool reached(const uint64_t value) const { return value <= m_Completed.load(std::memory_order_acquire) || value <= completed(); }
+
+        /**
+         * Block until the GPU reaches `value`.
+         *
+         * @return False if `timeout` (in nanoseconds) ran out first.
+         */
+        bool wait(uint64_t value, uint64_t timeout = UINT64_MAX) const;
+
+        /**
+         * Wait for this timeline to reach `value` in a submission.
+         */
+        [[nodiscard]] inline vk::SemaphoreSubmitInfo wait_info(const uint64_t value, const vk::PipelineStageFlags2 stage) const { return {*m_Semaphore, value, stage}; }
+
+      private:
+        const vk::raii::Device *m_Device;
+        vk::raii::Semaphore     m_Semaphore = nullptr;
+
+        std::atomic<uint64_t> m_Submitted;
+
+        // Cache of the last value read back from the semaphore, so checking old values doesn't have to call into the driver.
+        mutable std::atomic<uint64_t> m_Completed;
+    };
+} // namespace engine
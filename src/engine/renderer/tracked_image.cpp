@@ -0,0 +1,135 @@
+#include "tracked_image.hpp"
+
+#include "engine/tools.hpp"
+
+#include <algorithm>
+
+namespace engine {
+    TrackedImage::TrackedImage(const vk::Image image, const vk::ImageAspectFlags aspect, const uint32_t mip_levels, const uint32_t array_layers, const bool concurrent)
+        : m_Image(image), m_Aspect(aspect), m_MipLevels(mip_levels), m_ArrayLayers(array_layers), m_Concurrent(concurrent),
+          m_States(static_cast<size_t>(mip_levels) * array_layers), m_Owners(static_cast<size_t>(mip_levels) * array_layers, VK_QUEUE_FAMILY_IGNORED) {}
+
+    vk::ImageSubresourceRange TrackedImage::resolve(const vk::ImageSubresourceRange &range) const {
+        vk::ImageSubresourceRange resolved = range;
+        if (resolved.levelCount == VK_REMAINING_MIP_LEVELS) {
+            resolved.levelCount = m_MipLevels - resolved.baseMipLevel;
+        }
+        if (resolved.layerCount == VK_REMAINING_ARRAY_LAYERS) {
+            resolved.layerCount = m_ArrayLayers - resolved.baseArrayLayer;
+        }
+        return resolved;
+    }
+
+    void TrackedImage::take_ownership(const size_t index, const AccessKind kind, const uint32_t queue_family) {
+        if (m_Concurrent || queue_family == VK_QUEUE_FAMILY_IGNORED) {
+            return;
+        }
+
+        if (m_Owners[index] != VK_QUEUE_FAMILY_IGNORED && m_Owners[index] != queue_family) {
+            if (kind != AccessKind::Write) {
+                throw crash(
+                    CrashReason::CriticalFailure,
+                    "Tracked image is owned by queue family " + std::to_string(m_Owners[index]) + " but its contents are needed on queue family " + std::to_string(queue_family) +
+                        " (release it from the owning queue first)."
+                );
+            }
+
+            // The contents aren't needed, so the new queue family can just take it without an ownership transfer.
+            m_States[index] = ResourceState{};
+        }
+
+        m_Owners[index] = queue_family;
+    }
+
+    void TrackedImage::use(BarrierBatch &batch, const vk::ImageSubresourceRange &range, const ImageState &usage, const AccessKind kind, const uint32_t queue_family) {
+        const auto resolved = resolve(range);
+
+        // Most of the time every subresource in the range is in the same state, in which case a single barrier covers all of them.
+        const size_t first   = index(resolved.baseMipLevel, resolved.baseArrayLayer);
+        bool         uniform = true;
+        for (uint32_t mip = resolved.baseMipLevel; mip < resolved.baseMipLevel + resolved.levelCount && uniform; mip++) {
+            for (uint32_t layer = resolved.baseArrayLayer; layer < resolved.baseArrayLayer + resolved.layerCount; layer++) {
+                const size_t i = index(mip, layer);
+                if (m_States[i] != m_States[first] || m_Owners[i] != m_Owners[first]) {
+                    uniform = false;
+                    break;
+                }
+            }
+        }
+
+        const auto emit = [&](const ResourceState::Transition &transition, const vk::ImageSubresourceRange &subresources) {
+            batch.image(vk::ImageMemoryBarrier2{
+                transition.src_stage,
+                transition.src_access,
+                usage.stage,
+                usage.access,
+                transition.old_layout,
+                usage.layout,
+                VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED,
+                m_Image,
+                subresources,
+            });
+        };
+
+        if (uniform) {
+            take_ownership(first, kind, queue_family);
+
+            ResourceState state      = m_States[first];
+            const auto    transition = state.transition(usage, kind);
+            if (transition.has_value()) {
+                emit(transition.value(), resolved);
+            }
+
+            for (uint32_t mip = resolved.baseMipLevel; mip < resolved.baseMipLevel + resolved.levelCount; mip++) {
+                for (uint32_t layer = resolved.baseArrayLayer; layer < resolved.baseArrayLayer + resolved.layerCount; layer++) {
+                    m_States[index(mip, layer)] = state;
+                    m_Owners[index(mip, layer)] = m_Owners[first];
+                }
+            }
+            return;
+        }
+
+        for (uint32_t mip = resolved.baseMipLevel; mip < resolved.baseMipLevel + resolved.levelCount; mip++) {
+            for (uint32_t layer = resolved.baseArrayLayer; layer < resolved.baseArrayLayer + resolved.layerCount; layer++) {
+                const size_t i = index(mip, layer);
+                take_ownership(i, kind, queue_family);
+
+                if (const auto transition = m_States[i].transition(usage, kind)) {
+                    emit(transition.value(), vk::ImageSubresourceRange(resolved.aspectMask, mip, 1, layer, 1));
+                }
+            }
+        }
+    }
+
+    void TrackedImage::reset(const ImageState &state) {
+        std::ranges::fill(m_States, ResourceState::from(state));
+        std::ranges::fill(m_Owners, VK_QUEUE_FAMILY_IGNORED);
+    }
+
+    void TrackedImage::set_state(const vk::ImageSubresourceRange &range, const ResourceState &state) {
+        const auto resolved = resolve(range);
+        for (uint32_t mip = resolved.baseMipLevel; mip < resolved.baseMipLevel + resolved.levelCount; mip++) {
+            for (uint32_t layer = resolved.baseArrayLayer; layer < resolved.baseArrayLayer + resolved.layerCount; layer++) {
+                m_States[index(mip, layer)] = state;
+            }
+        }
+    }
+
+    const ResourceState &TrackedImage::state(const uint32_t mip_level, const uint32_t array_layer) const {
+        return m_States[index(mip_level, array_layer)];
+    }
+
+    std::optional<ResourceState> TrackedImage::uniform_state(const vk::ImageSubresourceRange &range) const {
+        const auto  resolved = resolve(range);
+        const auto &first    = m_States[index(resolved.baseMipLevel, resolved.baseArrayLayer)];
+        for (uint32_t mip = resolved.baseMipLevel; mip < resolved.baseMipLevel + resolved.levelCount; mip++) {
+            for (uint32_t layer = resolved.baseArrayLayer; layer < resolved.baseArrayLayer + resolved.layerCount; layer++) {
+                if (m_States[index(mip, layer)] != first) {
+                    return std::nullopt;
+                }
+            }
+        }
+        return first;
+    }
+} // namespace engine
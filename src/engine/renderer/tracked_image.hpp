@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "engine/renderer/barrier_batch.hpp"
+#include "engine/renderer/resource_state.hpp"
+
+namespace engine {
+    /**
+     * An image which remembers the last known state of each of its subresources (layout, the accesses since the last write, and which queue family owns it), so callers only
+     * say how they're about to use it and get the minimal barrier for that. Nothing is emitted at all for a read of something which is already visible in the right layout.
+     *
+     * State is updated in recording order, so command buffers using the same tracked image must be submitted (to the same queue) in the order they were recorded in. Moving an
+     * exclusive image between queue families without discarding it requires an explicit release/acquire, `use` will refuse to silently do that.
+     */
+    class TrackedImage {
+      public:
+        TrackedImage(vk::Image image, vk::ImageAspectFlags aspect, uint32_t mip_levels = 1, uint32_t array_layers = 1, bool concurrent = false);
+
+        [[nodiscard]] inline vk::Image image() const { return m_Image; }
+
+        [[nodiscard]] inline vk::ImageSubresourceRange full_range() const { return {m_Aspect, 0, m_MipLevels, 0, m_ArrayLayers}; }
+
+        /**
+         * Add whatever barrier is needed to use `range` as described by `usage` to `batch`.
+         *
+         * @param queue_family The queue family the usage happens on. Only needed for exclusive images which are used on more than one queue family.
+         */
+        void use(BarrierBatch &batch, const vk::ImageSubresourceRange &range, const ImageState &usage, AccessKind kind, uint32_t queue_family = VK_QUEUE_FAMILY_IGNORED);
+
+        inline void use(BarrierBatch &batch, const ImageState &usage, const AccessKind kind, const uint32_t queue_family = VK_QUEUE_FAMILY_IGNORED) {
+            use(batch, full_range(), usage, kind, queue_family);
+        }
+
+        /**
+         * Forget everything known about the image (including which queue family owns it) and assume every subresource was last used as described by `state` (for example, after
+         * acquiring a swapchain image).
+         */
+        void reset(const ImageState &state);
+
+        /**
+         * Overwrite the tracked state of `range`. This is for things which do their own barrier tracking (like the render graph) to hand the final state back.
+         */
+        void set_state(const vk::ImageSubresourceRange &range, const ResourceState &state);
+
+        [[nodiscard]] const ResourceState &state(uint32_t mip_level, uint32_t array_layer) const;
+
+        /**
+         * The state shared by every subresource in `range`, or nothing if the subresources are in different states.
+         */
+        [[nodiscard]] std::optional<ResourceState> uniform_state(const vk::ImageSubresourceRange &range) const;
+
+      private:
+        [[nodiscard]] inline size_t index(const uint32_t mip_level, const uint32_t array_layer) const { return static_cast<size_t>(mip_level) * m_ArrayLayers + array_layer; }
+
+        [[nodiscard]] vk::ImageSubresourceRange resolve(const vk::ImageSubresourceRange &range) const;
+
+        void take_ownership(size_t index, AccessKind kind, uint32_t queue_family);
+
+        vk::Image            m_Image;
+        vk::ImageAspectFlags m_Aspect;
+        uint32_t             m_MipLevels;
+        uint32_t             m_ArrayLayers;
+        bool                 m_Concurrent;
+
+        std::vector<ResourceState> m_States;
+        std::vector<uint32_t>      m_Owners;
+    };
+} // namespace engine
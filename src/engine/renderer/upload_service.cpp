@@ -0,0 +1,320 @@
+#include "upload_service.hpp"
+
+#include "engine/tools.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace engine {
+    static uint64_t align_up(const uint64_t value, const uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    UploadService::UploadService(const std::shared_ptr<VulkanContext> &ctx, const vk::DeviceSize staging_size)
+        : m_Context(ctx), m_TransferQueue(ctx->resolve(DeviceQueue::Transfer)), m_TransferFamily(ctx->queue_family(DeviceQueue::Transfer)), m_StagingSize(staging_size) {
+        m_Staging = m_Context->allocator().create_buffer(
+            vk::BufferCreateInfo({}, m_StagingSize, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive), MemoryUsage::Upload
+        );
+        m_Mapped = m_Staging.allocation.mapped();
+
+        m_CommandPool = vk::raii::CommandPool(
+            m_Context->device(), vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer, m_TransferFamily)
+        );
+    }
+
+    UploadService::~UploadService() {
+        if (!m_InFlight.empty()) {
+            m_Context->timeline(m_TransferQueue).wait(m_InFlight.back().timeline_value);
+        }
+    }
+
+    UploadTicket UploadService::upload_buffer(const vk::Buffer buffer, const vk::DeviceSize offset, const std::span<const std::byte> data, const BufferState &dst_state, const DeviceQueue dst_queue) {
+        if (data.empty()) {
+            return {};
+        }
+
+        std::lock_guard lock(m_Mutex);
+
+        for (vk::DeviceSize copied = 0; copied < data.size();) {
+            const vk::DeviceSize size   = std::min<vk::DeviceSize>(data.size() - copied, m_StagingSize);
+            const vk::DeviceSize source = allocate(size, 4);
+            std::memcpy(m_Mapped + source, data.data() + copied, size);
+
+            recording().cmd.copyBuffer(*m_Staging.buffer, buffer, vk::BufferCopy(source, offset + copied, size));
+            copied += size;
+        }
+
+        hand_over(
+            dst_queue, std::nullopt,
+            vk::BufferMemoryBarrier2{
+                vk::PipelineStageFlagBits2::eCopy,
+                vk::AccessFlagBits2::eTransferWrite,
+                dst_state.stage,
+                dst_state.access,
+                VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED,
+                buffer,
+                offset,
+                data.size(),
+            }
+        );
+
+        return {recording().sequence};
+    }
+
+    UploadTicket UploadService::upload_image(
+        const vk::Image image, const vk::ImageSubresourceLayers &subresource, const vk::Extent3D extent, const std::span<const std::byte> data, const ImageState &final_state,
+        const DeviceQueue dst_queue
+    ) {
+        if (data.empty()) {
+            return {};
+        }
+
+        if (data.size() > m_StagingSize) {
+            throw crash(CrashReason::CriticalFailure, "Image upload of " + std::to_string(data.size()) + " bytes doesn't fit in the staging ring.");
+        }
+
+        std::lock_guard lock(m_Mutex);
+
+        // 16 covers the texel size of every uncompressed format and the block size of every compressed one, along with the 4 byte alignment copies need anyway.
+        const vk::DeviceSize source = allocate(data.size(), 16);
+        std::memcpy(m_Mapped + source, data.data(), data.size());
+
+        const vk::ImageSubresourceRange range(subresource.aspectMask, subresource.mipLevel, 1, subresource.baseArrayLayer, subresource.layerCount);
+
+        const auto &cmd = recording().cmd;
+
+        BarrierBatch to_transfer;
+        to_transfer.image(
+            image, range, ImageState{vk::ImageLayout::eUndefined, vk::AccessFlagBits2::eNone, vk::PipelineStageFlagBits2::eNone, VK_QUEUE_FAMILY_IGNORED},
+            ImageState{vk::ImageLayout::eTransferDstOptimal, vk::AccessFlagBits2::eTransferWrite, vk::PipelineStageFlagBits2::eCopy, VK_QUEUE_FAMILY_IGNORED}
+        );
+        to_transfer.flush(cmd);
+
+        cmd.copyBufferToImage(*m_Staging.buffer, image, vk::ImageLayout::eTransferDstOptimal, vk::BufferImageCopy(source, 0, 0, subresource, vk::Offset3D(0, 0, 0), extent));
+
+        hand_over(
+            dst_queue,
+            vk::ImageMemoryBarrier2{
+                vk::PipelineStageFlagBits2::eCopy,
+                vk::AccessFlagBits2::eTransferWrite,
+                final_state.stage,
+                final_state.access,
+                vk::ImageLayout::eTransferDstOptimal,
+                final_state.layout,
+                VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED,
+                image,
+                range,
+            },
+            std::nullopt
+        );
+
+        return {recording().sequence};
+    }
+
+    void UploadService::hand_over(const DeviceQueue dst_queue, const std::optional<vk::ImageMemoryBarrier2> &image, const std::optional<vk::BufferMemoryBarrier2> &buffer) {
+        const uint32_t dst_family = m_Context->queue_family(dst_queue);
+        auto          &batch      = recording();
+
+        BarrierBatch   release;
+        PendingAcquire acquire{.batch = batch.sequence};
+
+        if (dst_family == m_TransferFamily) {
+            // No ownership transfer, the whole barrier goes in the batch. Submission order (or the timeline wait when it's a different queue) covers the rest.
+            if (image) {
+                release.image(*image);
+            }
+            if (buffer) {
+                release.buffer(*buffer);
+            }
+        } else {
+            // The release only has the source half of the barrier and the acquire only has the destination half. Layout transitions have to match exactly on both sides.
+            if (image) {
+                auto released                = *image;
+                released.dstStageMask        = vk::PipelineStageFlagBits2::eNone;
+                released.dstAccessMask       = vk::AccessFlagBits2::eNone;
+                released.srcQueueFamilyIndex = m_TransferFamily;
+                released.dstQueueFamilyIndex = dst_family;
+                release.image(released);
+
+                auto acquired                = *image;
+                acquired.srcStageMask        = vk::PipelineStageFlagBits2::eNone;
+                acquired.srcAccessMask       = vk::AccessFlagBits2::eNone;
+                acquired.srcQueueFamilyIndex = m_TransferFamily;
+                acquired.dstQueueFamilyIndex = dst_family;
+                acquire.image                = acquired;
+            }
+            if (buffer) {
+                auto released                = *buffer;
+                released.dstStageMask        = vk::PipelineStageFlagBits2::eNone;
+                released.dstAccessMask       = vk::AccessFlagBits2::eNone;
+                released.srcQueueFamilyIndex = m_TransferFamily;
+                released.dstQueueFamilyIndex = dst_family;
+                release.buffer(released);
+
+                auto acquired                = *buffer;
+                acquired.srcStageMask        = vk::PipelineStageFlagBits2::eNone;
+                acquired.srcAccessMask       = vk::AccessFlagBits2::eNone;
+                acquired.srcQueueFamilyIndex = m_TransferFamily;
+                acquired.dstQueueFamilyIndex = dst_family;
+                acquire.buffer               = acquired;
+            }
+        }
+
+        release.flush(batch.cmd);
+
+        // Even without an acquire barrier another queue still has to wait on the transfer timeline before using the upload.
+        if (m_Context->resolve(dst_queue) != m_TransferQueue) {
+            queue_state(dst_queue).acquires.push_back(std::move(acquire));
+        }
+    }
+
+    void UploadService::flush() {
+        std::lock_guard lock(m_Mutex);
+        if (m_Recording.has_value()) {
+            submit_recording();
+        }
+    }
+
+    std::optional<vk::SemaphoreSubmitInfo> UploadService::acquire(const vk::raii::CommandBuffer &cmd, const DeviceQueue queue) {
+        if (m_Context->resolve(queue) == m_TransferQueue) {
+            return std::nullopt;
+        }
+
+        std::lock_guard lock(m_Mutex);
+        collect();
+
+        auto &state = queue_state(queue);
+
+        BarrierBatch barriers;
+        bool         any = false;
+        std::erase_if(state.acquires, [&](const PendingAcquire &pending) {
+            if (pending.batch > m_CompletedBatch) {
+                return false;
+            }
+
+            if (pending.image.has_value()) {
+                barriers.image(pending.image.value());
+            }
+            if (pending.buffer.has_value()) {
+                barriers.buffer(pending.buffer.value());
+            }
+            any = true;
+            return true;
+        });
+
+        state.acquired_batch = m_CompletedBatch;
+        if (!any) {
+            return std::nullopt;
+        }
+
+        barriers.flush(cmd);
+
+        // The value has already been reached, so this never actually waits. It's what makes the transfer queue's writes visible to this queue.
+        return m_Context->timeline(m_TransferQueue).wait_info(m_CompletedValue, vk::PipelineStageFlagBits2::eAllCommands);
+    }
+
+    bool UploadService::ready(const UploadTicket ticket, const DeviceQueue queue) const {
+        std::lock_guard lock(m_Mutex);
+        if (m_Context->resolve(queue) == m_TransferQueue) {
+            return ticket.batch <= m_SubmittedBatch;
+        }
+        return ticket.batch <= m_Queues[static_cast<size_t>(m_Context->resolve(queue))].acquired_batch;
+    }
+
+    void UploadService::wait(const UploadTicket ticket) {
+        uint64_t value = 0;
+        {
+            std::lock_guard lock(m_Mutex);
+            if (ticket.batch <= m_CompletedBatch) {
+                return;
+            }
+
+            if (ticket.batch > m_SubmittedBatch) {
+                submit_recording();
+            }
+
+            const auto batch = std::ranges::find(m_InFlight, ticket.batch, &Batch::sequence);
+            value            = batch->timeline_value;
+        }
+
+        m_Context->timeline(m_TransferQueue).wait(value);
+    }
+
+    vk::DeviceSize UploadService::allocate(const vk::DeviceSize size, const vk::DeviceSize alignment) {
+        while (true) {
+            uint64_t start = align_up(m_Head, alignment);
+            if (start / m_StagingSize != (start + size - 1) / m_StagingSize) {
+                // Copies can't wrap around the end of the buffer, so the rest of this lap is skipped.
+                start = align_up(start, m_StagingSize);
+            }
+
+            if (start + size - m_Tail <= m_StagingSize) {
+                m_Head = start + size;
+                return start % m_StagingSize;
+            }
+
+            collect();
+            if (start + size - m_Tail <= m_StagingSize) {
+                continue;
+            }
+
+            if (m_InFlight.empty()) {
+                // Everything still in use belongs to the batch being recorded, so it has to go out before anything can be freed.
+                submit_recording();
+            }
+
+            m_Context->timeline(m_TransferQueue).wait(m_InFlight.front().timeline_value);
+        }
+    }
+
+    UploadService::Batch &UploadService::recording() {
+        if (m_Recording.has_value()) {
+            return m_Recording.value();
+        }
+
+        Batch batch{.sequence = m_NextBatch++};
+        if (m_FreeCommandBuffers.empty()) {
+            batch.cmd = std::move(m_Context->device().allocateCommandBuffers(vk::CommandBufferAllocateInfo(*m_CommandPool, vk::CommandBufferLevel::ePrimary, 1)).front());
+        } else {
+            batch.cmd = std::move(m_FreeCommandBuffers.back());
+            m_FreeCommandBuffers.pop_back();
+            batch.cmd.reset();
+        }
+
+        batch.cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        return m_Recording.emplace(std::move(batch));
+    }
+
+    void UploadService::submit_recording() {
+        auto batch = std::move(m_Recording.value());
+        m_Recording.reset();
+
+        batch.cmd.end();
+
+        const vk::CommandBufferSubmitInfo cbsi{*batch.cmd, 0};
+        batch.timeline_value = m_Context->submit(m_TransferQueue, cbsi);
+        batch.staging_end    = m_Head;
+        m_SubmittedBatch     = batch.sequence;
+        m_InFlight.push_back(std::move(batch));
+    }
+
+    void UploadService::collect() {
+        const auto &timeline = m_Context->timeline(m_TransferQueue);
+        while (!m_InFlight.empty() && timeline.reached(m_InFlight.front().timeline_value)) {
+            auto &batch = m_InFlight.front();
+
+            m_Tail           = batch.staging_end;
+            m_CompletedBatch = batch.sequence;
+            m_CompletedValue = batch.timeline_value;
+            m_FreeCommandBuffers.push_back(std::move(batch.cmd));
+            m_InFlight.pop_front();
+        }
+
+        if (m_InFlight.empty() && !m_Recording.has_value()) {
+            // Nothing is using the ring, so the next upload may as well start at the beginning of the buffer.
+            m_Tail = m_Head = align_up(m_Head, m_StagingSize);
+        }
+    }
+} // namespace engine
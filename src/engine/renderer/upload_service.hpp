@@ -0,0 +1,172 @@
+#pragma once
+
+#include <array>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "engine/renderer/barrier_batch.hpp"
+#include "engine/renderer/vulkan_context.hpp"
+
+namespace engine {
+    /**
+     * Identifies the batch an upload went out in. A default constructed ticket refers to nothing and is always ready.
+     */
+    struct UploadTicket {
+        uint64_t batch = 0;
+    };
+
+    /**
+     * Streams buffer and image data to the GPU on the transfer queue, so uploads don't compete with frames on the primary queue.
+     *
+     * Data is copied into a persistently mapped staging ring, and copies are recorded into a batch which goes out on the next `flush` (the application flushes once per frame).
+     * Each batch signals the transfer queue's timeline, and its part of the staging ring is reused once that value is reached. If the ring is full, uploading blocks until an
+     * earlier batch finishes.
+     *
+     * When the transfer queue is in a different queue family than the queue a resource is used on, the batch releases the resource and the destination queue has to acquire
+     * it: `acquire` records the acquire barriers for every upload whose batch has finished into a command buffer for that queue, and returns the timeline wait its submission
+     * needs. Batches which haven't finished yet are left for a later `acquire`, so frames never wait on uploads which are still going.
+     *
+     * Every function is safe to call from any thread.
+     */
+    class UploadService {
+      public:
+        static constexpr vk::DeviceSize DEFAULT_STAGING_SIZE = 32 * 1024 * 1024;
+
+        explicit UploadService(const std::shared_ptr<VulkanContext> &ctx, vk::DeviceSize staging_size = DEFAULT_STAGING_SIZE);
+
+        /**
+         * Waits for every batch which was submitted, the staging ring can't go away while they still read from it.
+         */
+        ~UploadService();
+
+        UploadService(const UploadService &other)                = delete;
+        UploadService(UploadService &&other) noexcept            = delete;
+        UploadService &operator=(const UploadService &other)     = delete;
+        UploadService &operator=(UploadService &&other) noexcept = delete;
+
+        /**
+         * Copy `data` into `buffer` at `offset`. Uploads bigger than the staging ring are split up.
+         *
+         * The copy happens on the transfer queue, with nothing ordering it against other queues' use of the buffer except the acquire. So the buffer must not be owned by (or
+         * in use on) another queue family when this is called: don't upload into part of an exclusive buffer which `dst_queue` already acquired, and don't upload into
+         * anything the GPU may still be reading. Buffers which are updated while in use should be updated on the queue using them instead.
+         *
+         * @param dst_state How the buffer is used once the upload is ready.
+         * @param dst_queue The queue the buffer is used on.
+         */
+        UploadTicket upload_buffer(vk::Buffer buffer, vk::DeviceSize offset, std::span<const std::byte> data, const BufferState &dst_state, DeviceQueue dst_queue = DeviceQueue::Primary);
+
+        /**
+         * Copy tightly packed texels into `subresource` of `image`, discarding its previous contents. Once ready the subresource is in `final_state.layout` and owned by
+         * `dst_queue`'s family. The data has to fit in the staging ring.
+         *
+         * @param extent Should be the whole mip level unless the transfer queue's image transfer granularity is known to allow otherwise.
+         */
+        UploadTicket upload_image(
+            vk::Image image, const vk::ImageSubresourceLayers &subresource, vk::Extent3D extent, std::span<const std::byte> data, const ImageState &final_state,
+            DeviceQueue dst_queue = DeviceQueue::Primary
+        );
+
+        /**
+         * Submit everything uploaded since the last flush.
+         */
+        void flush();
+
+        /**
+         * Record the acquire side of every finished upload to `queue` into `cmd`.
+         *
+         * @return A wait on the transfer timeline which the submission containing `cmd` has to include, or nothing if it doesn't need one.
+         */
+        [[nodiscard]] std::optional<vk::SemaphoreSubmitInfo> acquire(const vk::raii::CommandBuffer &cmd, DeviceQueue queue);
+
+        /**
+         * Whether the upload can be used by commands recorded on `queue` from now on (after an `acquire` for that queue, or after a flush when `queue` is the transfer queue
+         * itself).
+         */
+        [[nodiscard]] bool ready(UploadTicket ticket, DeviceQueue queue = DeviceQueue::Primary) const;
+
+        /**
+         * Flush if needed and block until the upload's batch has finished on the transfer queue. It still has to be acquired before it's `ready`.
+         */
+        void wait(UploadTicket ticket);
+
+      private:
+        struct Batch {
+            vk::raii::CommandBuffer cmd = nullptr;
+            uint64_t                sequence;
+            uint64_t                timeline_value = 0;
+
+            // Where the staging ring's head was when the batch was submitted. Everything before this is free once the batch finishes.
+            uint64_t staging_end = 0;
+        };
+
+        struct PendingAcquire {
+            uint64_t                                batch;
+            std::optional<vk::ImageMemoryBarrier2>  image;
+            std::optional<vk::BufferMemoryBarrier2> buffer;
+        };
+
+        struct QueueState {
+            std::vector<PendingAcquire> acquires;
+            uint64_t                    acquired_batch = 0;
+        };
+
+        /**
+         * Reserve `size` bytes of the staging ring, waiting for (or submitting) batches if it's full.
+         *
+         * @return The offset of the reservation in the staging buffer.
+         */
+        vk::DeviceSize allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+
+        /**
+         * The batch currently being recorded, begun if there isn't one.
+         */
+        Batch &recording();
+
+        void submit_recording();
+
+        /**
+         * Retire finished batches, freeing their part of the staging ring.
+         */
+        void collect();
+
+        /**
+         * Barriers which hand a resource uploaded in the current batch over to `dst_queue` (a release in the batch itself, and the acquire to record later).
+         */
+        void hand_over(DeviceQueue dst_queue, const std::optional<vk::ImageMemoryBarrier2> &image, const std::optional<vk::BufferMemoryBarrier2> &buffer);
+
+        [[nodiscard]] inline QueueState &queue_state(const DeviceQueue queue) { return m_Queues[static_cast<size_t>(m_Context->resolve(queue))]; }
+
+        std::shared_ptr<VulkanContext> m_Context;
+        DeviceQueue                    m_TransferQueue;
+        uint32_t                       m_TransferFamily;
+
+        mutable std::mutex m_Mutex;
+
+        AllocatedBuffer m_Staging;
+        std::byte      *m_Mapped = nullptr;
+        vk::DeviceSize  m_StagingSize;
+
+        // Positions in the staging ring only ever grow, the offset in the buffer is the position modulo the ring's size.
+        uint64_t m_Head = 0;
+        uint64_t m_Tail = 0;
+
+        vk::raii::CommandPool                m_CommandPool = nullptr;
+        std::vector<vk::raii::CommandBuffer> m_FreeCommandBuffers;
+
+        std::optional<Batch> m_Recording;
+        std::deque<Batch>    m_InFlight;
+        uint64_t             m_NextBatch      = 1;
+        uint64_t             m_SubmittedBatch = 0;
+        uint64_t             m_CompletedBatch = 0;
+        uint64_t             m_CompletedValue = 0;
+
+        std::array<QueueState, DEVICE_QUEUE_COUNT> m_Queues;
+    };
+} // namespace engine
@@ -1,10 +1,13 @@
 #include "vulkan_context.hpp"
 
 #include "engine/engine_context.hpp"
+#include "engine/renderer/device_selector.hpp"
 #include "engine/tools.hpp"
 
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+
 #include <spdlog/spdlog.h>
 
 #if VULKAN_HPP_DISPATCH_LOADER_DYNAMIC == 1
@@ -15,17 +18,28 @@ VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE;
 
 namespace engine {
     VulkanContext::VulkanContext(const std::shared_ptr<EngineContext> &engine_context) : m_EngineContext(engine_context) {
-        VULKAN_HPP_DEFAULT_DISPATCHER.init(glfwGetInstanceProcAddress);
+        const bool headless = engine_context->settings().headless;
+
+        if (headless) {
+            // GLFW is never initialized in headless mode, so the loader has to come from the raii context instead.
+            VULKAN_HPP_DEFAULT_DISPATCHER.init(m_Context.getDispatcher()->vkGetInstanceProcAddr);
+        } else {
+            VULKAN_HPP_DEFAULT_DISPATCHER.init(glfwGetInstanceProcAddress);
+        }
+
         {
             vk::ApplicationInfo appInfo{};
             appInfo.apiVersion = vk::ApiVersion14;
 
-            uint32_t     count;
-            const char **required_instance_extensions = glfwGetRequiredInstanceExtensions(&count);
-
-            std::vector<const char *> instance_extensions(required_instance_extensions, required_instance_extensions + count);
+            std::vector<const char *> instance_extensions;
             std::vector<const char *> instance_layers;
 
+            if (!headless) {
+                uint32_t     count;
+                const char **required_instance_extensions = glfwGetRequiredInstanceExtensions(&count);
+                instance_extensions.assign(required_instance_extensions, required_instance_extensions + count);
+            }
+
             if (engine_context->debug_settings().enable_graphics_api_validation) {
                 instance_layers.push_back("VK_LAYER_KHRONOS_validation");
                 instance_extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -39,47 +53,29 @@ namespace engine {
             VULKAN_HPP_DEFAULT_DISPATCHER.init(*m_Instance);
         }
 
-        auto physical_devices = vk::raii::PhysicalDevices(m_Instance);
-        m_PhysicalDevice      = physical_devices[0]; // TODO: non-naive physical device selection
+        // Presentation support is checked against a dummy window's surface, both when picking the device and when picking queue families.
+        std::unique_ptr<Window> dummy_window;
+        vk::raii::SurfaceKHR    surface = nullptr;
+        if (!headless) {
+            dummy_window = m_EngineContext.lock()->create_dummy_window();
+            surface      = dummy_window->create_surface_raw(m_Instance);
+        }
 
         {
-            std::vector<const char *> device_extensions = {
-                VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-            };
-
-            vk::PhysicalDeviceFeatures2        f2{};
-            vk::PhysicalDeviceVulkan11Features v11f{};
-            vk::PhysicalDeviceVulkan12Features v12f{};
-            vk::PhysicalDeviceVulkan13Features v13f{};
-            vk::PhysicalDeviceVulkan14Features v14f{};
-
-            f2.pNext   = &v11f;
-            v11f.pNext = &v12f;
-            v12f.pNext = &v13f;
-            v13f.pNext = &v14f;
-
-            f2.features.geometryShader     = true;
-            f2.features.tessellationShader = true;
-            f2.features.multiDrawIndirect  = true;
-            f2.features.fillModeNonSolid   = true;
-            f2.features.largePoints        = true;
-            f2.features.wideLines          = true;
-
-            v12f.drawIndirectCount      = true;
-            v12f.runtimeDescriptorArray = true;
-
-            v13f.synchronization2 = true;
-            v13f.dynamicRendering = true;
+            // Selection only returns devices which meet every requirement, so its capabilities are used as they are.
+            auto selection   = select_physical_device(m_Instance, surface, engine_context->settings().cache_directory / "device.txt");
+            m_PhysicalDevice = std::move(selection.device);
+            m_Capabilities   = std::move(selection.info.capabilities);
+            spdlog::info("Using {} ({}){}.", selection.info.name, vk::to_string(selection.info.type), selection.from_cache ? " (remembered from the last launch)" : "");
+        }
 
-            v14f.pushDescriptor = true;
+        {
+            const DeviceFeatureChain features(m_Capabilities, !headless);
 
             bool     selected_graphics_family = false;
             bool     selected_present_family  = false;
             uint32_t index                    = 0;
 
-            auto dummy_window = m_EngineContext.lock()->create_dummy_window();
-            auto surface      = dummy_window->create_surface_raw(m_Instance);
-
             auto queueFamilyProperties = m_PhysicalDevice.getQueueFamilyProperties();
             for (const auto &props : queueFamilyProperties) {
                 if (!selected_graphics_family && props.queueFlags & vk::QueueFlagBits::eGraphics) {
@@ -87,7 +83,7 @@ namespace engine {
                     m_PrimaryQueueFamily     = index;
                 }
 
-                if (!selected_present_family && m_PhysicalDevice.getSurfaceSupportKHR(index, *surface)) {
+                if (!headless && !selected_present_family && m_PhysicalDevice.getSurfaceSupportKHR(index, *surface)) {
                     selected_present_family   = true;
                     m_PresentationQueueFamily = index;
                 }
@@ -108,12 +104,15 @@ namespace engine {
                 throw crash(CrashReason::CriticalFailure, "No graphics queue family available (likely a broken vulkan driver).");
             }
 
+            if (headless) {
+                // Nothing is ever presented, so just pretend the primary family can present to keep the rest of the engine simple.
+                selected_present_family   = true;
+                m_PresentationQueueFamily = m_PrimaryQueueFamily;
+            }
+
             if (!selected_present_family) {
+                // Device selection already checks this against the same surface, so this only happens with a broken driver.
                 throw crash(CrashReason::CriticalFailure, "No queue family supports presentation.");
-                /* TODO: mitigate the possibility of this occurring by not using a naive gpu selection method (we can
-                 *       do this check for presentation support when selecting physical device instead which should
-                 *       prevent us from ever seeing this error).
-                 */
             }
 
             bool primary_doesnt_present = m_PrimaryQueueFamily != m_PresentationQueueFamily;
@@ -141,7 +140,7 @@ namespace engine {
                 queue_create_infos.emplace_back(vk::DeviceQueueCreateFlags{}, m_ExclusiveComputeQueueFamily.value(), compute_queue_count, queue_priorities.data());
             }
 
-            m_Device = vk::raii::Device(m_PhysicalDevice, vk::DeviceCreateInfo({}, queue_create_infos, {}, device_extensions, nullptr, &f2));
+            m_Device = vk::raii::Device(m_PhysicalDevice, vk::DeviceCreateInfo({}, queue_create_infos, {}, features.extensions(), nullptr, &features.features()));
             VULKAN_HPP_DEFAULT_DISPATCHER.init(*m_Device);
 
             m_Queues.primary.main = m_Device.getQueue(m_PrimaryQueueFamily, 0);
@@ -164,9 +163,117 @@ namespace engine {
                     m_Queues.exclusiveCompute->lowPriority = m_Device.getQueue(m_ExclusiveComputeQueueFamily.value(), 1);
                 }
             }
+
+            for (size_t i = 0; i < DEVICE_QUEUE_COUNT; i++) {
+                if (resolve(static_cast<DeviceQueue>(i)) == static_cast<DeviceQueue>(i)) {
+                    m_QueueSync[i] = std::make_unique<QueueSync>(m_Device);
+                }
+            }
+
+            m_Allocator     = std::make_unique<MemoryAllocator>(m_PhysicalDevice, m_Device, m_Capabilities.memory_budget);
+            m_DeletionQueue = std::make_unique<DeletionQueue>();
+            m_PipelineCache = std::make_unique<PipelineCache>(m_PhysicalDevice, m_Device, engine_context->settings().cache_directory / "pipelines.bin");
+        }
+    }
+
+    DeviceQueue VulkanContext::resolve(const DeviceQueue queue) const {
+        switch (queue) {
+        case DeviceQueue::Primary:
+            return DeviceQueue::Primary;
+        case DeviceQueue::PrimaryLowPriority:
+            return m_Queues.primary.lowPriority.has_value() ? DeviceQueue::PrimaryLowPriority : DeviceQueue::Primary;
+        case DeviceQueue::Present:
+            // The present queue is queue 0 of its family, which is the primary queue when they share a family.
+            return are_present_render_shared() ? DeviceQueue::Primary : DeviceQueue::Present;
+        case DeviceQueue::Transfer:
+            return m_Queues.exclusiveTransfer.has_value() ? DeviceQueue::Transfer : DeviceQueue::Primary;
+        case DeviceQueue::TransferLowPriority:
+            if (m_Queues.exclusiveTransfer.has_value()) {
+                return m_Queues.exclusiveTransfer->lowPriority.has_value() ? DeviceQueue::TransferLowPriority : DeviceQueue::Transfer;
+            }
+            return resolve(DeviceQueue::PrimaryLowPriority);
+        case DeviceQueue::Compute:
+            return m_Queues.exclusiveCompute.has_value() ? DeviceQueue::Compute : DeviceQueue::Primary;
+        case DeviceQueue::ComputeLowPriority:
+            if (m_Queues.exclusiveCompute.has_value()) {
+                return m_Queues.exclusiveCompute->lowPriority.has_value() ? DeviceQueue::ComputeLowPriority : DeviceQueue::Compute;
+            }
+            return resolve(DeviceQueue::PrimaryLowPriority);
+        }
+
+        return DeviceQueue::Primary;
+    }
+
+    const vk::raii::Queue &VulkanContext::queue(const DeviceQueue queue) const {
+        switch (resolve(queue)) {
+        case DeviceQueue::PrimaryLowPriority:
+            return m_Queues.primary.lowPriority.value();
+        case DeviceQueue::Present:
+            return m_Queues.present;
+        case DeviceQueue::Transfer:
+            return m_Queues.exclusiveTransfer->main;
+        case DeviceQueue::TransferLowPriority:
+            return m_Queues.exclusiveTransfer->lowPriority.value();
+        case DeviceQueue::Compute:
+            return m_Queues.exclusiveCompute->main;
+        case DeviceQueue::ComputeLowPriority:
+            return m_Queues.exclusiveCompute->lowPriority.value();
+        case DeviceQueue::Primary:
+        default:
+            return m_Queues.primary.main;
         }
     }
 
+    uint32_t VulkanContext::queue_family(const DeviceQueue queue) const {
+        switch (resolve(queue)) {
+        case DeviceQueue::Present:
+            return m_PresentationQueueFamily;
+        case DeviceQueue::Transfer:
+        case DeviceQueue::TransferLowPriority:
+            return m_ExclusiveTransferQueueFamily.value();
+        case DeviceQueue::Compute:
+        case DeviceQueue::ComputeLowPriority:
+            return m_ExclusiveComputeQueueFamily.value();
+        default:
+            return m_PrimaryQueueFamily;
+        }
+    }
+
+    Timeline &VulkanContext::timeline(const DeviceQueue queue) const {
+        return m_QueueSync[static_cast<size_t>(resolve(queue))]->timeline;
+    }
+
+    uint64_t VulkanContext::submit(
+        const DeviceQueue queue, const vk::ArrayProxy<const vk::CommandBufferSubmitInfo> command_buffers, const vk::ArrayProxy<const vk::SemaphoreSubmitInfo> waits,
+        const vk::ArrayProxy<const vk::SemaphoreSubmitInfo> signals
+    ) const {
+        auto &sync = *m_QueueSync[static_cast<size_t>(resolve(queue))];
+
+        std::vector<vk::SemaphoreSubmitInfo> all_signals(signals.begin(), signals.end());
+
+        // Picking the value under the lock keeps values in submission order. It only counts as submitted once `submit2` returns, so waiting on `submitted()` can't hang
+        // on a value that a failed submission will never signal.
+        std::lock_guard lock(sync.mutex);
+        const uint64_t  value = sync.timeline.next();
+        all_signals.emplace_back(*sync.timeline.semaphore(), value, vk::PipelineStageFlagBits2::eAllCommands);
+
+        vk::SubmitInfo2 submit_info{};
+        submit_info.waitSemaphoreInfoCount = waits.size();
+        submit_info.pWaitSemaphoreInfos    = waits.data();
+        submit_info.commandBufferInfoCount = command_buffers.size();
+        submit_info.pCommandBufferInfos    = command_buffers.data();
+        submit_info.setSignalSemaphoreInfos(all_signals);
+        this->queue(queue).submit2(submit_info);
+        sync.timeline.mark_submitted(value);
+
+        return value;
+    }
+
+    vk::Result VulkanContext::present(const vk::PresentInfoKHR &present_info) const {
+        std::lock_guard lock(m_QueueSync[static_cast<size_t>(resolve(DeviceQueue::Present))]->mutex);
+        return m_Queues.present.presentKHR(present_info);
+    }
+
     void transition_image(const vk::raii::CommandBuffer &cmd, const vk::Image image, const vk::ImageSubresourceRange &isr, const ImageState &src, const ImageState &dst) {
         vk::ImageMemoryBarrier2 barrier{
             src.stage,
@@ -1,8 +1,17 @@
 #pragma once
 
+#include <array>
+#include <memory>
+#include <mutex>
+
 #include <vulkan/vulkan_raii.hpp>
 
 #include "engine/fwd.hpp"
+#include "engine/renderer/deletion_queue.hpp"
+#include "engine/renderer/device_capabilities.hpp"
+#include "engine/renderer/memory_allocator.hpp"
+#include "engine/renderer/pipeline_cache.hpp"
+#include "engine/renderer/timeline.hpp"
 
 namespace engine {
     struct QueueSet {
@@ -51,6 +60,8 @@ namespace engine {
         ComputeLowPriority,
     };
 
+    inline constexpr size_t DEVICE_QUEUE_COUNT = 7;
+
     class VulkanContext : public std::enable_shared_from_this<VulkanContext> {
         explicit VulkanContext(const std::shared_ptr<EngineContext> &engine_context);
 
@@ -80,7 +91,82 @@ namespace engine {
 
         inline uint32_t primary_queue_family() const { return m_PrimaryQueueFamily; }
 
+        /**
+         * What the device supports. Every optional capability it has is enabled.
+         */
+        inline const DeviceCapabilities &capabilities() const { return m_Capabilities; }
+
+        /**
+         * Whether `VK_KHR_present_id` and `VK_KHR_present_wait` are enabled (never the case when headless).
+         */
+        inline bool supports_present_wait() const { return m_Capabilities.present_wait; }
+
+        /**
+         * Where all device memory should come from.
+         */
+        inline MemoryAllocator &allocator() const { return *m_Allocator; }
+
+        /**
+         * The queue which actually backs `queue` (for example, `DeviceQueue::Transfer` is the primary queue when there is no exclusive transfer queue).
+         */
+        [[nodiscard]] DeviceQueue resolve(DeviceQueue queue) const;
+
+        [[nodiscard]] const vk::raii::Queue &queue(DeviceQueue queue) const;
+
+        [[nodiscard]] uint32_t queue_family(DeviceQueue queue) const;
+
+        /**
+         * The timeline signaled by every submission made through `submit` to `queue`. Device queues backed by the same `vk::Queue` share a timeline.
+         */
+        [[nodiscard]] Timeline &timeline(DeviceQueue queue) const;
+
+        /**
+         * Submit to `queue`, additionally signaling the next value of its timeline once everything in the submission has finished. This is safe to call from any thread.
+         *
+         * @return The timeline value which the submission signals.
+         */
+        uint64_t submit(
+            DeviceQueue queue, vk::ArrayProxy<const vk::CommandBufferSubmitInfo> command_buffers, vk::ArrayProxy<const vk::SemaphoreSubmitInfo> waits = {},
+            vk::ArrayProxy<const vk::SemaphoreSubmitInfo> signals = {}
+        ) const;
+
+        /**
+         * The pipeline cache every pipeline should be created with. It's loaded from the engine's cache directory when the context is created.
+         */
+        inline PipelineCache &pipeline_cache() const { return *m_PipelineCache; }
+
+        /**
+         * Objects which have to outlive the GPU work using them.
+         */
+        inline DeletionQueue &deletion_queue() const { return *m_DeletionQueue; }
+
+        /**
+         * Destroy `object` once the next submission to `queue` (and so everything submitted before it) has finished, and `frames` more frames have ended after that (for things
+         * presentation may still be using). Safe to call from any thread.
+         *
+         * Waiting for the next submission rather than the last one means the object may still be used by command buffers which are being recorded right now, as long as they
+         * go out in `queue`'s next submission (which is the case for the frame the primary queue is recording). Anything recorded for a later submission than that has to
+         * stop using the object before it's retired.
+         */
+        template <typename T>
+        void retire(T &&object, const DeviceQueue queue = DeviceQueue::Primary, const uint32_t frames = 0) const {
+            const auto &queue_timeline = timeline(queue);
+            m_DeletionQueue->retire(std::forward<T>(object), queue_timeline, queue_timeline.submitted() + 1, frames);
+        }
+
+        /**
+         * Present on the present queue, synchronized with `submit` (the present queue is usually the primary queue).
+         */
+        vk::Result present(const vk::PresentInfoKHR &present_info) const;
+
       private:
+        struct QueueSync {
+            Timeline   timeline;
+            std::mutex mutex;
+
+            explicit QueueSync(const vk::raii::Device &device) : timeline(device) {}
+        };
+
         std::weak_ptr<EngineContext> m_EngineContext;
 
         vk::raii::Context        m_Context;
@@ -94,7 +180,20 @@ namespace engine {
         std::optional<uint32_t> m_ExclusiveTransferQueueFamily;
         std::optional<uint32_t> m_ExclusiveComputeQueueFamily;
 
+        DeviceCapabilities m_Capabilities;
+
         Queues m_Queues;
+
+        // Indexed by resolved `DeviceQueue`, only the entries which resolve to themselves exist.
+        std::array<std::unique_ptr<QueueSync>, DEVICE_QUEUE_COUNT> m_QueueSync;
+
+        // Destroyed while the device still exists.
+        std::unique_ptr<MemoryAllocator> m_Allocator;
+
+        std::unique_ptr<PipelineCache> m_PipelineCache;
+
+        // After the allocator, since retired objects may own allocations.
+        std::unique_ptr<DeletionQueue> m_DeletionQueue;
     };
 
     struct ImageState {
@@ -104,5 +203,8 @@ namespace engine {
         uint32_t owner = 0;
     };
 
+    /**
+     * Record a single image barrier. Use a `BarrierBatch` instead when more than one resource changes state at the same point, so they share one `pipelineBarrier2`.
+     */
     void transition_image(const vk::raii::CommandBuffer &cmd, vk::Image image, const vk::ImageSubresourceRange &isr, const ImageState &src, const ImageState &dst);
 } // namespace engine
@@ -1,5 +1,7 @@
 #include "tools.hpp"
 
+#include <fstream>
+
 #include <spdlog/spdlog.h>
 
 #ifdef WIN32
@@ -20,6 +22,38 @@ namespace engine {
 #endif
     }
 
+    bool write_file_atomically(const std::filesystem::path &path, const std::string_view description, const std::function<void(std::ostream &)> &write) {
+        std::error_code error;
+        if (path.has_parent_path()) {
+            std::filesystem::create_directories(path.parent_path(), error);
+        }
+
+        auto temporary = path;
+        temporary += ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (file) {
+                write(file);
+            }
+
+            // Closed before checking, since the last buffered write only fails (for example on a full disk) once it's flushed.
+            file.close();
+            if (!file) {
+                spdlog::warn("Couldn't write the {} to {}.", description, path.string());
+                std::filesystem::remove(temporary, error);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(temporary, path, error);
+        if (error) {
+            spdlog::warn("Couldn't write the {} to {} ({}).", description, path.string(), error.message());
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+        return true;
+    }
+
     crash::crash(const CrashReason reason, const std::string_view message)
         : reason(reason), message(message), full_message(std::string(to_string(reason)) + ": " + std::string(message)) {}
 
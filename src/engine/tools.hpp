@@ -1,11 +1,22 @@
 #pragma once
 
+#include <filesystem>
+#include <functional>
+#include <ostream>
 #include <stdexcept>
 #include <string_view>
 
 namespace engine {
     void error_popup(std::string_view message);
 
+    /**
+     * Writes a file through a temporary file next to it which is then renamed over `path`, so a crash halfway through can't leave a truncated file behind. The parent
+     * directories are created if needed. Failures are only logged (`description` says what the file is), since everything written this way is a cache.
+     *
+     * @return Whether the file was written.
+     */
+    bool write_file_atomically(const std::filesystem::path &path, std::string_view description, const std::function<void(std::ostream &)> &write);
+
     enum class CrashReason {
         UnsupportedSystem,
         OutOfMemory,
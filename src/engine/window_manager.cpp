@@ -19,7 +19,7 @@ namespace engine {
     WindowHandle WindowManager::create_window(const WindowAttributes &window_attributes) {
         static std::size_t index = 0;
 
-        const auto window = std::make_unique<Window>(window_attributes);
+        auto window = std::make_unique<Window>(window_attributes);
         if (m_VulkanContext) {
             window->create_surface(m_VulkanContext);
         }
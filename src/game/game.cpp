@@ -1,54 +1,38 @@
 #include "game.hpp"
 
+#include "engine/renderer/render_graph.hpp"
+
+#include <cmath>
+#include <numbers>
+
 namespace game {
-    Game::Game() = default;
+    Game::Game(const engine::EngineSettings &settings) : Application(settings) {}
 
     std::optional<engine::crash> Game::verify_system() const {
         return std::nullopt;
     }
 
+    void Game::update(const uint32_t snapshot, const std::chrono::nanoseconds delta) {
+        m_Time += std::chrono::duration<double>(delta).count();
+
+        // Slowly pulse the clear color so it's obvious when frames stop coming.
+        const auto pulse                  = static_cast<float>(0.5 + 0.5 * std::sin(m_Time * std::numbers::pi));
+        m_Snapshots[snapshot].clear_color = {pulse, 0.0f, 1.0f - pulse, 1.0f};
+    }
+
     void Game::render_frame(const vk::raii::CommandBuffer &cmd, const engine::FrameInfo &frame_info) {
-        engine::transition_image(
-            cmd,
-            frame_info.image,
-            vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1),
-            engine::ImageState{
-                .layout = vk::ImageLayout::eUndefined,
-                .access = vk::AccessFlagBits2::eNone,
-                .stage  = vk::PipelineStageFlagBits2::eTopOfPipe,
-                .owner  = VK_QUEUE_FAMILY_IGNORED,
-            },
-            engine::ImageState{
-                .layout = vk::ImageLayout::eTransferDstOptimal,
-                .access = vk::AccessFlagBits2::eTransferWrite,
-                .stage  = vk::PipelineStageFlagBits2::eTransfer,
-                .owner  = VK_QUEUE_FAMILY_IGNORED,
-            }
-        );
+        const auto         &snapshot = m_Snapshots[render_snapshot()];
+        engine::RenderGraph graph(engine());
 
-        cmd.clearColorImage(
-            frame_info.image,
-            vk::ImageLayout::eTransferDstOptimal,
-            vk::ClearColorValue(1.0f, 0.0f, 0.0f, 1.0f),
-            vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)
-        );
+        const auto target = graph.import_frame("frame", frame_info);
 
-        engine::transition_image(
-            cmd,
-            frame_info.image,
-            vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1),
-            engine::ImageState{
-                .layout = vk::ImageLayout::eTransferDstOptimal,
-                .access = vk::AccessFlagBits2::eTransferWrite,
-                .stage  = vk::PipelineStageFlagBits2::eTransfer,
-                .owner  = VK_QUEUE_FAMILY_IGNORED,
-            },
-            engine::ImageState{
-                .layout = vk::ImageLayout::ePresentSrcKHR,
-                .access = vk::AccessFlagBits2::eNone,
-                .stage  = vk::PipelineStageFlagBits2::eBottomOfPipe,
-                .owner  = VK_QUEUE_FAMILY_IGNORED,
-            }
+        // Nothing is drawn yet, so the pass is only the clear (done by the load op, straight in the attachment layout).
+        graph.add_pass(
+            "main",
+            [&](engine::RenderGraphPassBuilder &builder) { builder.color_attachment(target, engine::AttachmentLoad::Clear, vk::ClearColorValue(snapshot.clear_color)); },
+            [](const vk::raii::CommandBuffer &, const engine::RenderGraph &) {}
         );
+
+        graph.execute(cmd);
     }
 } // namespace game
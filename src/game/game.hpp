@@ -1,17 +1,34 @@
 #pragma once
 
+#include <array>
+
 #include "engine/application.hpp"
 
 namespace game {
 
+    /**
+     * Everything `Game::render_frame` needs from the simulation of a frame.
+     */
+    struct RenderSnapshot {
+        std::array<float, 4> clear_color = {1.0f, 0.0f, 0.0f, 1.0f};
+    };
+
     class Game : public engine::Application {
       public:
-        Game();
+        explicit Game(const engine::EngineSettings &settings = {});
         ~Game() override = default;
 
         [[nodiscard]] std::optional<engine::crash> verify_system() const override;
 
+        void update(uint32_t snapshot, std::chrono::nanoseconds delta) override;
+
         void render_frame(const vk::raii::CommandBuffer &cmd, const engine::FrameInfo &frame_info) override;
+
+      private:
+        // Only touched by `update`.
+        double m_Time = 0.0;
+
+        std::array<RenderSnapshot, SNAPSHOT_COUNT> m_Snapshots;
     };
 
 } // namespace game